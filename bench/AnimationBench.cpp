@@ -0,0 +1,150 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Compares AnimationLibrary::advance with the frame lookup updateAnimation
+// used before clips had precomputed frame end times: re-summing every
+// frame's ratio, for every entity, every tick.
+//
+//   AnimationBench [ticks]
+//
+// Reports the median time per tick and per entity at 1k, 100k and 1M
+// animated entities, for a uniform and a non-uniform clip mix.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../src/AnimationLibrary.hpp"
+
+namespace
+{
+  const float TICK = 1.0f / 60.0f;
+
+  // The lookup of the previous updateAnimation, over the same clip data.
+  struct LegacyClip
+  {
+    float mTotalTime { 1.0f };
+    std::vector<float> mRatios;
+  };
+
+  void legacyAdvance( float aDt, const std::vector<LegacyClip>& aClips, ComponentSpriteAnimated* aAnimations, std::size_t aCount )
+  {
+    for ( std::size_t entity = 0; entity < aCount; ++entity )
+    {
+      auto& spriteAnimated = aAnimations[entity];
+      const LegacyClip& clip = aClips[spriteAnimated.mClip];
+
+      spriteAnimated.mTimeInCurrentLoop += aDt;
+      if ( spriteAnimated.mTimeInCurrentLoop >= clip.mTotalTime )
+        spriteAnimated.mTimeInCurrentLoop -= clip.mTotalTime;
+      float currentRatio = spriteAnimated.mTimeInCurrentLoop / clip.mTotalTime;
+
+      float ratioAccumulator = 0.0f;
+      for ( std::size_t i = 0u; i < clip.mRatios.size(); ++i )
+      {
+        ratioAccumulator += clip.mRatios[i];
+        if ( currentRatio < ratioAccumulator )
+          spriteAnimated.mCurrentSequenceElementIndex = static_cast<int>( i );
+      }
+    }
+  }
+
+  template<typename Kernel>
+  double medianTickMicroseconds( int aTicks, Kernel aKernel )
+  {
+    std::vector<double> samples;
+    for ( int tick = 0; tick < aTicks; ++tick )
+    {
+      const auto start = std::chrono::steady_clock::now();
+      aKernel();
+      samples.push_back( std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - start ).count() );
+    }
+
+    std::nth_element( samples.begin(), samples.begin() + samples.size() / 2, samples.end() );
+    return samples[samples.size() / 2];
+  }
+}
+
+int main( int argc, char** argv )
+{
+  const int ticks = argc > 1 ? std::max( 1, std::atoi( argv[1] ) ) : 100;
+
+  // Same shape as animation.txt: 5 frames, non-uniform ratios; and an 8 frame uniform walk cycle.
+  std::vector<AssetLoader::SequenceElement> nonUniform;
+  for ( float ratio : { 0.1f, 0.3f, 0.2f, 0.3f, 0.1f } )
+    nonUniform.push_back( { sf::Vector2i( 25, 0 ), ratio } );
+
+  std::vector<AssetLoader::SequenceElement> uniform( 8, { sf::Vector2i( 24, 0 ), 0.125f } );
+
+  AnimationLibrary library;
+  std::vector<LegacyClip> legacyClips;
+  for ( const auto* frames : { &nonUniform, &uniform } )
+  {
+    library.addClip( TileAtlas(), *frames, 1.0f );
+
+    LegacyClip legacyClip;
+    for ( const auto& frame : *frames )
+      legacyClip.mRatios.push_back( frame.mRatio );
+    legacyClips.push_back( legacyClip );
+  }
+
+  std::cout << "entities    legacy us/tick   advance us/tick   legacy ns/entity   advance ns/entity" << std::endl;
+
+  for ( std::size_t count : { 1000u, 100000u, 1000000u } )
+  {
+    std::mt19937 random( 42 );
+    std::uniform_real_distribution<float> startTime( 0.0f, 1.0f );
+
+    std::vector<ComponentSpriteAnimated> animations( count );
+    for ( auto& animation : animations )
+    {
+      animation.mClip = random() % 2;
+      animation.mTimeInCurrentLoop = startTime( random );
+      animation.mCurrentSequenceElementIndex = library.findFrame( library.getClip( animation.mClip ), animation.mTimeInCurrentLoop );
+    }
+    std::vector<ComponentSpriteAnimated> legacyAnimations = animations;
+
+    const double legacy  = medianTickMicroseconds( ticks, [&]() { legacyAdvance( TICK, legacyClips, legacyAnimations.data(), count ); } );
+    const double advance = medianTickMicroseconds( ticks, [&]() { library.advance( TICK, animations.data(), count ); } );
+
+    // The incremental advance must agree with a lookup from scratch.
+    for ( const auto& animation : animations )
+    {
+      if ( animation.mCurrentSequenceElementIndex != library.findFrame( library.getClip( animation.mClip ), animation.mTimeInCurrentLoop ) )
+      {
+        std::cerr << "advance and findFrame disagree" << std::endl;
+        return 1;
+      }
+    }
+
+    std::cout << count 
+      << "    " << legacy << "    " << advance 
+      << "    " << legacy * 1000.0 / count << "    " << advance * 1000.0 / count << std::endl;
+  }
+
+  return 0;
+}
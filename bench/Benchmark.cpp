@@ -0,0 +1,212 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+
+#include "MemoryTracker.hpp"
+
+namespace
+{
+  std::atomic<std::uint64_t> gAllocationCount { 0 };
+
+  double percentile( const std::vector<double>& aSortedSamples, double aPercentile )
+  {
+    const std::size_t index = static_cast<std::size_t>( aPercentile * ( aSortedSamples.size() - 1 ) + 0.5 );
+    return aSortedSamples[index];
+  }
+
+  void writeEscaped( std::ostream& aStream, const std::string& aText )
+  {
+    aStream << '"';
+    for ( char c : aText )
+    {
+      if ( c == '"' || c == '\\' )
+        aStream << '\\';
+      aStream << c;
+    }
+    aStream << '"';
+  }
+}
+
+#ifndef RPG_MEMORY_TRACKING
+
+// Every allocation of the benchmark binary goes through here. With memory
+// tracking, MemoryTracker replaces these and does the counting.
+void* operator new( std::size_t aSize )
+{
+  gAllocationCount.fetch_add( 1, std::memory_order_relaxed );
+  if ( void* memory = std::malloc( aSize ? aSize : 1 ) )
+    return memory;
+  throw std::bad_alloc();
+}
+
+
+void operator delete( void* aMemory ) noexcept
+{
+  std::free( aMemory );
+}
+
+
+void operator delete( void* aMemory, std::size_t ) noexcept
+{
+  std::free( aMemory );
+}
+
+#endif
+
+
+std::uint64_t
+Benchmark::allocationCount()
+{
+#ifdef RPG_MEMORY_TRACKING
+  return MemoryTracker::getTotalStats().mTotalAllocations;
+#else
+  return gAllocationCount.load( std::memory_order_relaxed );
+#endif
+}
+
+
+Benchmark::Result
+Benchmark::run( const std::string& aName, const Settings& aSettings,
+  const std::function<void()>& aSetup, const std::function<void()>& aOperation )
+{
+  typedef std::chrono::steady_clock Clock;
+
+  Result result;
+  result.mName = aName;
+
+  std::vector<double> samples;
+  std::uint64_t allocations = 0;
+  const Clock::time_point budgetStart = Clock::now();
+
+  while ( static_cast<int>( samples.size() ) < aSettings.mMaxRepetitions )
+  {
+    const double spent = std::chrono::duration<double>( Clock::now() - budgetStart ).count();
+    if ( static_cast<int>( samples.size() ) >= aSettings.mMinRepetitions && spent > aSettings.mTimeBudget )
+      break;
+
+    aSetup();
+
+    const std::uint64_t allocationsBefore = allocationCount();
+    const Clock::time_point start = Clock::now();
+    aOperation();
+    const Clock::time_point end = Clock::now();
+    allocations += allocationCount() - allocationsBefore;
+
+    samples.push_back( std::chrono::duration<double, std::nano>( end - start ).count() );
+  }
+
+  std::sort( samples.begin(), samples.end() );
+
+  double total = 0.0;
+  for ( double sample : samples )
+    total += sample;
+
+  result.mRepetitions             = static_cast<int>( samples.size() );
+  result.mMedian                  = percentile( samples, 0.5 );
+  result.mP99                     = percentile( samples, 0.99 );
+  result.mMean                    = total / samples.size();
+  result.mAllocationsPerOperation = static_cast<double>( allocations ) / samples.size();
+  return result;
+}
+
+
+void
+Benchmark::writeJson( std::ostream& aStream, const std::vector<Result>& aResults )
+{
+  const std::ios_base::fmtflags flags = aStream.flags();
+  aStream << std::fixed << std::setprecision( 1 );
+
+  aStream << "{\n  \"benchmarks\": [";
+
+  for ( std::size_t i = 0; i < aResults.size(); ++i )
+  {
+    const Result& result = aResults[i];
+
+    aStream << ( i > 0 ? "," : "" ) << "\n    { \"name\": ";
+    writeEscaped( aStream, result.mName );
+
+    aStream << ", \"parameters\": {";
+    for ( std::size_t p = 0; p < result.mParameters.size(); ++p )
+    {
+      aStream << ( p > 0 ? ", " : " " );
+      writeEscaped( aStream, result.mParameters[p].first );
+      aStream << ": " << result.mParameters[p].second;
+    }
+    aStream << ( result.mParameters.empty() ? "}" : " }" );
+
+    if ( !result.mSkipped.empty() )
+    {
+      aStream << ", \"skipped\": ";
+      writeEscaped( aStream, result.mSkipped );
+    }
+    else
+    {
+      aStream << ", \"repetitions\": " << result.mRepetitions
+        << ", \"median_ns\": " << result.mMedian
+        << ", \"p99_ns\": " << result.mP99
+        << ", \"mean_ns\": " << result.mMean
+        << ", \"allocations_per_op\": " << result.mAllocationsPerOperation;
+
+      for ( const auto& counter : result.mCounters )
+      {
+        aStream << ", ";
+        writeEscaped( aStream, counter.first );
+        aStream << ": " << counter.second;
+      }
+    }
+    aStream << " }";
+  }
+
+  aStream << "\n  ]\n}\n";
+  aStream.flags( flags );
+}
+
+
+void
+Benchmark::writeTable( std::ostream& aStream, const Result& aResult )
+{
+  aStream << aResult.mName;
+  for ( const auto& parameter : aResult.mParameters )
+    aStream << " " << parameter.first << "=" << parameter.second;
+
+  if ( !aResult.mSkipped.empty() )
+  {
+    aStream << "  skipped: " << aResult.mSkipped << std::endl;
+    return;
+  }
+
+  aStream << "  median " << aResult.mMedian / 1000.0 << " us"
+    << ", p99 " << aResult.mP99 / 1000.0 << " us"
+    << ", " << aResult.mAllocationsPerOperation << " allocations/op";
+  for ( const auto& counter : aResult.mCounters )
+    aStream << ", " << counter.second << " " << counter.first;
+  aStream << " (" << aResult.mRepetitions << " runs)" << std::endl;
+}
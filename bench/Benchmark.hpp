@@ -0,0 +1,68 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal benchmark harness: times a case repeatedly, counts the heap
+// allocations made while it runs, and collects the results as JSON so runs
+// can be diffed between commits.
+namespace Benchmark
+{
+  struct Settings
+  {
+    int    mMinRepetitions { 5 };
+    int    mMaxRepetitions { 100 };
+    double mTimeBudget     { 2.0 }; // Seconds per case, once mMinRepetitions are done.
+  };
+
+  struct Result
+  {
+    std::string mName;
+    std::vector<std::pair<std::string, std::int64_t>> mParameters;
+
+    int         mRepetitions { 0 };
+    double      mMedian { 0.0 }; // Nanoseconds per operation.
+    double      mP99 { 0.0 };
+    double      mMean { 0.0 };
+    double      mAllocationsPerOperation { 0.0 };
+    std::vector<std::pair<std::string, double>> mCounters; // Other per-operation measures, e.g. draw calls.
+    std::string mSkipped; // Reason the case did not run, empty when it ran.
+  };
+
+  // Heap allocations made so far, by any thread.
+  std::uint64_t allocationCount();
+
+  // Runs aSetup, untimed, then aOperation, timed, once per repetition.
+  Result run( const std::string& aName, const Settings& aSettings,
+    const std::function<void()>& aSetup, const std::function<void()>& aOperation );
+
+  void writeJson( std::ostream& aStream, const std::vector<Result>& aResults );
+  void writeTable( std::ostream& aStream, const Result& aResult );
+}
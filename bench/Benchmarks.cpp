@@ -0,0 +1,832 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Benchmarks of the loading, animation and rendering paths over synthetic
+// maps and entity populations. Results go to stdout (or --out) as JSON, a
+// readable summary to stderr.
+//
+//   bench [--out <file.json>] [--filter <text>] [--max-map-size <tiles>]
+//         [--max-entities <count>] [--quick] [--no-gpu]
+//
+// Rendering goes to an offscreen sf::RenderTexture. Cases that need a GPU
+// context (creating maps and rendering, which upload textures) are reported
+// as skipped with --no-gpu, or when no display is available: run the suite
+// under xvfb-run on a headless Linux box to include them.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <entt/entt.hpp>
+#include <SFML/Graphics.hpp>
+
+#include "AnimationLibrary.hpp"
+#include "AssetLoader.hpp"
+#include "AtlasPacker.hpp"
+#include "Benchmark.hpp"
+#include "BulkSpawn.hpp"
+#include "Components.hpp"
+#include "GlobalDefs.hpp"
+#include "JobSystem.hpp"
+#include "MapFile.hpp"
+#include "MemoryTracker.hpp"
+#include "Pathfinder.hpp"
+#include "Snapshot.hpp"
+#include "SystemMovement.hpp"
+#include "Systems.hpp"
+#include "TileAtlas.hpp"
+#include "TileGrid.hpp"
+#include "TilePyramid.hpp"
+
+namespace
+{
+  const int         MAP_SIZES[]            = { 64, 256, 1024, 2048, 4096, 8192 };
+  const int         MAX_SPRITE_MAP_SIZE    = 1024; // One entity per tile beyond that takes gigabytes.
+  const std::size_t ENTITY_COUNTS[]        = { 1, 100, 10000, 100000, 1000000 };
+  const std::size_t RENDER_ENTITY_COUNTS[] = { 1, 1000, 100000 };
+  const std::size_t EDIT_COUNTS[]          = { 1, 1000, 100000 };
+  const int         RENDER_MAP_SIZE        = 1024;
+  const int         PATH_MAP_SIZE          = 1024;
+  const std::size_t PATH_REQUESTS          = 256; // Per operation.
+  const float       TICK                   = 1.0f / 60.0f;
+
+  struct Options
+  {
+    std::string           mOut;
+    std::string           mFilter;
+    int                   mMaxMapSize { 2048 };
+    std::size_t           mMaxEntities { 1000000 };
+    bool                  mGpu { true };
+    Benchmark::Settings   mSettings;
+  };
+
+  struct Suite
+  {
+    Options                        mOptions;
+    std::filesystem::path          mDirectory; // Synthetic maps.
+    std::vector<Benchmark::Result> mResults;
+
+    bool selected( const std::string& aName ) const
+    {
+      return mOptions.mFilter.empty() || aName.find( mOptions.mFilter ) != std::string::npos;
+    }
+
+    void add( Benchmark::Result aResult, std::vector<std::pair<std::string, std::int64_t>> aParameters )
+    {
+      aResult.mParameters = std::move( aParameters );
+      Benchmark::writeTable( std::cerr, aResult );
+      mResults.push_back( std::move( aResult ) );
+    }
+
+    void skip( const std::string& aName, std::vector<std::pair<std::string, std::int64_t>> aParameters, const std::string& aReason )
+    {
+      Benchmark::Result result;
+      result.mName = aName;
+      result.mSkipped = aReason;
+      add( std::move( result ), std::move( aParameters ) );
+    }
+  };
+
+  bool gpuAvailable()
+  {
+#if defined( _WIN32 ) || defined( __APPLE__ )
+    return true;
+#else
+    // SFML aborts when it cannot open a display to create its GL context.
+    return std::getenv( "DISPLAY" ) != nullptr;
+#endif
+  }
+
+  // Random tiles from the whole tileset, the same for every run.
+  TileGrid makeMap( int aSize )
+  {
+    std::mt19937 random( 42 );
+    std::uniform_int_distribution<int> tile( 0, Globals::TILESET_COLUMNS * Globals::TILESET_ROWS - 1 );
+
+    TileGrid grid;
+    grid.resize( sf::Vector2i( aSize, aSize ) );
+    TileId* tiles = grid.data();
+    for ( std::size_t i = 0; i < static_cast<std::size_t>( aSize ) * aSize; ++i )
+      tiles[i] = static_cast<TileId>( tile( random ) );
+    return grid;
+  }
+
+  void writeTextMap( const std::string& aPath, const TileGridView& aTiles )
+  {
+    std::ofstream writer( aPath );
+    writer << aTiles.getSize().x << "\n" << aTiles.getSize().y << "\n";
+    for ( int y = 0; y < aTiles.getSize().y; ++y )
+    {
+      const TileId* row = aTiles.row( y );
+      for ( int x = 0; x < aTiles.getSize().x; ++x )
+      {
+        const sf::Vector2i spriteIndex = tileSpriteIndex( row[x] );
+        writer << spriteIndex.x << " " << spriteIndex.y << " ";
+      }
+      writer << "\n";
+    }
+  }
+
+  // <directory>/text/map_<size>.txt, and <directory>/binary/map_<size>.txt
+  // whose .bin sibling the AssetLoader prefers.
+  std::string textMapPath( const Suite& aSuite, int aSize )
+  {
+    return ( aSuite.mDirectory / "text" / ( "map_" + std::to_string( aSize ) + ".txt" ) ).string();
+  }
+
+  std::string binaryMapPath( const Suite& aSuite, int aSize )
+  {
+    return ( aSuite.mDirectory / "binary" / ( "map_" + std::to_string( aSize ) + ".txt" ) ).string();
+  }
+
+  void writeMaps( const Suite& aSuite, int aSize )
+  {
+    if ( std::filesystem::exists( textMapPath( aSuite, aSize ) ) )
+      return;
+
+    std::filesystem::create_directories( aSuite.mDirectory / "text" );
+    std::filesystem::create_directories( aSuite.mDirectory / "binary" );
+
+    const TileGrid grid = makeMap( aSize );
+    writeTextMap( textMapPath( aSuite, aSize ), grid.getView() );
+
+    const std::string binaryPath = binaryMapPath( aSuite, aSize );
+    MapFile::writeBinary( binaryPath.substr( 0, binaryPath.find_last_of( '.' ) ) + ".bin", grid.getView(), 2 );
+  }
+
+  std::unique_ptr<AssetLoader> makeLoader( const Suite& aSuite, const std::string& aMapPath )
+  {
+    auto loader = std::make_unique<AssetLoader>();
+    loader->SetCacheDirectory( ( aSuite.mDirectory / "cache" ).string() );
+    loader->SetPath( AssetLoader::ASSET_TILEMAP, std::string( RPG_ASSETS_DIR ) + "kenney_rpgurbanpack/Tilemap/tilemap_packed.png" );
+    loader->SetPath( AssetLoader::ASSET_MAP, aMapPath );
+    loader->SetPath( AssetLoader::ASSET_MAIN_ANIMATION, std::string( RPG_ASSETS_DIR ) + "animation.txt" );
+    loader->SetAtlasSource( AssetLoader::ASSET_TILEMAP, AtlasPacker::tileFiles( std::string( RPG_ASSETS_DIR ) + "kenney_rpgurbanpack/Tiles/" ) );
+    return loader;
+  }
+
+  // aCount animated characters spread over a map of aMapSize tiles, at
+  // random points of the main animation clips.
+  void populate( entt::registry& aRegistry, SystemRenderer& aRenderer, AssetLoader& aLoader,
+    const TileAtlas& aAtlas, std::size_t aCount, int aMapSize )
+  {
+    AnimationLibrary& library = aRenderer.getAnimationLibrary();
+    const AssetLoader::Animations& sequences = aLoader.GetMainAnimations( AssetLoader::ASSET_MAIN_ANIMATION );
+
+    std::vector<AnimationClipId> clips;
+    for ( const auto& sequence : sequences )
+      clips.push_back( library.addClip( aAtlas, sequence, 1.0f ) );
+
+    std::mt19937 random( 42 );
+    std::uniform_real_distribution<float> position( 0.0f, static_cast<float>( aMapSize ) );
+    std::uniform_real_distribution<float> time( 0.0f, 1.0f );
+
+    std::vector<entt::entity> entities;
+    entities.reserve( aCount );
+    BulkSpawn::reserve<ComponentPositionWorld, ComponentMainCharacter, ComponentSpriteAnimated>( aRegistry, aCount );
+    BulkSpawn::create( aRegistry, aCount, entities );
+
+    const entt::entity* first = entities.data();
+    const entt::entity* last  = first + aCount;
+    ComponentPositionWorld* positions = BulkSpawn::assign<ComponentPositionWorld>( aRegistry, first, last );
+    BulkSpawn::assign<ComponentMainCharacter>( aRegistry, first, last );
+    ComponentSpriteAnimated* animations = BulkSpawn::assign<ComponentSpriteAnimated>( aRegistry, first, last );
+
+    for ( std::size_t i = 0; i < aCount; ++i )
+    {
+      positions[i].mPosition = sf::Vector2f( position( random ), position( random ) );
+
+      ComponentSpriteAnimated& spriteAnimated = animations[i];
+      spriteAnimated.mClip = clips[random() % clips.size()];
+      spriteAnimated.mTimeInCurrentLoop = time( random );
+      spriteAnimated.mCurrentSequenceElementIndex = library.findFrame( library.getClip( spriteAnimated.mClip ), spriteAnimated.mTimeInCurrentLoop );
+    }
+  }
+
+  // The text map parsed on one worker, then split over a job system, against
+  // the binary map read in place.
+  void benchLoadMap( Suite& aSuite )
+  {
+    const char* NAMES[] = { "load_map_text", "load_map_text_parallel", "load_map_binary" };
+    JobSystem jobSystem;
+
+    const bool anySelected = std::any_of( std::begin( NAMES ), std::end( NAMES ), [&aSuite]( const char* aName ) { return aSuite.selected( aName ); } );
+
+    for ( int size : MAP_SIZES )
+    {
+      if ( size > aSuite.mOptions.mMaxMapSize || !anySelected )
+        continue;
+
+      writeMaps( aSuite, size );
+
+      for ( const std::string name : NAMES )
+      {
+        if ( !aSuite.selected( name ) )
+          continue;
+
+        const bool binary = name == "load_map_binary";
+        const bool parallel = name == "load_map_text_parallel";
+        const std::string path = binary ? binaryMapPath( aSuite, size ) : textMapPath( aSuite, size );
+        std::unique_ptr<AssetLoader> loader;
+
+        aSuite.add( Benchmark::run( name, aSuite.mOptions.mSettings,
+          [&]()
+          {
+            loader.reset();
+            loader = makeLoader( aSuite, path );
+            loader->SetJobSystem( parallel ? &jobSystem : nullptr );
+          },
+          [&]() { loader->GetMapData( AssetLoader::ASSET_MAP ); } ),
+          { { "map_size", size }, { "threads", parallel ? jobSystem.getThreadCount() + 1 : 1 } } );
+      }
+    }
+  }
+
+  // Packing every tile of the tileset from its individual images, against
+  // reading the packed result back from the cache.
+  void benchAtlas( Suite& aSuite )
+  {
+    const AtlasPacker::Source source = AtlasPacker::tileFiles( std::string( RPG_ASSETS_DIR ) + "kenney_rpgurbanpack/Tiles/" );
+    const AtlasPacker::Settings settings;
+    std::vector<TileId> tiles( Globals::TILESET_COLUMNS * Globals::TILESET_ROWS );
+    for ( std::size_t tile = 0; tile < tiles.size(); ++tile )
+      tiles[tile] = static_cast<TileId>( tile );
+
+    const std::string cachePath = AtlasPacker::getCachePath( ( aSuite.mDirectory / "cache" ).string(), AtlasPacker::hashInputs( source, tiles, settings ) );
+
+    for ( bool cached : { false, true } )
+    {
+      const std::string name = cached ? "atlas_cached" : "atlas_pack";
+      if ( !aSuite.selected( name ) )
+        continue;
+
+      aSuite.add( Benchmark::run( name, aSuite.mOptions.mSettings,
+        [&]()
+        {
+          if ( !cached )
+            std::filesystem::remove( cachePath );
+        },
+        [&]()
+        {
+          AtlasPacker::Packed packed;
+          const std::string path = AtlasPacker::getCachePath( ( aSuite.mDirectory / "cache" ).string(), AtlasPacker::hashInputs( source, tiles, settings ) );
+          if ( !AtlasPacker::readCache( path, packed ) )
+          {
+            AtlasPacker::pack( source, tiles, settings, packed );
+            AtlasPacker::writeCache( path, packed );
+          }
+        } ),
+        { { "tiles", static_cast<std::int64_t>( tiles.size() ) } } );
+    }
+  }
+
+  void benchCreateMap( Suite& aSuite )
+  {
+    for ( int size : MAP_SIZES )
+    {
+      for ( auto mode : { SystemRenderer::BACKGROUND_MODE_CHUNKS, SystemRenderer::BACKGROUND_MODE_SPRITES } )
+      {
+        const std::string name = mode == SystemRenderer::BACKGROUND_MODE_CHUNKS ? "create_map_chunks" : "create_map_sprites";
+        if ( size > aSuite.mOptions.mMaxMapSize || !aSuite.selected( name ) )
+          continue;
+        if ( mode == SystemRenderer::BACKGROUND_MODE_SPRITES && size > MAX_SPRITE_MAP_SIZE )
+          continue;
+        if ( !aSuite.mOptions.mGpu )
+        {
+          aSuite.skip( name, { { "map_size", size } }, "needs a GPU context" );
+          continue;
+        }
+
+        writeMaps( aSuite, size );
+        auto loader = makeLoader( aSuite, binaryMapPath( aSuite, size ) );
+        loader->GetAtlas( AssetLoader::ASSET_TILEMAP );
+        loader->GetMapData( AssetLoader::ASSET_MAP );
+
+        const std::shared_ptr<sf::RenderWindow> noWindow;
+        std::unique_ptr<entt::registry> registry;
+        std::unique_ptr<SystemRenderer> renderer;
+
+        Benchmark::Result result = Benchmark::run( name, aSuite.mOptions.mSettings,
+          [&]()
+          {
+            renderer.reset();
+            registry = std::make_unique<entt::registry>();
+            renderer = std::make_unique<SystemRenderer>( noWindow, mode );
+          },
+          [&]() { renderer->createMap( *registry, *loader ); } );
+
+        const MemoryTracker::Report memory = MemoryTracker::getReport( *registry, *loader );
+        result.mCounters.push_back( { "bytes_per_tile", memory.getBytesPerTile() } );
+        result.mCounters.push_back( { "bytes_per_entity", memory.getBytesPerEntity() } );
+        aSuite.add( result, { { "map_size", size } } );
+      }
+    }
+  }
+
+  // Random tile writes followed by the patch of their render data: the cost
+  // should follow the edit count, not the map size.
+  void benchEditTiles( Suite& aSuite )
+  {
+    for ( int mapSize : { 256, 2048 } )
+    {
+      for ( std::size_t count : EDIT_COUNTS )
+      {
+        const std::string name = "edit_tiles";
+        if ( mapSize > aSuite.mOptions.mMaxMapSize || !aSuite.selected( name ) )
+          continue;
+        if ( !aSuite.mOptions.mGpu )
+        {
+          aSuite.skip( name, { { "map_size", mapSize }, { "edits", static_cast<std::int64_t>( count ) } }, "needs a GPU context" );
+          continue;
+        }
+
+        writeMaps( aSuite, mapSize );
+        auto loader = makeLoader( aSuite, binaryMapPath( aSuite, mapSize ) );
+        const std::shared_ptr<sf::RenderWindow> noWindow;
+        entt::registry registry;
+        SystemRenderer renderer( noWindow );
+        renderer.createMap( registry, *loader );
+
+        std::mt19937 random( 42 );
+        std::uniform_int_distribution<int> coordinate( 0, mapSize - 1 );
+        std::uniform_int_distribution<int> tile( 0, Globals::TILESET_COLUMNS * Globals::TILESET_ROWS - 1 );
+
+        aSuite.add( Benchmark::run( name, aSuite.mOptions.mSettings,
+          []() {},
+          [&]()
+          {
+            for ( std::size_t i = 0; i < count; ++i )
+              renderer.setTile( coordinate( random ), coordinate( random ), static_cast<TileId>( tile( random ) ) );
+            renderer.applyTileEdits( registry );
+          } ),
+          { { "map_size", mapSize }, { "edits", static_cast<std::int64_t>( count ) } } );
+      }
+    }
+  }
+
+  void benchUpdateAnimation( Suite& aSuite )
+  {
+    JobSystem jobSystem;
+
+    for ( std::size_t count : ENTITY_COUNTS )
+    {
+      for ( bool jobs : { false, true } )
+      {
+        const std::string name = jobs ? "update_animation_jobs" : "update_animation";
+        if ( count > aSuite.mOptions.mMaxEntities || !aSuite.selected( name ) )
+          continue;
+
+        auto loader = makeLoader( aSuite, "" );
+        entt::registry registry;
+        const std::shared_ptr<sf::RenderWindow> noWindow;
+        SystemRenderer renderer( noWindow );
+        populate( registry, renderer, *loader, TileAtlas(), count, 1024 );
+
+        aSuite.add( Benchmark::run( name, aSuite.mOptions.mSettings,
+          []() {},
+          [&]() { renderer.updateAnimation( TICK, registry, jobs ? &jobSystem : nullptr ); } ),
+          { { "entities", static_cast<std::int64_t>( count ) }, { "threads", jobs ? static_cast<std::int64_t>( jobSystem.getThreadCount() ) : 1 } } );
+      }
+    }
+  }
+
+  // Movers crossing the map: long enough that none arrives during the run.
+  // The advance cases time the vectorized or scalar arithmetic alone,
+  // update_movement adds writing the positions back into the registry.
+  void benchMovement( Suite& aSuite )
+  {
+    const std::pair<const char*, bool> cases[] = { { "advance_movement_scalar", false }, { "advance_movement_simd", true }, { "update_movement", true } };
+
+    for ( std::size_t count : ENTITY_COUNTS )
+    {
+      for ( const auto& movementCase : cases )
+      {
+        const std::string name = movementCase.first;
+        const bool simd = movementCase.second;
+        if ( count > aSuite.mOptions.mMaxEntities || !aSuite.selected( name ) )
+          continue;
+        if ( simd && !SystemMovement::isSimdAvailable() )
+        {
+          aSuite.skip( name, { { "entities", static_cast<std::int64_t>( count ) } }, "built without SIMD" );
+          continue;
+        }
+
+        entt::registry registry;
+        SystemMovement movement;
+        movement.setSimdEnabled( simd );
+
+        std::mt19937 random( 42 );
+        std::uniform_real_distribution<float> position( 0.0f, 1024.0f );
+
+        std::vector<entt::entity> entities;
+        BulkSpawn::reserve<ComponentPositionWorld, ComponentWorldMovement>( registry, count );
+        BulkSpawn::create( registry, count, entities );
+        ComponentPositionWorld* positions = BulkSpawn::assign<ComponentPositionWorld>( registry, entities.data(), entities.data() + count );
+        for ( std::size_t i = 0; i < count; ++i )
+        {
+          positions[i].mPosition = sf::Vector2f( position( random ), position( random ) );
+          movement.startMove( registry, entities[i], sf::Vector2f( position( random ) + 2048.0f, position( random ) ), 1.0f );
+        }
+
+        const bool advanceOnly = name != "update_movement";
+        Benchmark::Result result = Benchmark::run( name, aSuite.mOptions.mSettings,
+          []() {},
+          [&]()
+          {
+            if ( advanceOnly )
+              movement.advance( TICK );
+            else
+              movement.update( registry, TICK );
+          } );
+        result.mCounters.push_back( { "entities_per_ms", result.mMedian > 0.0 ? count / ( result.mMedian / 1e6 ) : 0.0 } );
+        aSuite.add( result, { { "entities", static_cast<std::int64_t>( count ) } } );
+      }
+    }
+  }
+
+  // Spawns a crowd from a spawn list, one entity at a time or in bulk. The
+  // pool capacity left behind shows the overallocation of geometric growth.
+  void benchSpawn( Suite& aSuite )
+  {
+    for ( std::size_t count : ENTITY_COUNTS )
+    {
+      std::vector<ComponentPositionWorld> spawnList( count );
+      for ( std::size_t i = 0; i < count; ++i )
+        spawnList[i].mPosition = sf::Vector2f( static_cast<float>( i % 1024 ), static_cast<float>( i / 1024 ) );
+
+      for ( bool bulk : { false, true } )
+      {
+        const std::string name = bulk ? "spawn_bulk" : "spawn_single";
+        if ( count > aSuite.mOptions.mMaxEntities || !aSuite.selected( name ) )
+          continue;
+
+        std::unique_ptr<entt::registry> registry;
+        std::vector<entt::entity> entities;
+        Benchmark::Result result = Benchmark::run( name, aSuite.mOptions.mSettings,
+          [&]()
+          {
+            registry = std::make_unique<entt::registry>();
+            entities.clear();
+            entities.shrink_to_fit();
+          },
+          [&]()
+          {
+            if ( bulk )
+            {
+              entities.reserve( count );
+              BulkSpawn::reserve<ComponentPositionWorld, ComponentSpriteAnimated>( *registry, count );
+              BulkSpawn::create( *registry, count, entities );
+              BulkSpawn::assign<ComponentPositionWorld>( *registry, entities.data(), entities.data() + count, spawnList.data() );
+              BulkSpawn::assign<ComponentSpriteAnimated>( *registry, entities.data(), entities.data() + count );
+              return;
+            }
+
+            for ( std::size_t i = 0; i < count; ++i )
+            {
+              auto entity = registry->create();
+              registry->assign<ComponentPositionWorld>( entity, spawnList[i] );
+              registry->assign<ComponentSpriteAnimated>( entity );
+              entities.push_back( entity );
+            }
+          } );
+
+        const std::size_t poolBytes = registry->capacity<ComponentPositionWorld>() * sizeof( ComponentPositionWorld )
+          + registry->capacity<ComponentSpriteAnimated>() * sizeof( ComponentSpriteAnimated );
+        result.mCounters.push_back( { "pool_bytes", static_cast<double>( poolBytes ) } );
+        result.mCounters.push_back( { "bytes_per_entity", MemoryTracker::getReport( *registry ).getBytesPerEntity() } );
+        aSuite.add( result, { { "entities", static_cast<std::int64_t>( count ) } } );
+      }
+    }
+  }
+
+  // A crowd of animated characters saved to a snapshot, restored into an
+  // empty registry, and saved as a delta after a few hundredths of them
+  // moved, as an autosave would.
+  void benchSnapshot( Suite& aSuite )
+  {
+    for ( std::size_t count : ENTITY_COUNTS )
+    {
+      const char* names[] = { "snapshot_save", "snapshot_restore", "snapshot_delta" };
+      for ( const std::string name : names )
+      {
+        if ( count > aSuite.mOptions.mMaxEntities || !aSuite.selected( name ) )
+          continue;
+
+        auto loader = makeLoader( aSuite, "" );
+        entt::registry registry;
+        const std::shared_ptr<sf::RenderWindow> noWindow;
+        SystemRenderer renderer( noWindow );
+        populate( registry, renderer, *loader, TileAtlas(), count, 1024 );
+
+        Snapshot::Buffer base;
+        Snapshot::save( registry, *loader, base );
+        Snapshot::Buffer snapshot;
+        std::unique_ptr<entt::registry> restored;
+        std::mt19937 random( 42 );
+
+        Benchmark::Result result = Benchmark::run( name, aSuite.mOptions.mSettings,
+          [&]()
+          {
+            restored = std::make_unique<entt::registry>();
+            auto view = registry.view<ComponentPositionWorld>();
+            for ( std::size_t moved = 0; name == "snapshot_delta" && moved < count / 50 + 1; ++moved )
+              view.raw()[random() % view.size()].mPosition.x += 1.0f;
+          },
+          [&]()
+          {
+            if ( name == "snapshot_save" )
+              Snapshot::save( registry, *loader, snapshot );
+            else if ( name == "snapshot_restore" )
+              Snapshot::restore( base, *restored, *loader );
+            else
+            {
+              Snapshot::Buffer current;
+              Snapshot::save( registry, *loader, current );
+              Snapshot::diff( base, current, snapshot );
+            }
+          } );
+        result.mCounters.push_back( { "bytes", static_cast<double>( name == "snapshot_restore" ? base.size() : snapshot.size() ) } );
+        aSuite.add( result, { { "entities", static_cast<std::int64_t>( count ) } } );
+      }
+    }
+  }
+
+  // A whole level-of-detail pyramid built from the tile images, against
+  // reading it back from the disk cache.
+  void benchTilePyramid( Suite& aSuite )
+  {
+    const AtlasPacker::Source source = AtlasPacker::tileFiles( std::string( RPG_ASSETS_DIR ) + "kenney_rpgurbanpack/Tiles/" );
+    const std::filesystem::path cacheDirectory = aSuite.mDirectory / "pyramid_cache";
+
+    for ( int size : { 256, 1024 } )
+    {
+      for ( bool cached : { false, true } )
+      {
+        const std::string name = cached ? "read_tile_pyramid" : "build_tile_pyramid";
+        if ( size > aSuite.mOptions.mMaxMapSize || !aSuite.selected( name ) )
+          continue;
+
+        const TileGrid map = makeMap( size );
+        if ( cached )
+          TilePyramid( map.getView(), source, cacheDirectory.string(), TilePyramid::Settings() ).waitIdle();
+
+        std::unique_ptr<TilePyramid> pyramid;
+        Benchmark::Result result = Benchmark::run( name, aSuite.mOptions.mSettings,
+          [&]()
+          {
+            pyramid.reset();
+            if ( !cached )
+              std::filesystem::remove_all( cacheDirectory );
+          },
+          [&]()
+          {
+            pyramid = std::make_unique<TilePyramid>( map.getView(), source, cacheDirectory.string(), TilePyramid::Settings() );
+            pyramid->waitIdle();
+          } );
+
+        const TilePyramid::Stats stats = pyramid->getStats();
+        result.mCounters.push_back( { "levels", static_cast<double>( stats.mLevelsReady ) } );
+        result.mCounters.push_back( { "bytes", static_cast<double>( stats.mBytes ) } );
+        aSuite.add( result, { { "map_size", size } } );
+      }
+    }
+  }
+
+  // Every tile id multiple of 7 blocks: about one tile in seven.
+  std::vector<bool> syntheticWalkableTiles()
+  {
+    std::vector<bool> walkableTiles( Globals::TILESET_COLUMNS * Globals::TILESET_ROWS );
+    for ( std::size_t tile = 0; tile < walkableTiles.size(); ++tile )
+      walkableTiles[tile] = tile % 7 != 0;
+    return walkableTiles;
+  }
+
+  // build_pathfinder times the abstract graph of a whole map. The path cases
+  // search PATH_REQUESTS paths per operation, from random tiles to a few
+  // shared destinations, as a crowd would: find_paths_uncached searches
+  // every one, find_paths_cached reuses the routes between clusters.
+  void benchPathfinding( Suite& aSuite )
+  {
+    for ( int size : MAP_SIZES )
+    {
+      if ( size > aSuite.mOptions.mMaxMapSize || !aSuite.selected( "build_pathfinder" ) )
+        continue;
+
+      const TileGrid map = makeMap( size );
+      std::unique_ptr<Pathfinder> pathfinder;
+      aSuite.add( Benchmark::run( "build_pathfinder", aSuite.mOptions.mSettings,
+        [&]() { pathfinder.reset(); },
+        [&]() { pathfinder = std::make_unique<Pathfinder>( map.getView(), syntheticWalkableTiles(), Pathfinder::Settings() ); } ),
+        { { "map_size", size } } );
+    }
+
+    const int mapSize = std::min( aSuite.mOptions.mMaxMapSize, PATH_MAP_SIZE );
+    const TileGrid map = makeMap( mapSize );
+
+    for ( bool cached : { false, true } )
+    {
+      const std::string name = cached ? "find_paths_cached" : "find_paths_uncached";
+      if ( !aSuite.selected( name ) )
+        continue;
+
+      Pathfinder::Settings settings;
+      settings.mCacheSize = cached ? settings.mCacheSize : 0;
+      settings.mApplyBudget = sf::seconds( 60.0f );
+      Pathfinder pathfinder( map.getView(), syntheticWalkableTiles(), settings );
+
+      std::mt19937 random( 42 );
+      std::uniform_int_distribution<int> coordinate( 0, mapSize - 1 );
+      std::vector<sf::Vector2i> destinations;
+      while ( destinations.size() < 4 )
+      {
+        const sf::Vector2i tile( coordinate( random ), coordinate( random ) );
+        if ( pathfinder.isWalkable( tile ) )
+          destinations.push_back( tile );
+      }
+
+      entt::registry registry;
+      SystemMovement movement;
+      std::vector<entt::entity> entities;
+      BulkSpawn::create( registry, PATH_REQUESTS, entities );
+      ComponentPositionWorld* positions = BulkSpawn::assign<ComponentPositionWorld>( registry, entities.data(), entities.data() + PATH_REQUESTS );
+      for ( std::size_t i = 0; i < PATH_REQUESTS; ++i )
+        positions[i].mPosition = sf::Vector2f( static_cast<float>( coordinate( random ) ), static_cast<float>( coordinate( random ) ) );
+
+      Benchmark::Result result = Benchmark::run( name, aSuite.mOptions.mSettings,
+        []() {},
+        [&]()
+        {
+          for ( std::size_t i = 0; i < PATH_REQUESTS; ++i )
+            pathfinder.requestPath( registry, entities[i], destinations[i % destinations.size()], 4.0f );
+          pathfinder.waitIdle();
+          pathfinder.update( registry, movement );
+        } );
+
+      const Pathfinder::Stats stats = pathfinder.getStats();
+      result.mCounters.push_back( { "paths_per_ms", result.mMedian > 0.0 ? PATH_REQUESTS / ( result.mMedian / 1e6 ) : 0.0 } );
+      result.mCounters.push_back( { "found_ratio", stats.mRequests > 0 ? static_cast<double>( stats.mFound ) / stats.mRequests : 0.0 } );
+      result.mCounters.push_back( { "cache_hit_ratio", stats.mRequests > 0 ? static_cast<double>( stats.mCacheHits ) / stats.mRequests : 0.0 } );
+      aSuite.add( result, { { "map_size", mapSize }, { "requests", static_cast<std::int64_t>( PATH_REQUESTS ) } } );
+    }
+  }
+
+  void benchRender( Suite& aSuite )
+  {
+    struct RenderCase
+    {
+      const char*                    mName;
+      SystemRenderer::BackgroundMode mMode;
+      bool                           mCached;
+      float                          mZoom;
+      bool                           mPyramid;
+    };
+    const RenderCase cases[] =
+    {
+      { "render_chunks",         SystemRenderer::BACKGROUND_MODE_CHUNKS,  false, 1.0f,  false },
+      { "render_sprites",        SystemRenderer::BACKGROUND_MODE_SPRITES, false, 1.0f,  false },
+      { "render_chunks_cached",  SystemRenderer::BACKGROUND_MODE_CHUNKS,  true,  1.0f,  false },
+      { "render_sprites_cached", SystemRenderer::BACKGROUND_MODE_SPRITES, true,  1.0f,  false },
+      { "render_chunks_zoomed",  SystemRenderer::BACKGROUND_MODE_CHUNKS,  false, 16.0f, false },
+      { "render_pyramid_zoomed", SystemRenderer::BACKGROUND_MODE_CHUNKS,  false, 16.0f, true },
+    };
+
+    for ( const RenderCase& renderCase : cases )
+    {
+      const std::string name = renderCase.mName;
+      const SystemRenderer::BackgroundMode mode = renderCase.mMode;
+      const int mapSize = std::min( aSuite.mOptions.mMaxMapSize,
+        mode == SystemRenderer::BACKGROUND_MODE_CHUNKS ? RENDER_MAP_SIZE : MAX_SPRITE_MAP_SIZE / 4 );
+
+      for ( std::size_t count : RENDER_ENTITY_COUNTS )
+      {
+        if ( count > aSuite.mOptions.mMaxEntities || !aSuite.selected( name ) )
+          continue;
+        if ( !aSuite.mOptions.mGpu )
+        {
+          aSuite.skip( name, { { "map_size", mapSize }, { "entities", static_cast<std::int64_t>( count ) } }, "needs a GPU context" );
+          continue;
+        }
+
+        auto target = std::make_shared<sf::RenderTexture>();
+        if ( !target->create( 800, 600 ) )
+        {
+          aSuite.skip( name, { { "map_size", mapSize }, { "entities", static_cast<std::int64_t>( count ) } }, "could not create the render texture" );
+          continue;
+        }
+
+        writeMaps( aSuite, mapSize );
+        auto loader = makeLoader( aSuite, binaryMapPath( aSuite, mapSize ) );
+        entt::registry registry;
+        SystemRenderer renderer( target, mode );
+        renderer.setBackgroundCaching( renderCase.mCached );
+        renderer.getCamera().zoom( renderCase.mZoom );
+        renderer.createMap( registry, *loader );
+        if ( renderCase.mPyramid )
+        {
+          auto pyramid = std::make_shared<TilePyramid>( renderer.getMap(),
+            loader->GetAtlasSource( AssetLoader::ASSET_TILEMAP ), loader->GetCacheDirectory(), TilePyramid::Settings() );
+          pyramid->waitIdle();
+          renderer.setTilePyramid( pyramid );
+        }
+        populate( registry, renderer, *loader, *loader->GetAtlas( AssetLoader::ASSET_TILEMAP ), count, mapSize );
+
+        // Times the CPU side of a frame: culling and submitting the draw calls.
+        // The camera stands still: cached cases redraw the cache once, and
+        // pyramid cases upload their blocks once.
+        Benchmark::Result result = Benchmark::run( name, aSuite.mOptions.mSettings,
+          []() {},
+          [&]() { renderer.render( registry ); } );
+        result.mCounters.push_back( { "draw_calls", static_cast<double>( renderer.getRenderStats().mDrawCalls ) } );
+        result.mCounters.push_back( { "vertices", static_cast<double>( renderer.getRenderStats().mVertices ) } );
+        aSuite.add( result, { { "map_size", mapSize }, { "entities", static_cast<std::int64_t>( count ) } } );
+      }
+    }
+  }
+}
+
+int main( int argc, char** argv )
+{
+  Suite suite;
+  suite.mOptions.mGpu = gpuAvailable();
+
+  for ( int i = 1; i < argc; ++i )
+  {
+    if ( std::strcmp( argv[i], "--out" ) == 0 && i + 1 < argc )
+      suite.mOptions.mOut = argv[++i];
+    else if ( std::strcmp( argv[i], "--filter" ) == 0 && i + 1 < argc )
+      suite.mOptions.mFilter = argv[++i];
+    else if ( std::strcmp( argv[i], "--max-map-size" ) == 0 && i + 1 < argc )
+      suite.mOptions.mMaxMapSize = std::atoi( argv[++i] );
+    else if ( std::strcmp( argv[i], "--max-entities" ) == 0 && i + 1 < argc )
+      suite.mOptions.mMaxEntities = static_cast<std::size_t>( std::atoll( argv[++i] ) );
+    else if ( std::strcmp( argv[i], "--no-gpu" ) == 0 )
+      suite.mOptions.mGpu = false;
+    else if ( std::strcmp( argv[i], "--quick" ) == 0 )
+    {
+      suite.mOptions.mSettings.mMinRepetitions = 3;
+      suite.mOptions.mSettings.mMaxRepetitions = 10;
+      suite.mOptions.mSettings.mTimeBudget = 0.25;
+    }
+    else
+    {
+      std::cerr << "usage: bench [--out <file.json>] [--filter <text>] [--max-map-size <tiles>] [--max-entities <count>] [--quick] [--no-gpu]" << std::endl;
+      return 1;
+    }
+  }
+
+  suite.mDirectory = std::filesystem::temp_directory_path() / "rpg_bench";
+  std::filesystem::create_directories( suite.mDirectory );
+
+  benchLoadMap( suite );
+  benchAtlas( suite );
+  benchCreateMap( suite );
+  benchEditTiles( suite );
+  benchUpdateAnimation( suite );
+  benchMovement( suite );
+  benchSpawn( suite );
+  benchPathfinding( suite );
+  benchSnapshot( suite );
+  benchTilePyramid( suite );
+  benchRender( suite );
+
+  std::filesystem::remove_all( suite.mDirectory );
+
+  if ( suite.mOptions.mOut.empty() )
+  {
+    Benchmark::writeJson( std::cout, suite.mResults );
+  }
+  else
+  {
+    std::ofstream writer( suite.mOptions.mOut );
+    Benchmark::writeJson( writer, suite.mResults );
+  }
+
+  return 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "AnimationLibrary.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+AnimationClipId
+AnimationLibrary::addClip( const TileAtlas& aAtlas, const std::vector<AssetLoader::SequenceElement>& aFrames, float aDuration )
+{
+  AnimationClip clip;
+  clip.mFirstFrame = static_cast<std::uint32_t>( mFrameRects.size() );
+  mFrameRects.resize( mFrameRects.size() + aFrames.size() );
+  mFrameEnds.resize( mFrameEnds.size() + aFrames.size() );
+
+  writeClip( clip, aAtlas, aFrames, aDuration );
+
+  mClips.push_back( clip );
+  mFrameCapacities.push_back( clip.mFrameCount );
+
+  return static_cast<AnimationClipId>( mClips.size() - 1 );
+}
+
+
+void
+AnimationLibrary::replaceClip( AnimationClipId aClip, const TileAtlas& aAtlas, const std::vector<AssetLoader::SequenceElement>& aFrames, float aDuration )
+{
+  if ( aFrames.size() > mFrameCapacities[aClip] )
+  {
+    mFrameCapacities[aClip] = static_cast<std::uint32_t>( aFrames.size() );
+
+    // Lays the clips out back to back again, each in a range of its capacity.
+    std::vector<sf::IntRect> frameRects;
+    std::vector<float> frameEnds;
+    for ( std::size_t clipId = 0; clipId < mClips.size(); ++clipId )
+    {
+      AnimationClip& clip = mClips[clipId];
+      const std::uint32_t firstFrame = static_cast<std::uint32_t>( frameRects.size() );
+
+      frameRects.insert( frameRects.end(), mFrameRects.begin() + clip.mFirstFrame, mFrameRects.begin() + clip.mFirstFrame + clip.mFrameCount );
+      frameEnds.insert( frameEnds.end(), mFrameEnds.begin() + clip.mFirstFrame, mFrameEnds.begin() + clip.mFirstFrame + clip.mFrameCount );
+      frameRects.resize( firstFrame + mFrameCapacities[clipId] );
+      frameEnds.resize( firstFrame + mFrameCapacities[clipId] );
+
+      clip.mFirstFrame = firstFrame;
+    }
+
+    mFrameRects.swap( frameRects );
+    mFrameEnds.swap( frameEnds );
+  }
+
+  writeClip( mClips[aClip], aAtlas, aFrames, aDuration );
+}
+
+
+void
+AnimationLibrary::writeClip( AnimationClip& aClip, const TileAtlas& aAtlas, const std::vector<AssetLoader::SequenceElement>& aFrames, float aDuration )
+{
+  aClip.mFrameCount      = static_cast<std::uint32_t>( aFrames.size() );
+  aClip.mDuration        = aDuration;
+  aClip.mInverseDuration = 1.0f / aDuration;
+  aClip.mInverseFrameDuration = 0.0f;
+  aClip.mTexture         = aAtlas.getTextureHandle();
+
+  float ratioSum = 0.0f;
+  for ( const auto& frame : aFrames )
+    ratioSum += frame.mRatio;
+
+  bool uniform = !aFrames.empty();
+  float ratioAccumulator = 0.0f;
+  for ( std::size_t i = 0; i < aFrames.size(); ++i )
+  {
+    const AssetLoader::SequenceElement& frame = aFrames[i];
+    mFrameRects[aClip.mFirstFrame + i] = aAtlas.getTileRect( tileIdFromSpriteIndex( frame.mSpriteIndex ) );
+
+    // Ratios are normalized, so the last frame always ends with the loop.
+    ratioAccumulator += frame.mRatio;
+    mFrameEnds[aClip.mFirstFrame + i] = aDuration * ratioAccumulator / ratioSum;
+
+    uniform = uniform && std::abs( frame.mRatio - aFrames.front().mRatio ) < 1e-6f;
+  }
+
+  if ( uniform )
+    aClip.mInverseFrameDuration = aClip.mFrameCount / aDuration;
+}
+
+
+int
+AnimationLibrary::findFrame( const AnimationClip& aClip, float aTime ) const
+{
+  const int lastFrame = static_cast<int>( aClip.mFrameCount ) - 1;
+
+  if ( aClip.mInverseFrameDuration > 0.0f )
+    return std::min( static_cast<int>( aTime * aClip.mInverseFrameDuration ), lastFrame );
+
+  // First frame ending after aTime. The halving loop has a fixed trip count
+  // for a given clip and its body compiles to a conditional move.
+  const float* ends = mFrameEnds.data() + aClip.mFirstFrame;
+  int first = 0;
+  int count = static_cast<int>( aClip.mFrameCount );
+  while ( count > 1 )
+  {
+    const int half = count / 2;
+    first = ends[first + half] <= aTime ? first + half : first;
+    count -= half;
+  }
+  first += ends[first] <= aTime ? 1 : 0;
+
+  return std::min( first, lastFrame );
+}
+
+
+void
+AnimationLibrary::advance( float aDt, ComponentSpriteAnimated* aAnimations, std::size_t aCount ) const
+{
+  const AnimationClip* clips = mClips.data();
+  const float* frameEnds = mFrameEnds.data();
+
+  for ( std::size_t i = 0; i < aCount; ++i )
+  {
+    ComponentSpriteAnimated& animation = aAnimations[i];
+    const AnimationClip& clip = clips[animation.mClip];
+    const int lastFrame = static_cast<int>( clip.mFrameCount ) - 1;
+
+    // Wrap without a loop, even when aDt spans several loops.
+    float time = animation.mTimeInCurrentLoop + aDt;
+    time -= clip.mDuration * std::floor( time * clip.mInverseDuration );
+    const bool wrapped = time < animation.mTimeInCurrentLoop;
+    animation.mTimeInCurrentLoop = time;
+
+    if ( clip.mInverseFrameDuration > 0.0f )
+    {
+      animation.mCurrentSequenceElementIndex = std::min( static_cast<int>( time * clip.mInverseFrameDuration ), lastFrame );
+      continue;
+    }
+
+    int frame = wrapped ? 0 : animation.mCurrentSequenceElementIndex;
+    const float* ends = frameEnds + clip.mFirstFrame;
+    while ( frame < lastFrame && ends[frame] <= time )
+      ++frame;
+
+    animation.mCurrentSequenceElementIndex = frame;
+  }
+}
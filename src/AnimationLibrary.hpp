@@ -0,0 +1,94 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "AssetLoader.hpp"
+#include "Components.hpp"
+#include "TileAtlas.hpp"
+
+// Animation clips, built once and shared by every entity playing them.
+// Frames of all clips are stored back to back in contiguous arrays; a clip
+// is a range of them. The end time of each frame within the loop is
+// precomputed, so finding the current frame never re-sums the durations.
+struct AnimationClip
+{
+  std::uint32_t mFirstFrame { 0 };
+  std::uint32_t mFrameCount { 0 };
+  float         mDuration   { 1.0f }; // Seconds per loop.
+  float         mInverseDuration { 1.0f };
+  float         mInverseFrameDuration { 0.0f }; // Only set when every frame lasts as long, 0 otherwise.
+  TextureHandle mTexture { NO_TEXTURE };
+};
+
+class AnimationLibrary
+{
+public:
+  // Frame durations are given as ratios of aDuration. Frames are drawn from
+  // aAtlas's texture.
+  AnimationClipId addClip( const TileAtlas& aAtlas, const std::vector<AssetLoader::SequenceElement>& aFrames, float aDuration );
+
+  // Replaces the frames of aClip, e.g. when its file is reloaded; the clip
+  // keeps its id. Entities playing it must then be moved to a valid frame
+  // with findFrame(). The clip keeps its range of frames while the new ones
+  // fit in it; a clip growing past it has every clip laid out again, so
+  // repeated reloads do not grow the frame arrays.
+  void replaceClip( AnimationClipId aClip, const TileAtlas& aAtlas, const std::vector<AssetLoader::SequenceElement>& aFrames, float aDuration );
+
+  const AnimationClip& getClip( AnimationClipId aClip ) const { return mClips[aClip]; }
+
+  const sf::IntRect& getFrameRect( const AnimationClip& aClip, int aFrame ) const { return mFrameRects[aClip.mFirstFrame + aFrame]; }
+
+  std::size_t getClipCount() const { return mClips.size(); }
+
+  // Frame shown aTime seconds into the loop: O(1) for uniform clips, a
+  // branchless binary search over the frame end times otherwise.
+  int findFrame( const AnimationClip& aClip, float aTime ) const;
+
+  // Advances aCount animations, laid out contiguously, by aDt seconds. Frames
+  // are advanced from the previous index, which is O(1) per entity at any
+  // frame rate where a tick is shorter than a frame.
+  //
+  // The loop runs on the registry's components one entity at a time and is
+  // not vectorized: each entity's clip is a gather, and the frame step of a
+  // non-uniform clip is a data dependent loop. Vectorizing it would take a
+  // structure of arrays copy of the components, as SystemMovement keeps,
+  // which every clip change (moves, reloads, restored snapshots) would have
+  // to follow. bench/AnimationBench.cpp measures the loop as it is.
+  void advance( float aDt, ComponentSpriteAnimated* aAnimations, std::size_t aCount ) const;
+
+private:
+  // Fills aClip and its frames, already allocated from aClip.mFirstFrame on.
+  void writeClip( AnimationClip& aClip, const TileAtlas& aAtlas, const std::vector<AssetLoader::SequenceElement>& aFrames, float aDuration );
+
+  std::vector<AnimationClip> mClips;
+  std::vector<sf::IntRect>   mFrameRects;
+  std::vector<float>         mFrameEnds; // Seconds from the start of the loop.
+  std::vector<std::uint32_t> mFrameCapacities; // Per clip, the frames of its range.
+};
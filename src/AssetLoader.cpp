@@ -23,141 +23,599 @@
  */
 #include "AssetLoader.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <iostream>
-#include <fstream>
 #include "GlobalDefs.hpp"
+#include "MemoryTracker.hpp"
+#include "Profiler.hpp"
 
-std::shared_ptr<sf::Texture> 
-AssetLoader::GetTexture( Asset aAsset )
+AssetLoader::AssetLoader()
+  : mCacheDirectory ( Globals::CACHE_PATH )
+  , mTextureRegistry ( std::make_shared<TextureRegistry>() )
+  , mPool ( std::make_unique<ThreadPool>() )
 {
-  if ( auto asset = mTextures.find( aAsset );
-    asset != mTextures.end() )
-    return asset->second;
+  mAtlasSources[ASSET_TILEMAP] = AtlasPacker::tileFiles( Globals::TILES_PATH );
+}
 
-  auto newTexture = std::make_shared<sf::Texture>();
 
-  std::string path;
+AssetLoader::~AssetLoader()
+{
+  // Let the workers finish before the state they write to goes away.
+  mPool.reset();
+}
+
+
+void 
+AssetLoader::SetPath( Asset aAsset, const std::string& aPath )
+{
+  mPaths[aAsset] = aPath;
+}
+
+
+std::string
+AssetLoader::GetPath( Asset aAsset ) const
+{
+  if ( !mPaths[aAsset].empty() )
+    return mPaths[aAsset];
 
   switch ( aAsset )
   {
-  case ASSET_TILEMAP: path = Globals::TILE_MAP;
+  case ASSET_TILEMAP: return Globals::TILE_MAP;
+  case ASSET_MAP: return Globals::MAP;
+  case ASSET_MAIN_ANIMATION: return Globals::ANIMATION;
+  case ASSET_COUNT:
+    assert( false );
+    break;
   }
 
-  if ( !newTexture->loadFromFile( path ) )
+  return std::string();
+}
+
+
+std::string
+AssetLoader::GetBinaryMapPath( Asset aAsset ) const
+{
+  if ( mPaths[aAsset].empty() )
+    return Globals::MAP_BINARY;
+
+  return mPaths[aAsset].substr( 0, mPaths[aAsset].find_last_of( '.' ) ) + ".bin";
+}
+
+
+bool
+AssetLoader::ReadMainAnimations( const std::string& aPath, Animations& aAnimations, TextParser::Error* aError )
+{
+  MappedFile file;
+  if ( !TextParser::openFile( aPath, file, aError ) )
+    return false;
+
+  const char* text = static_cast<const char*>( file.getData() );
+  TextParser::Reader reader( text, text + file.getSize() );
+
+  Animations animations( ComponentCharacterAnimation::NUM_DIRECTIONS );
+  bool read = true;
+
+  // We have 4 directions. 
+  for ( std::vector<SequenceElement>& sequence : animations )
   {
-    assert( false );
+    int elementsInSequence = 0;
+    // An empty sequence has no frame to show.
+    read = read && reader.read( elementsInSequence, 1 );
+
+    for ( int sequenceIndex = 0; read && sequenceIndex < elementsInSequence; ++sequenceIndex )
+    {
+      reader.skipSpaces();
+      const char* elementStart = reader.getPosition();
+
+      SequenceElement sequenceElement;
+      read = reader.read( sequenceElement.mSpriteIndex.x ) && reader.read( sequenceElement.mSpriteIndex.y );
+      if ( read && !isInTileset( sequenceElement.mSpriteIndex ) )
+        read = reader.fail( elementStart, "sprite index outside the tileset" );
+
+      // The ratios are divided by their sum.
+      reader.skipSpaces();
+      const char* ratioStart = reader.getPosition();
+      read = read && reader.read( sequenceElement.mRatio );
+      if ( read && !( std::isfinite( sequenceElement.mRatio ) && sequenceElement.mRatio > 0.0f ) )
+        read = reader.fail( ratioStart, "frame ratio not positive" );
+      if ( read )
+        sequence.push_back( sequenceElement );
+    }
   }
 
-  mTextures[aAsset] = newTexture;
+  // A file caught halfway through a write reads short.
+  read = read && reader.expectEnd();
 
-  return newTexture;
+  if ( !read )
+  {
+    if ( aError != nullptr )
+      reader.getError( text, *aError );
+    return false;
+  }
+
+  aAnimations.swap( animations );
+  return true;
 }
 
-sf::Vector2i 
-AssetLoader::GetMapSize( Asset aAsset )
+
+void 
+AssetLoader::SetAtlasSource( Asset aAsset, const AtlasPacker::Source& aSource )
 {
-  if ( mMaps.count( aAsset ) == 0 )
-    loadMap( aAsset );
+  mAtlasSources[aAsset] = aSource;
+}
 
-  const auto& map = mMaps.find( aAsset )->second;
 
-  return { static_cast<int>( map[0].size() ), static_cast<int>( map.size() ) };
+void 
+AssetLoader::SetCacheDirectory( const std::string& aDirectory )
+{
+  mCacheDirectory = aDirectory;
 }
 
 
-std::vector<std::vector<sf::Vector2i>> 
-AssetLoader::GetMapData( Asset aAsset )
+std::shared_future<std::shared_ptr<sf::Texture>> 
+AssetLoader::RequestTexture( Asset aAsset )
+{
+  PROFILE_ZONE( "RequestTexture" );
+
+  if ( !mTextureRequests[aAsset].valid() )
+  {
+    mTextureRequests[aAsset] = mTexturePromises[aAsset].get_future().share();
+
+    if ( mHeadless )
+    {
+      mTextures[aAsset] = std::make_shared<sf::Texture>();
+      mTexturePromises[aAsset].set_value( mTextures[aAsset] );
+      return mTextureRequests[aAsset];
+    }
+
+    startJob();
+    mPool->submit( [this, aAsset]()
+    {
+      try
+      {
+        decodeTexture( aAsset );
+      }
+      catch ( ... )
+      {
+        mTexturePromises[aAsset].set_exception( std::current_exception() );
+      }
+      finishJob();
+    } );
+  }
+
+  return mTextureRequests[aAsset];
+}
+
+
+std::shared_future<std::shared_ptr<const TileAtlas>> 
+AssetLoader::RequestAtlas( Asset aAsset, std::vector<TileId> aTiles, const AtlasPacker::Settings& aSettings )
 {
-  if ( mMaps.count( aAsset ) == 0 )
-    loadMap( aAsset );
+  PROFILE_ZONE( "RequestAtlas" );
+
+  if ( !mAtlasRequests[aAsset].valid() )
+  {
+    mAtlasRequests[aAsset] = mAtlasPromises[aAsset].get_future().share();
+
+    if ( mHeadless )
+    {
+      mAtlasPromises[aAsset].set_value( std::make_shared<const TileAtlas>() );
+      return mAtlasRequests[aAsset];
+    }
+
+    std::sort( aTiles.begin(), aTiles.end() );
+    aTiles.erase( std::unique( aTiles.begin(), aTiles.end() ), aTiles.end() );
+
+    startJob();
+    mPool->submit( [this, aAsset, aTiles, aSettings]()
+    {
+      try
+      {
+        buildAtlas( aAsset, aTiles, aSettings );
+      }
+      catch ( ... )
+      {
+        mAtlasPromises[aAsset].set_exception( std::current_exception() );
+      }
+      finishJob();
+    } );
+  }
+
+  return mAtlasRequests[aAsset];
+}
+
 
-  const auto& map = mMaps.find( aAsset )->second;
+std::shared_future<TileGridView> 
+AssetLoader::RequestMap( Asset aAsset )
+{
+  PROFILE_ZONE( "RequestMap" );
+
+  if ( !mMapRequests[aAsset].valid() )
+  {
+    // The future keeps what loadMap() throws; the job ends either way, or
+    // WaitAll() would never return.
+    startJob();
+    mMapRequests[aAsset] = mPool->submit( [this, aAsset]() 
+    {
+      try
+      {
+        TileGridView view = loadMap( aAsset );
+        finishJob();
+        return view;
+      }
+      catch ( ... )
+      {
+        finishJob();
+        throw;
+      }
+    } ).share();
+  }
+
+  return mMapRequests[aAsset];
+}
+
+
+std::shared_future<AssetLoader::Animations> 
+AssetLoader::RequestMainAnimations( Asset aAsset )
+{
+  PROFILE_ZONE( "RequestMainAnimations" );
+
+  if ( !mAnimationRequests[aAsset].valid() )
+  {
+    startJob();
+    mAnimationRequests[aAsset] = mPool->submit( [this, aAsset]() 
+    {
+      try
+      {
+        Animations animations = loadMainAnimations( aAsset );
+        finishJob();
+        return animations;
+      }
+      catch ( ... )
+      {
+        finishJob();
+        throw;
+      }
+    } ).share();
+  }
 
-  return map;
+  return mAnimationRequests[aAsset];
 }
 
 
 void 
-AssetLoader::loadMap( Asset aAsset )
+AssetLoader::ProcessUploads( sf::Time aBudget )
 {
-  if ( mMaps.count( aAsset ) > 0 )
-    return;
+  PROFILE_ZONE( "ProcessUploads" );
+  MEMORY_TAG( TAG_ASSETS );
 
-  std::string path;
+  sf::Clock clock;
 
-  switch ( aAsset )
+  do
+  {
+    PendingUpload upload;
+
+    {
+      std::lock_guard<std::mutex> lock( mUploadsMutex );
+      if ( mUploads.empty() )
+        return;
+
+      upload = std::move( mUploads.front() );
+      mUploads.pop_front();
+    }
+
+    auto newTexture = std::make_shared<sf::Texture>();
+
+    if ( !newTexture->loadFromImage( upload.mImage ) )
+    {
+      assert( false );
+    }
+
+    const TextureHandle handle = mTextureRegistry->add( newTexture );
+
+    if ( upload.mAtlas )
+    {
+      mAtlasPromises[upload.mAsset].set_value( std::make_shared<const TileAtlas>( newTexture, handle, std::move( upload.mTilePositions ) ) );
+      continue;
+    }
+
+    mTextures[upload.mAsset] = newTexture;
+    mTexturePromises[upload.mAsset].set_value( newTexture );
+  } while ( clock.getElapsedTime() < aBudget );
+}
+
+
+void 
+AssetLoader::WaitAll()
+{
+  PROFILE_ZONE( "WaitAll" );
+
+  for ( ;; )
   {
-  case ASSET_MAP: path = Globals::MAP;
+    ProcessUploads( sf::Time::Zero );
+
+    std::unique_lock<std::mutex> lock( mUploadsMutex );
+    if ( mPendingJobs == 0 && mUploads.empty() )
+      return;
+
+    mProgress.wait( lock, [this]() { return mPendingJobs == 0 || !mUploads.empty(); } );
   }
+}
 
-  std::ifstream reader( path );
 
-  if ( !reader.is_open() )
+std::string
+AssetLoader::GetLoadError( Asset aAsset )
+{
+  std::lock_guard<std::mutex> lock( mUploadsMutex );
+  return mLoadErrors[aAsset];
+}
+
+
+template<typename T>
+const T& 
+AssetLoader::wait( const std::shared_future<T>& aFuture )
+{
+  while ( aFuture.wait_for( std::chrono::seconds( 0 ) ) != std::future_status::ready )
   {
-    assert( false );
+    ProcessUploads( sf::Time::Zero );
+
+    std::unique_lock<std::mutex> lock( mUploadsMutex );
+    mProgress.wait_for( lock, std::chrono::milliseconds( 1 ) );
   }
 
-  int width;
-  int height;
+  return aFuture.get();
+}
+
 
-  reader >> width >> height;
+void 
+AssetLoader::decodeTexture( Asset aAsset )
+{
+  PROFILE_ZONE( "decodeTexture" );
+  MEMORY_TAG( TAG_ASSETS );
 
-  std::vector<std::vector<sf::Vector2i>> map;
-  map.resize( height );
+  const std::string path = GetPath( aAsset );
 
-  for ( int y = 0; y < height; ++y )
+  PendingUpload upload;
+  upload.mAsset = aAsset;
+
+  if ( !upload.mImage.loadFromFile( path ) )
   {
-    map[y].resize( width );
+    assert( false );
+  }
+
+  {
+    std::lock_guard<std::mutex> lock( mUploadsMutex );
+    mUploads.push_back( std::move( upload ) );
+  }
+}
 
-    for ( int x = 0; x < width; ++x )
+
+void 
+AssetLoader::buildAtlas( Asset aAsset, const std::vector<TileId>& aTiles, const AtlasPacker::Settings& aSettings )
+{
+  PROFILE_ZONE( "buildAtlas" );
+  MEMORY_TAG( TAG_ASSETS );
+
+  const AtlasPacker::Source& source = mAtlasSources[aAsset];
+  const std::string cachePath = AtlasPacker::getCachePath( mCacheDirectory, AtlasPacker::hashInputs( source, aTiles, aSettings ) );
+
+  AtlasPacker::Packed packed;
+  if ( !AtlasPacker::readCache( cachePath, packed ) )
+  {
+    if ( !AtlasPacker::pack( source, aTiles, aSettings, packed ) )
     {
-      reader >> map[y][x].x >> map[y][x].y;
+      assert( false );
     }
+
+    // A missing cache only costs the next start a repack.
+    AtlasPacker::writeCache( cachePath, packed );
   }
-  
-  reader.close();
 
-  mMaps[aAsset] = map;
+  PendingUpload upload;
+  upload.mAsset         = aAsset;
+  upload.mImage         = std::move( packed.mImage );
+  upload.mAtlas         = true;
+  upload.mTilePositions = std::move( packed.mTilePositions );
+
+  {
+    std::lock_guard<std::mutex> lock( mUploadsMutex );
+    mUploads.push_back( std::move( upload ) );
+  }
 }
 
-std::vector<std::vector<AssetLoader::SequenceElement>> 
-AssetLoader::GetMainAnimations( Asset aAsset )
+
+void
+AssetLoader::setLoadError( Asset aAsset, const std::string& aError )
 {
-  std::vector<std::vector<SequenceElement>> retVal;
+  std::cerr << aError << std::endl;
 
-  std::string path;
+  std::lock_guard<std::mutex> lock( mUploadsMutex );
+  mLoadErrors[aAsset] = aError;
+}
 
-  switch ( aAsset )
+
+void 
+AssetLoader::startJob()
+{
+  std::lock_guard<std::mutex> lock( mUploadsMutex );
+  ++mPendingJobs;
+}
+
+
+void 
+AssetLoader::finishJob()
+{
   {
-  case ASSET_MAIN_ANIMATION: path = Globals::ANIMATION;
+    std::lock_guard<std::mutex> lock( mUploadsMutex );
+    --mPendingJobs;
   }
+  mProgress.notify_all();
+}
+
+
+std::shared_ptr<sf::Texture> 
+AssetLoader::GetTexture( Asset aAsset )
+{
+  if ( auto asset = mTextures.find( aAsset );
+    asset != mTextures.end() )
+    return asset->second;
 
-  std::ifstream reader( path );
+  return wait( RequestTexture( aAsset ) );
+}
 
-  if ( !reader.is_open() )
+std::shared_ptr<const TileAtlas> 
+AssetLoader::GetAtlas( Asset aAsset )
+{
+  if ( !mAtlasRequests[aAsset].valid() )
   {
-    assert( false );
+    std::vector<TileId> tiles( Globals::TILESET_COLUMNS * Globals::TILESET_ROWS );
+    for ( std::size_t tile = 0; tile < tiles.size(); ++tile )
+      tiles[tile] = static_cast<TileId>( tile );
+    RequestAtlas( aAsset, tiles );
   }
 
-  // We have 4 directions. 
-  for ( int i = 0; i < ComponentCharacterAnimation::NUM_DIRECTIONS; ++i )
+  return wait( mAtlasRequests[aAsset] );
+}
+
+
+TextureHandle
+AssetLoader::GetTextureHandle( Asset aAsset )
+{
+  return mTextureRegistry->add( GetTexture( aAsset ) );
+}
+
+
+bool
+AssetLoader::FindTextureAsset( TextureHandle aHandle, Asset& aAsset, bool& aAtlas ) const
+{
+  if ( aHandle == NO_TEXTURE || aHandle > mTextureRegistry->size() )
+    return false;
+
+  for ( int asset = 0; asset < ASSET_COUNT; ++asset )
   {
-    std::vector<SequenceElement> thisSequence;
-    int elementsInSequence;
-    reader >> elementsInSequence;
-    for ( int sequenceIndex = 0; sequenceIndex < elementsInSequence; ++sequenceIndex )
+    const auto& request = mAtlasRequests[asset];
+    if ( request.valid() && request.wait_for( std::chrono::seconds( 0 ) ) == std::future_status::ready
+      && request.get() && request.get()->getTextureHandle() == aHandle )
     {
-      SequenceElement sequenceElement;
+      aAsset = static_cast<Asset>( asset );
+      aAtlas = true;
+      return true;
+    }
+  }
+
+  const sf::Texture* texture = mTextureRegistry->get( aHandle );
+  for ( const auto& asset : mTextures )
+  {
+    if ( asset.second.get() == texture )
+    {
+      aAsset = asset.first;
+      aAtlas = false;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+sf::Vector2i 
+AssetLoader::GetMapSize( Asset aAsset )
+{
+  return GetMapData( aAsset ).getSize();
+}
+
+
+TileGridView 
+AssetLoader::GetMapData( Asset aAsset )
+{
+  return wait( RequestMap( aAsset ) );
+}
+
+
+const AssetLoader::Animations& 
+AssetLoader::GetMainAnimations( Asset aAsset )
+{
+  return wait( RequestMainAnimations( aAsset ) );
+}
 
-      reader >> sequenceElement.mSpriteIndex.x >> sequenceElement.mSpriteIndex.y >> sequenceElement.mRatio;
 
-      thisSequence.push_back( sequenceElement );
+AssetLoader::MemoryStats
+AssetLoader::GetMemoryStats()
+{
+  MemoryStats stats;
+
+  for ( const auto& texture : mTextures )
+  {
+    const sf::Vector2u size = texture.second->getSize();
+    stats.mTextureBytes += static_cast<std::size_t>( size.x ) * size.y * 4;
+  }
+
+  for ( int asset = 0; asset < ASSET_COUNT; ++asset )
+  {
+    const auto& atlas = mAtlasRequests[asset];
+    if ( atlas.valid() && atlas.wait_for( std::chrono::seconds( 0 ) ) == std::future_status::ready && atlas.get() )
+    {
+      const sf::Vector2u size = atlas.get()->getTexture()->getSize();
+      stats.mAtlasBytes += static_cast<std::size_t>( size.x ) * size.y * 4;
+    }
+
+    // mMaps is written by the worker until the request is ready.
+    const auto& map = mMapRequests[asset];
+    if ( map.valid() && map.wait_for( std::chrono::seconds( 0 ) ) == std::future_status::ready )
+    {
+      const sf::Vector2i gridSize = mMaps[asset].mGrid.getSize();
+      const sf::Vector2i size = map.get().getSize();
+      stats.mMapBytes += static_cast<std::size_t>( gridSize.x ) * gridSize.y * sizeof( TileId ) + mMaps[asset].mFile.getSize();
+      stats.mTiles += static_cast<std::size_t>( size.x ) * size.y;
     }
-    retVal.push_back( thisSequence );
   }
 
-  reader.close();
+  std::lock_guard<std::mutex> lock( mUploadsMutex );
+  for ( const PendingUpload& upload : mUploads )
+  {
+    const sf::Vector2u size = upload.mImage.getSize();
+    stats.mUploadBytes += static_cast<std::size_t>( size.x ) * size.y * 4;
+  }
+
+  return stats;
+}
+
+
+TileGridView 
+AssetLoader::loadMap( Asset aAsset )
+{
+  PROFILE_ZONE( "loadMap" );
+  MEMORY_TAG( TAG_ASSETS );
+
+  LoadedMap& map = mMaps[aAsset];
+
+  const std::string path = GetPath( aAsset );
+  const std::string binaryPath = GetBinaryMapPath( aAsset );
+
+  // Prefer the binary file, read in place; the text file is the fallback.
+  if ( MapFile::openBinary( binaryPath, map.mFile, map.mGrid, map.mView ) )
+    return map.mView;
+
+  TextParser::Error error;
+  if ( !MapFile::readText( path, map.mGrid, &error, mJobSystem ) )
+    setLoadError( aAsset, TextParser::describe( path, error ) );
+
+  map.mView = map.mGrid.getView();
+  return map.mView;
+}
+
+AssetLoader::Animations 
+AssetLoader::loadMainAnimations( Asset aAsset )
+{
+  PROFILE_ZONE( "loadMainAnimations" );
+  MEMORY_TAG( TAG_ASSETS );
+
+  Animations retVal;
+
+  TextParser::Error error;
+  if ( !ReadMainAnimations( GetPath( aAsset ), retVal, &error ) )
+    setLoadError( aAsset, TextParser::describe( GetPath( aAsset ), error ) );
 
   return retVal;
 }
@@ -24,10 +24,20 @@
 #pragma once
 
 #include <array>
+#include <condition_variable>
+#include <deque>
+#include <future>
 #include <map>
+#include <mutex>
 
 #include <SFML/Graphics.hpp>
+#include "AtlasPacker.hpp"
 #include "Components.hpp"
+#include "MapFile.hpp"
+#include "TextParser.hpp"
+#include "TextureRegistry.hpp"
+#include "ThreadPool.hpp"
+#include "TileAtlas.hpp"
 
 class AssetLoader
 {
@@ -36,25 +46,175 @@ public:
   {
     ASSET_TILEMAP,
     ASSET_MAP,
-    ASSET_MAIN_ANIMATION
+    ASSET_MAIN_ANIMATION,
+    ASSET_COUNT
   };
 
-  std::shared_ptr<sf::Texture> GetTexture( Asset aAsset );
-
-  sf::Vector2i GetMapSize( Asset aAsset );
-  std::vector<std::vector<sf::Vector2i>> GetMapData( Asset aAsset );
-
   struct SequenceElement
   {
     sf::Vector2i mSpriteIndex;
     float mRatio {0.0f};
   };
-  std::vector<std::vector<SequenceElement>> GetMainAnimations( Asset aAsset );
+  typedef std::vector<std::vector<SequenceElement>> Animations;
+
+  // Memory held by the loader. Textures are counted at 4 bytes a pixel,
+  // without what the driver adds.
+  struct MemoryStats
+  {
+    std::size_t mTextureBytes { 0 };
+    std::size_t mAtlasBytes { 0 };
+    std::size_t mMapBytes { 0 };    // Parsed grids and memory mapped files.
+    std::size_t mTiles { 0 };
+    std::size_t mUploadBytes { 0 }; // Decoded images waiting for their upload.
+  };
+
+  AssetLoader();
+  ~AssetLoader();
+
+  // Loads aAsset from aPath instead of its default file; call it before the
+  // asset is requested. A map path names the text map: a binary map next to
+  // it, with a .bin extension, is preferred when it exists.
+  void SetPath( Asset aAsset, const std::string& aPath );
+
+  // The file aAsset is loaded from: its SetPath() override or its default.
+  std::string GetPath( Asset aAsset ) const;
+
+  // The binary map read instead of the text map at GetPath() when it exists.
+  std::string GetBinaryMapPath( Asset aAsset ) const;
+
+  // Parses an animation file; false when it is missing or malformed, with
+  // aError, when given, saying where. Safe to call from any thread.
+  static bool ReadMainAnimations( const std::string& aPath, Animations& aAnimations, TextParser::Error* aError = nullptr );
+
+  // Tiles packed into aAsset's atlas: by default the individual tile images
+  // of the tileset, in Globals::TILES_PATH.
+  void SetAtlasSource( Asset aAsset, const AtlasPacker::Source& aSource );
+  const AtlasPacker::Source& GetAtlasSource( Asset aAsset ) const { return mAtlasSources[aAsset]; }
+
+  // Where packed atlases are cached, Globals::CACHE_PATH by default.
+  void SetCacheDirectory( const std::string& aDirectory );
+  const std::string& GetCacheDirectory() const { return mCacheDirectory; }
+
+  // Large text maps are parsed in parallel on aJobSystem, which must outlive
+  // the loads. Without one they are parsed on a single worker.
+  void SetJobSystem( JobSystem* aJobSystem ) { mJobSystem = aJobSystem; }
+  JobSystem* GetJobSystem() const { return mJobSystem; }
+
+  // Without a window there is no GL context to upload to. Headless, texture
+  // requests give an empty texture and atlas requests the tileset's layout
+  // without a texture, and neither reads its image. Set before any request.
+  void SetHeadless( bool aHeadless ) { mHeadless = aHeadless; }
+
+  // Asynchronous loading. Files are read, parsed and decoded on worker
+  // threads; textures are uploaded on the render thread by ProcessUploads()
+  // or WaitAll(). Requesting an asset twice returns the same future. A load
+  // that throws completes its future with the exception. All AssetLoader
+  // methods are called from the render thread.
+  std::shared_future<std::shared_ptr<sf::Texture>> RequestTexture( Asset aAsset );
+  std::shared_future<TileGridView> RequestMap( Asset aAsset );
+  std::shared_future<Animations> RequestMainAnimations( Asset aAsset );
+
+  // Packs aTiles of aAsset's tileset into an atlas, or reads it from the
+  // cache when the same inputs were packed before. Only the first request of
+  // an asset is honored, later ones return its future.
+  std::shared_future<std::shared_ptr<const TileAtlas>> RequestAtlas( Asset aAsset, std::vector<TileId> aTiles, const AtlasPacker::Settings& aSettings = AtlasPacker::Settings() );
+
+  // Uploads decoded images until aBudget is spent, at least one per call.
+  void ProcessUploads( sf::Time aBudget );
+
+  // Blocks until every request made so far is complete.
+  void WaitAll();
+
+  // Why a map or animation file could not be parsed, as printed when it
+  // failed; empty when it loaded. Its data is then empty: check before use.
+  std::string GetLoadError( Asset aAsset );
+
+  // Synchronous access, requesting and waiting for the asset if needed.
+  std::shared_ptr<sf::Texture> GetTexture( Asset aAsset );
+
+  // Requests an atlas of the whole tileset when none was requested.
+  std::shared_ptr<const TileAtlas> GetAtlas( Asset aAsset );
+
+  // Every texture uploaded, atlases included, is registered here; components
+  // hold their handles.
+  const std::shared_ptr<TextureRegistry>& GetTextureRegistry() const { return mTextureRegistry; }
+  TextureHandle GetTextureHandle( Asset aAsset );
+
+  // The asset whose texture, or whose atlas when aAtlas is set, aHandle
+  // refers to. False for a texture not loaded by this loader.
+  bool FindTextureAsset( TextureHandle aHandle, Asset& aAsset, bool& aAtlas ) const;
+
+  sf::Vector2i GetMapSize( Asset aAsset );
+
+  // The view stays valid for the lifetime of the AssetLoader.
+  TileGridView GetMapData( Asset aAsset );
+
+  const Animations& GetMainAnimations( Asset aAsset );
+
+  // Only counts what is loaded: pending requests are not waited for.
+  MemoryStats GetMemoryStats();
 
 private:
 
-  void loadMap( Asset aAsset );
+  // Render thread side of a blocking wait: keeps uploading textures, since
+  // the awaited asset may be one of them.
+  template<typename T>
+  const T& wait( const std::shared_future<T>& aFuture );
+
+  void startJob();
+  void finishJob();
+  void setLoadError( Asset aAsset, const std::string& aError );
+
+  void decodeTexture( Asset aAsset );
+  void buildAtlas( Asset aAsset, const std::vector<TileId>& aTiles, const AtlasPacker::Settings& aSettings );
+  TileGridView loadMap( Asset aAsset );
+  Animations loadMainAnimations( Asset aAsset );
+
+  // A map is either viewed in place in its memory mapped binary file, or
+  // held in mGrid when it was parsed from text or stored with 1-byte tiles.
+  struct LoadedMap
+  {
+    MappedFile   mFile;
+    TileGrid     mGrid;
+    TileGridView mView;
+  };
+
+  // A decoded image waiting for its upload on the render thread. Atlases
+  // also carry the position of their tiles.
+  struct PendingUpload
+  {
+    Asset mAsset;
+    sf::Image mImage;
+    bool mAtlas { false };
+    std::vector<sf::Vector2i> mTilePositions;
+  };
+
+  std::array<std::string, ASSET_COUNT> mPaths; // Overrides, empty for the default file.
+  std::array<AtlasPacker::Source, ASSET_COUNT> mAtlasSources;
+  std::string mCacheDirectory;
+  JobSystem* mJobSystem { nullptr };
+  bool mHeadless { false };
 
   std::map<Asset, std::shared_ptr<sf::Texture>> mTextures;
-  std::map<Asset, std::vector<std::vector<sf::Vector2i>>> mMaps;
+  std::shared_ptr<TextureRegistry> mTextureRegistry;
+  std::array<LoadedMap, ASSET_COUNT> mMaps;
+
+  std::array<std::promise<std::shared_ptr<sf::Texture>>, ASSET_COUNT> mTexturePromises;
+  std::array<std::shared_future<std::shared_ptr<sf::Texture>>, ASSET_COUNT> mTextureRequests;
+  std::array<std::shared_future<TileGridView>, ASSET_COUNT> mMapRequests;
+  std::array<std::shared_future<Animations>, ASSET_COUNT> mAnimationRequests;
+  std::array<std::promise<std::shared_ptr<const TileAtlas>>, ASSET_COUNT> mAtlasPromises;
+  std::array<std::shared_future<std::shared_ptr<const TileAtlas>>, ASSET_COUNT> mAtlasRequests;
+
+  // Worker jobs not finished yet, decoded images not uploaded yet and load
+  // errors, guarded by mUploadsMutex. mProgress is notified when the first
+  // two change.
+  int                       mPendingJobs { 0 };
+  std::deque<PendingUpload> mUploads;
+  std::array<std::string, ASSET_COUNT> mLoadErrors;
+  std::mutex                mUploadsMutex;
+  std::condition_variable   mProgress;
+
+  // Last member: destroyed first, so the workers never outlive the state they use.
+  std::unique_ptr<ThreadPool> mPool;
 };
\ No newline at end of file
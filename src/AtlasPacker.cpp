@@ -0,0 +1,248 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "AtlasPacker.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "GlobalDefs.hpp"
+#include "Hash.hpp"
+#include "MapFile.hpp"
+
+namespace
+{
+  struct CacheHeader
+  {
+    char          mMagic[4];
+    std::uint16_t mVersion;
+    std::uint16_t mTileSize;
+    std::uint32_t mWidth;
+    std::uint32_t mHeight;
+    std::uint32_t mPositionCount; // Followed by as many (x, y) pairs of int32, then the RGBA pixels.
+  };
+  static_assert( sizeof( CacheHeader ) == 20, "AtlasPacker cache header layout changed." );
+
+  // Copies the tile at aSourcePosition into aAtlas at aPosition, repeating its
+  // edge pixels aExtrusion times outwards.
+  void copyExtruded( sf::Image& aAtlas, sf::Vector2i aPosition, const sf::Image& aSource, sf::Vector2i aSourcePosition, int aExtrusion )
+  {
+    const int size = Globals::TILE_SIZE;
+
+    for ( int y = -aExtrusion; y < size + aExtrusion; ++y )
+    {
+      const int sourceY = aSourcePosition.y + std::min( std::max( y, 0 ), size - 1 );
+
+      for ( int x = -aExtrusion; x < size + aExtrusion; ++x )
+      {
+        const int sourceX = aSourcePosition.x + std::min( std::max( x, 0 ), size - 1 );
+        aAtlas.setPixel( aPosition.x + x, aPosition.y + y, aSource.getPixel( sourceX, sourceY ) );
+      }
+    }
+  }
+}
+
+AtlasPacker::Source
+AtlasPacker::tileFiles( const std::string& aDirectory )
+{
+  Source source;
+
+  for ( int tile = 0; tile < Globals::TILESET_COLUMNS * Globals::TILESET_ROWS; ++tile )
+  {
+    char name[16];
+    std::snprintf( name, sizeof( name ), "tile_%04d.png", tile );
+    source.mTileFiles.push_back( aDirectory + name );
+  }
+
+  return source;
+}
+
+
+bool
+AtlasPacker::pack( const Source& aSource, const std::vector<TileId>& aTiles, const Settings& aSettings, Packed& aPacked )
+{
+  const int size    = Globals::TILE_SIZE;
+  const int pitch   = size + 2 * aSettings.mExtrusion + aSettings.mGutter;
+  const int count   = static_cast<int>( aTiles.size() );
+  const int columns = std::max( 1, static_cast<int>( std::ceil( std::sqrt( static_cast<double>( count ) ) ) ) );
+  const int rows    = std::max( 1, ( count + columns - 1 ) / columns );
+
+  aPacked.mImage.create(
+    static_cast<unsigned>( aSettings.mGutter + columns * pitch ),
+    static_cast<unsigned>( aSettings.mGutter + rows * pitch ),
+    sf::Color::Transparent );
+  aPacked.mTilePositions.assign( aTiles.empty() ? 0 : aTiles.back() + 1u, sf::Vector2i( -1, -1 ) );
+
+  sf::Image sheet;
+  if ( aSource.mTileFiles.empty() && !sheet.loadFromFile( aSource.mSheet ) )
+    return false;
+
+  for ( int i = 0; i < count; ++i )
+  {
+    const TileId tile = aTiles[i];
+    const sf::Vector2i position(
+      aSettings.mGutter + ( i % columns ) * pitch + aSettings.mExtrusion,
+      aSettings.mGutter + ( i / columns ) * pitch + aSettings.mExtrusion );
+
+    if ( aSource.mTileFiles.empty() )
+    {
+      const sf::Vector2i sourcePosition = sf::Vector2i( aSource.mSheetMargin, aSource.mSheetMargin ) + tileSpriteIndex( tile ) * ( size + aSource.mSheetSpacing );
+      if ( sourcePosition.x + size > static_cast<int>( sheet.getSize().x ) || sourcePosition.y + size > static_cast<int>( sheet.getSize().y ) )
+        return false;
+
+      copyExtruded( aPacked.mImage, position, sheet, sourcePosition, aSettings.mExtrusion );
+    }
+    else
+    {
+      sf::Image image;
+      if ( tile >= aSource.mTileFiles.size() || !image.loadFromFile( aSource.mTileFiles[tile] ) )
+        return false;
+      if ( image.getSize() != sf::Vector2u( size, size ) )
+        return false;
+
+      copyExtruded( aPacked.mImage, position, image, sf::Vector2i( 0, 0 ), aSettings.mExtrusion );
+    }
+
+    aPacked.mTilePositions[tile] = position;
+  }
+
+  return true;
+}
+
+
+std::uint64_t
+AtlasPacker::hashInputs( const Source& aSource, const std::vector<TileId>& aTiles, const Settings& aSettings )
+{
+  Hash hash;
+  hash.add( CACHE_VERSION );
+  hash.add( Globals::TILE_SIZE );
+  hash.add( aSettings.mGutter );
+  hash.add( aSettings.mExtrusion );
+  hash.add( aTiles.size() );
+  hash.add( aTiles.data(), aTiles.size() * sizeof( TileId ) );
+
+  if ( aSource.mTileFiles.empty() )
+  {
+    hash.add( aSource.mSheetMargin );
+    hash.add( aSource.mSheetSpacing );
+    hash.addString( aSource.mSheet );
+    hash.addFileContents( aSource.mSheet );
+  }
+  else
+  {
+    // Only the files pack() reads.
+    for ( TileId tile : aTiles )
+    {
+      const std::string& path = tile < aSource.mTileFiles.size() ? aSource.mTileFiles[tile] : std::string();
+      hash.addString( path );
+      hash.addFileContents( path );
+    }
+  }
+
+  return hash.get();
+}
+
+
+std::string
+AtlasPacker::getCachePath( const std::string& aDirectory, std::uint64_t aHash )
+{
+  char name[32];
+  std::snprintf( name, sizeof( name ), "atlas_%016llx.bin", static_cast<unsigned long long>( aHash ) );
+  return ( std::filesystem::path( aDirectory ) / name ).string();
+}
+
+
+bool
+AtlasPacker::readCache( const std::string& aPath, Packed& aPacked )
+{
+  MappedFile file;
+  if ( !file.open( aPath ) || file.getSize() < sizeof( CacheHeader ) )
+    return false;
+
+  CacheHeader header;
+  std::memcpy( &header, file.getData(), sizeof( header ) );
+  if ( std::memcmp( header.mMagic, CACHE_MAGIC, sizeof( CACHE_MAGIC ) ) != 0
+    || header.mVersion != CACHE_VERSION
+    || header.mTileSize != Globals::TILE_SIZE )
+    return false;
+
+  const std::size_t positionsBytes = header.mPositionCount * 2u * sizeof( std::int32_t );
+  const std::size_t pixelsBytes    = static_cast<std::size_t>( header.mWidth ) * header.mHeight * 4u;
+  if ( file.getSize() != sizeof( header ) + positionsBytes + pixelsBytes )
+    return false;
+
+  const std::uint8_t* data = static_cast<const std::uint8_t*>( file.getData() ) + sizeof( header );
+
+  std::vector<std::int32_t> positions( header.mPositionCount * 2u );
+  std::memcpy( positions.data(), data, positionsBytes );
+  aPacked.mTilePositions.resize( header.mPositionCount );
+  for ( std::size_t i = 0; i < header.mPositionCount; ++i )
+    aPacked.mTilePositions[i] = sf::Vector2i( positions[i * 2], positions[i * 2 + 1] );
+
+  aPacked.mImage.create( header.mWidth, header.mHeight, data + positionsBytes );
+  return true;
+}
+
+
+bool
+AtlasPacker::writeCache( const std::string& aPath, const Packed& aPacked )
+{
+  CacheHeader header;
+  std::memcpy( header.mMagic, CACHE_MAGIC, sizeof( CACHE_MAGIC ) );
+  header.mVersion       = CACHE_VERSION;
+  header.mTileSize      = static_cast<std::uint16_t>( Globals::TILE_SIZE );
+  header.mWidth         = aPacked.mImage.getSize().x;
+  header.mHeight        = aPacked.mImage.getSize().y;
+  header.mPositionCount = static_cast<std::uint32_t>( aPacked.mTilePositions.size() );
+
+  std::vector<std::int32_t> positions;
+  for ( const sf::Vector2i& position : aPacked.mTilePositions )
+  {
+    positions.push_back( position.x );
+    positions.push_back( position.y );
+  }
+
+  // Written aside then renamed, so a reader never sees a partial file.
+  std::error_code error;
+  std::filesystem::create_directories( std::filesystem::path( aPath ).parent_path(), error );
+
+  const std::string temporaryPath = aPath + ".tmp";
+  {
+    std::ofstream writer( temporaryPath, std::ios::binary );
+    if ( !writer.is_open() )
+      return false;
+
+    writer.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+    writer.write( reinterpret_cast<const char*>( positions.data() ), static_cast<std::streamsize>( positions.size() * sizeof( std::int32_t ) ) );
+    writer.write( reinterpret_cast<const char*>( aPacked.mImage.getPixelsPtr() ), static_cast<std::streamsize>( header.mWidth ) * header.mHeight * 4 );
+    if ( writer.fail() )
+      return false;
+  }
+
+  std::filesystem::rename( temporaryPath, aPath, error );
+  return !error;
+}
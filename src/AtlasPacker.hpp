@@ -0,0 +1,82 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "TileGrid.hpp"
+
+// Packs tiles into an atlas image. Every tile is surrounded by mExtrusion
+// copies of its edge pixels, then mGutter transparent pixels, so sampling
+// slightly outside a tile under scaling or filtering still reads its own
+// colors.
+//
+// Packed atlases are cached on disk as raw pixels, named after a hash of
+// everything they are built from (settings, tile list and source files), so
+// a warm start reads one file instead of decoding and packing.
+namespace AtlasPacker
+{
+  const char          CACHE_MAGIC[4] = { 'R', 'P', 'G', 'A' };
+  const std::uint16_t CACHE_VERSION  = 1;
+
+  struct Settings
+  {
+    int mGutter    { 2 }; // Transparent pixels between extruded tiles, and around the atlas.
+    int mExtrusion { 1 };
+  };
+
+  // Tile images, either one file per tile, indexed by TileId, or a sheet laid
+  // out like the tileset (TILESET_COLUMNS tiles per row).
+  struct Source
+  {
+    std::vector<std::string> mTileFiles;
+
+    std::string mSheet;
+    int         mSheetMargin  { 0 };
+    int         mSheetSpacing { 0 };
+  };
+
+  struct Packed
+  {
+    sf::Image                 mImage;
+    std::vector<sf::Vector2i> mTilePositions; // Indexed by TileId, x < 0 for tiles not packed.
+  };
+
+  // tile_0000.png, tile_0001.png... in aDirectory, for every tile of the tileset.
+  Source tileFiles( const std::string& aDirectory );
+
+  // Decodes the tiles in aTiles (sorted, without duplicates) and packs them.
+  bool pack( const Source& aSource, const std::vector<TileId>& aTiles, const Settings& aSettings, Packed& aPacked );
+
+  // Hash of the inputs of pack(), including the contents of the source files it reads.
+  std::uint64_t hashInputs( const Source& aSource, const std::vector<TileId>& aTiles, const Settings& aSettings );
+
+  std::string getCachePath( const std::string& aDirectory, std::uint64_t aHash );
+  bool readCache( const std::string& aPath, Packed& aPacked );
+  bool writeCache( const std::string& aPath, const Packed& aPacked );
+}
@@ -0,0 +1,81 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <cassert>
+#include <type_traits>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+// Spawning many entities at once. Created one at a time, entities and their
+// components grow every pool geometrically: each growth copies the pool and
+// briefly holds it twice. In bulk, the entity list and the pools are sized
+// once, the entities are created as one range, and each component is
+// assigned to the whole range in a single call.
+namespace BulkSpawn
+{
+  // Makes room for aCount more entities, each with all of Components.
+  template<typename... Components>
+  void reserve( entt::registry& aRegistry, std::size_t aCount )
+  {
+    aRegistry.reserve( aRegistry.size() + aCount );
+    ( aRegistry.reserve<Components>( aRegistry.size<Components>() + aCount ), ... );
+  }
+
+  // Appends aCount new entities to aEntities.
+  inline void create( entt::registry& aRegistry, std::size_t aCount, std::vector<entt::entity>& aEntities )
+  {
+    const std::size_t first = aEntities.size();
+    aEntities.resize( first + aCount );
+    aRegistry.create( aEntities.begin() + first, aEntities.end() );
+  }
+
+  // Assigns aValue to the entities [aFirst, aLast). For components with
+  // data, returns their storage: the new components are contiguous in the
+  // pool, in the order of the entities, for the caller to fill from its own
+  // arrays (e.g. the map grid) without a lookup per entity. The pool must
+  // not be sorted or owned by a group meanwhile.
+  template<typename Component>
+  auto assign( entt::registry& aRegistry, const entt::entity* aFirst, const entt::entity* aLast, const Component& aValue = {} )
+  {
+    if constexpr ( std::is_empty<Component>::value )
+      aRegistry.assign<Component>( aFirst, aLast, aValue );
+    else
+    {
+      const std::size_t offset = aRegistry.size<Component>();
+      aRegistry.assign<Component>( aFirst, aLast, aValue );
+      assert( aRegistry.size<Component>() == offset + static_cast<std::size_t>( aLast - aFirst ) );
+      return aRegistry.raw<Component>() + offset;
+    }
+  }
+
+  // Assigns aValues[i] to the i-th entity of [aFirst, aLast), from an array
+  // such as a spawn list.
+  template<typename Component>
+  void assign( entt::registry& aRegistry, const entt::entity* aFirst, const entt::entity* aLast, const Component* aValues )
+  {
+    aRegistry.assign<Component>( aFirst, aLast, aValues );
+  }
+}
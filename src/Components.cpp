@@ -22,7 +22,3 @@
  * SOFTWARE.
  */
 #include "Components.hpp"
-
-//SequenceElement::~SequenceElement()
-//{
-//}
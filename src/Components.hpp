@@ -23,46 +23,62 @@
  */
 #pragma once
 
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <array>
+#include <type_traits>
+#include <vector>
 #include <SFML/System.hpp>
 #include <SFML/Graphics.hpp>
 
+// Index of a texture in a TextureRegistry.
+typedef std::uint16_t TextureHandle;
+const TextureHandle NO_TEXTURE = 0;
+const TextureHandle MAX_TEXTURE_HANDLE = std::numeric_limits<TextureHandle>::max();
+
 struct ComponentPositionWorld
 {
   sf::Vector2f mPosition;
 };
 
+// Position at the start of the current simulation tick, so rendering can
+// interpolate between two ticks.
+struct ComponentPositionWorldPrevious
+{
+  sf::Vector2f mPosition;
+};
+
+// A textured quad drawn at its entity's ComponentPositionWorld. Plain data,
+// stored inline in its pool: drawing a view of them reads memory in order.
 struct ComponentSprite
 {
-  std::shared_ptr<sf::Texture> mTexture;
-  std::unique_ptr<sf::Sprite> mSprite;
+  TextureHandle mTexture { NO_TEXTURE };
+  sf::IntRect   mTextureRect;
+  sf::Vector2f  mOrigin; // In pixels, from the top left corner of the quad.
+  sf::Color     mColor { sf::Color::White };
 };
+static_assert( std::is_trivially_copyable<ComponentSprite>::value, "ComponentSprite must stay plain data." );
 
 struct ComponentLayerBackground
 {};
 
-struct SequenceElement
+// A CHUNK_SIZE x CHUNK_SIZE block of background tiles, pre-built as quads in
+// world pixel coordinates so it is drawn in a single call.
+struct ComponentTileChunk
 {
-  std::shared_ptr<sf::Texture> mTexture;
-  std::unique_ptr<sf::Sprite> mSprite;
-  float mRatio {1.0f};
-  //~SequenceElement();
-  //SequenceElement() = default;
-  //SequenceElement( SequenceElement&& aOther )
-  //{
-  //  mTexture = std::move( aOther.mTexture );
-  //  mSprite = std::move( aOther.mSprite );
-  //  mRatio = aOther.mRatio;
-  //}
+  TextureHandle mTexture { NO_TEXTURE };
+  sf::VertexArray mVertices;
 };
 
+// Index of a clip in the AnimationLibrary.
+typedef std::uint32_t AnimationClipId;
+
 struct ComponentSpriteAnimated
 {
-  float mTotalTime { 1.0f };
-  float mTimeInCurrentLoop     { 0.0f };
+  AnimationClipId mClip { 0 };
+  float mTimeInCurrentLoop { 0.0f };
   int mCurrentSequenceElementIndex { 0 };
-  std::vector<std::unique_ptr<SequenceElement>> mSequenceElements;
 };
 
 struct ComponentWorldMovement
@@ -74,6 +90,15 @@ struct ComponentWorldMovement
   float mRatio { 0.0f };
 };
 
+// Tiles to walk through, in order, one straight ComponentWorldMovement to
+// each. Given by the Pathfinder, which removes it at the last one.
+struct ComponentPath
+{
+  std::vector<sf::Vector2i> mWaypoints;
+  std::size_t mNext { 0 }; // Waypoint after the one being walked to.
+  float mSpeed { 0.0f };
+};
+
 struct ComponentMainCharacter
 {};
 
@@ -83,5 +108,6 @@ struct ComponentCharacterAnimation
   {
     LEFT, DOWN, UP, RIGHT, NUM_DIRECTIONS
   };
-  std::array<ComponentSpriteAnimated, NUM_DIRECTIONS> mMoveAnimations;
+  std::array<AnimationClipId, NUM_DIRECTIONS> mMoveAnimations;
+  Direction mDirection { DOWN };
 };
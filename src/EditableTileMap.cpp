@@ -0,0 +1,120 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "EditableTileMap.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+void
+EditableTileMap::open( const TileGridView& aTiles )
+{
+  mView = aTiles;
+  mGrid = TileGrid();
+  mDirty.clear();
+  mDirtyTiles.clear();
+}
+
+
+void
+EditableTileMap::open( TileGrid aTiles )
+{
+  mGrid = std::move( aTiles );
+  mView = mGrid.getView();
+  mDirty.assign( static_cast<std::size_t>( mGrid.getSize().x ) * mGrid.getSize().y, false );
+  mDirtyTiles.clear();
+}
+
+
+void
+EditableTileMap::set( sf::Vector2i aTile, TileId aTileId )
+{
+  assert( contains( aTile ) );
+  write( aTile, aTileId );
+}
+
+
+void
+EditableTileMap::setRegion( const sf::IntRect& aRegion, const TileGridView& aTiles )
+{
+  assert( aTiles.getSize() == sf::Vector2i( aRegion.width, aRegion.height ) );
+
+  for ( int y = 0; y < aRegion.height; ++y )
+  {
+    const TileId* row = aTiles.row( y );
+    for ( int x = 0; x < aRegion.width; ++x )
+      set( sf::Vector2i( aRegion.left + x, aRegion.top + y ), row[x] );
+  }
+}
+
+
+void
+EditableTileMap::fillRegion( const sf::IntRect& aRegion, TileId aTileId )
+{
+  for ( int y = aRegion.top; y < aRegion.top + aRegion.height; ++y )
+  {
+    for ( int x = aRegion.left; x < aRegion.left + aRegion.width; ++x )
+      set( sf::Vector2i( x, y ), aTileId );
+  }
+}
+
+
+void
+EditableTileMap::takeDirtyTiles( std::vector<sf::Vector2i>& aTiles )
+{
+  aTiles.swap( mDirtyTiles );
+  mDirtyTiles.clear();
+
+  for ( const sf::Vector2i& tile : aTiles )
+    mDirty[static_cast<std::size_t>( tile.y ) * mView.getSize().x + tile.x] = false;
+}
+
+
+void
+EditableTileMap::write( sf::Vector2i aTile, TileId aTileId )
+{
+  if ( mView.at( aTile.x, aTile.y ) == aTileId )
+    return;
+
+  // Copy on write: the source view may be read-only memory.
+  if ( mGrid.getSize() != mView.getSize() )
+  {
+    const sf::Vector2i size = mView.getSize();
+    mGrid.resize( size );
+    for ( int y = 0; y < size.y; ++y )
+      std::copy( mView.row( y ), mView.row( y ) + size.x, mGrid.data() + static_cast<std::size_t>( y ) * size.x );
+
+    mView = mGrid.getView();
+    mDirty.assign( static_cast<std::size_t>( size.x ) * size.y, false );
+  }
+
+  const std::size_t index = static_cast<std::size_t>( aTile.y ) * mView.getSize().x + aTile.x;
+  mGrid.data()[index] = aTileId;
+
+  if ( !mDirty[index] )
+  {
+    mDirty[index] = true;
+    mDirtyTiles.push_back( aTile );
+  }
+}
@@ -0,0 +1,68 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "TileGrid.hpp"
+
+// A map that can be written to at run time. It reads through the view it was
+// opened on (often memory mapped, or owned by the AssetLoader) until the
+// first write, which copies the tiles. Written tiles are remembered, once
+// each, until takeDirtyTiles() hands them over, so render data can be patched
+// for the edits alone.
+class EditableTileMap
+{
+public:
+  void open( const TileGridView& aTiles );
+  // Takes aTiles as its own, as if already written to.
+  void open( TileGrid aTiles );
+
+  const TileGridView& getView() const { return mView; }
+  sf::Vector2i getSize() const { return mView.getSize(); }
+
+  bool contains( sf::Vector2i aTile ) const
+  {
+    return aTile.x >= 0 && aTile.y >= 0 && aTile.x < mView.getSize().x && aTile.y < mView.getSize().y;
+  }
+
+  void set( sf::Vector2i aTile, TileId aTileId );
+
+  // aTiles is copied into aRegion; both have the same size.
+  void setRegion( const sf::IntRect& aRegion, const TileGridView& aTiles );
+  void fillRegion( const sf::IntRect& aRegion, TileId aTileId );
+
+  // Replaces aTiles with the tiles whose id changed since the last call.
+  void takeDirtyTiles( std::vector<sf::Vector2i>& aTiles );
+
+private:
+  void write( sf::Vector2i aTile, TileId aTileId );
+
+  TileGridView              mView;
+  TileGrid                  mGrid;  // Empty until the first write.
+  std::vector<bool>         mDirty; // Per tile, sized on the first write too.
+  std::vector<sf::Vector2i> mDirtyTiles;
+};
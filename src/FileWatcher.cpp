@@ -0,0 +1,142 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "FileWatcher.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  std::filesystem::file_time_type getWriteTime( const std::string& aPath )
+  {
+    std::error_code error;
+    const std::filesystem::file_time_type time = std::filesystem::last_write_time( aPath, error );
+    return error ? std::filesystem::file_time_type::min() : time;
+  }
+}
+
+
+FileWatcher::FileWatcher()
+{
+#ifdef __linux__
+  mInotify = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+  if ( mInotify < 0 )
+    std::cerr << "inotify unavailable, polling modification times" << std::endl;
+#endif
+}
+
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+  if ( mInotify >= 0 )
+    close( mInotify );
+#endif
+}
+
+
+void
+FileWatcher::watch( const std::string& aPath )
+{
+  const std::filesystem::path path( aPath );
+
+  Watch watch;
+  watch.mPath      = aPath;
+  watch.mName      = path.filename().string();
+  watch.mWriteTime = getWriteTime( aPath );
+
+#ifdef __linux__
+  // Editors often save to a temporary file renamed over the original, which
+  // a watch on the file itself would lose: the directory is watched instead.
+  // Watching a directory twice returns its first descriptor.
+  if ( mInotify >= 0 )
+  {
+    const std::string directory = path.has_parent_path() ? path.parent_path().string() : std::string( "." );
+    watch.mDirectory = inotify_add_watch( mInotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO );
+    if ( watch.mDirectory < 0 )
+      std::cerr << "Cannot watch " << directory << ", polling " << aPath << std::endl;
+  }
+#endif
+
+  mWatches.push_back( watch );
+}
+
+
+void
+FileWatcher::poll( std::vector<std::string>& aChanged )
+{
+  const std::size_t firstChanged = aChanged.size();
+
+#ifdef __linux__
+  if ( mInotify >= 0 )
+  {
+    alignas( inotify_event ) char buffer[4096];
+    for ( ;; )
+    {
+      const ssize_t length = read( mInotify, buffer, sizeof( buffer ) );
+      if ( length <= 0 )
+        break;
+
+      for ( ssize_t offset = 0; offset < length; )
+      {
+        const inotify_event* event = reinterpret_cast<const inotify_event*>( buffer + offset );
+        offset += sizeof( inotify_event ) + event->len;
+
+        if ( event->len == 0 )
+          continue;
+
+        for ( const Watch& watch : mWatches )
+        {
+          if ( watch.mDirectory == event->wd && watch.mName == event->name )
+            aChanged.push_back( watch.mPath );
+        }
+      }
+    }
+  }
+#endif
+
+  for ( Watch& watch : mWatches )
+  {
+    if ( watch.mDirectory >= 0 )
+      continue;
+
+    const std::filesystem::file_time_type time = getWriteTime( watch.mPath );
+    if ( time != watch.mWriteTime )
+    {
+      watch.mWriteTime = time;
+      aChanged.push_back( watch.mPath );
+    }
+  }
+
+  // A save may write and rename: report each file once.
+  std::sort( aChanged.begin() + firstChanged, aChanged.end() );
+  aChanged.erase( std::unique( aChanged.begin() + firstChanged, aChanged.end() ), aChanged.end() );
+}
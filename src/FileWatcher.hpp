@@ -0,0 +1,63 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Reports files changed on disk, for hot reloading. On Linux, inotify watches
+// the directories of the files: a file is reported once it is closed after a
+// write, or renamed into place, so it is never seen half written by an editor
+// saving it at once. Elsewhere, modification times are compared on each poll.
+class FileWatcher
+{
+public:
+  FileWatcher();
+  ~FileWatcher();
+
+  FileWatcher( const FileWatcher& ) = delete;
+  FileWatcher& operator=( const FileWatcher& ) = delete;
+
+  // The file need not exist yet; its directory must.
+  void watch( const std::string& aPath );
+
+  // Appends the watched paths, as given to watch(), changed since the last
+  // call. Each is reported once per call. Never blocks.
+  void poll( std::vector<std::string>& aChanged );
+
+private:
+  struct Watch
+  {
+    std::string mPath;
+    std::string mName; // File name within its directory.
+    int         mDirectory { -1 }; // inotify watch descriptor.
+    std::filesystem::file_time_type mWriteTime;
+  };
+
+  std::vector<Watch> mWatches;
+#ifdef __linux__
+  int mInotify { -1 };
+#endif
+};
@@ -0,0 +1,100 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "FrameDriver.hpp"
+
+FrameDriver::FrameDriver( const Settings& aSettings )
+  : mSettings ( aSettings )
+{
+}
+
+
+void
+FrameDriver::run( const Simulate& aSimulate, const Present& aPresent )
+{
+  if ( mSettings.mHeadless )
+  {
+    runHeadless( aSimulate );
+    return;
+  }
+
+  const sf::Time frameTime = mSettings.mFrameRateCap > 0
+    ? sf::seconds( 1.0f / mSettings.mFrameRateCap )
+    : sf::Time::Zero;
+
+  sf::Clock clock;
+  sf::Time accumulator;
+  sf::Time previousFrameStart = clock.getElapsedTime();
+
+  for ( ;; )
+  {
+    const sf::Time frameStart = clock.getElapsedTime();
+    accumulator += frameStart - previousFrameStart;
+    previousFrameStart = frameStart;
+
+    int ticks = 0;
+    while ( accumulator >= mSettings.mTick && ticks < mSettings.mMaxTicksPerFrame )
+    {
+      aSimulate( mSettings.mTick );
+      accumulator -= mSettings.mTick;
+      ++ticks;
+    }
+    mStats.mTicks += ticks;
+
+    // After a long stall, drop the backlog rather than spiral trying to catch up.
+    if ( accumulator >= mSettings.mTick )
+    {
+      const sf::Int64 dropped = accumulator.asMicroseconds() / mSettings.mTick.asMicroseconds();
+      mStats.mDroppedTicks += static_cast<std::uint64_t>( dropped );
+      accumulator -= sf::microseconds( dropped * mSettings.mTick.asMicroseconds() );
+    }
+
+    if ( !aPresent( accumulator / mSettings.mTick ) )
+      break;
+    ++mStats.mFrames;
+
+    if ( frameTime > sf::Time::Zero )
+    {
+      const sf::Time spent = clock.getElapsedTime() - frameStart;
+      if ( spent < frameTime )
+        sf::sleep( frameTime - spent );
+    }
+  }
+
+  mStats.mElapsed = clock.getElapsedTime();
+}
+
+
+void
+FrameDriver::runHeadless( const Simulate& aSimulate )
+{
+  sf::Clock clock;
+
+  while ( clock.getElapsedTime() < mSettings.mHeadlessDuration )
+  {
+    aSimulate( mSettings.mTick );
+    ++mStats.mTicks;
+  }
+
+  mStats.mElapsed = clock.getElapsedTime();
+}
@@ -0,0 +1,70 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include <SFML/System.hpp>
+
+// Drives the main loop: the simulation advances in fixed ticks, decoupled
+// from the frame rate, and each frame is presented with the fraction of a
+// tick left in the accumulator so rendering can interpolate between the
+// previous and the current simulation state.
+class FrameDriver
+{
+public:
+  struct Settings
+  {
+    sf::Time mTick             { sf::seconds( 1.0f / 60.0f ) };
+    int      mMaxTicksPerFrame { 5 };      // Catch-up limit; time beyond it is dropped.
+    unsigned mFrameRateCap     { 0 };      // Frames per second, 0 for uncapped.
+    bool     mHeadless         { false };  // Ticks back to back, nothing is presented.
+    sf::Time mHeadlessDuration { sf::seconds( 10.0f ) };
+  };
+
+  struct Stats
+  {
+    std::uint64_t mTicks        { 0 };
+    std::uint64_t mFrames       { 0 };
+    std::uint64_t mDroppedTicks { 0 };
+    sf::Time      mElapsed;
+  };
+
+  typedef std::function<void( sf::Time )> Simulate;
+  // Receives the interpolation factor in [0, 1). Returns false to stop the loop.
+  typedef std::function<bool( float )> Present;
+
+  explicit FrameDriver( const Settings& aSettings );
+
+  void run( const Simulate& aSimulate, const Present& aPresent );
+
+  const Stats& getStats() const { return mStats; }
+
+private:
+  void runHeadless( const Simulate& aSimulate );
+
+  Settings mSettings;
+  Stats    mStats;
+};
@@ -29,7 +29,14 @@ namespace Globals
 {
   const char* const ASSETS_PATH = "C:\\dev\\gamedev.se-q172325\\assets\\";
   const char* const TILE_MAP    = "C:\\dev\\gamedev.se-q172325\\assets\\kenney_rpgurbanpack\\Tilemap\\tilemap_packed.png";
+  const char* const TILES_PATH  = "C:\\dev\\gamedev.se-q172325\\assets\\kenney_rpgurbanpack\\Tiles\\"; // tile_0000.png, tile_0001.png...
+  const char* const CACHE_PATH  = "C:\\dev\\gamedev.se-q172325\\cache\\";
   const char* const MAP         = "C:\\dev\\gamedev.se-q172325\\assets\\map.txt";
+  const char* const MAP_BINARY  = "C:\\dev\\gamedev.se-q172325\\assets\\map.bin";
   const char* const ANIMATION   = "C:\\dev\\gamedev.se-q172325\\assets\\animation.txt";
+  const char* const BLOCKED_TILES = "C:\\dev\\gamedev.se-q172325\\assets\\blocked_tiles.txt"; // Sprite indices of the tiles nothing walks on.
   const int         TILE_SIZE   = 16;
+  const int         TILESET_COLUMNS = 27; // Tiles per row in TILE_MAP.
+  const int         TILESET_ROWS    = 18;
+  const int         CHUNK_SIZE  = 32; // In tiles, per side.
 }
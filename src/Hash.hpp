@@ -0,0 +1,67 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// FNV-1a, 64 bits. Names the files cached on disk after everything they are
+// built from.
+class Hash
+{
+public:
+  void add( const void* aData, std::size_t aSize )
+  {
+    const unsigned char* bytes = static_cast<const unsigned char*>( aData );
+    for ( std::size_t i = 0; i < aSize; ++i )
+      mValue = ( mValue ^ bytes[i] ) * 0x100000001b3ull;
+  }
+
+  template<typename T>
+  void add( const T& aValue ) { add( &aValue, sizeof( aValue ) ); }
+
+  void addString( const std::string& aText )
+  {
+    add( aText.size() );
+    add( aText.data(), aText.size() );
+  }
+
+  // Missing files hash as empty, so creating one changes the hash.
+  void addFileContents( const std::string& aPath )
+  {
+    std::ifstream reader( aPath, std::ios::binary );
+    const std::vector<char> contents( ( std::istreambuf_iterator<char>( reader ) ), std::istreambuf_iterator<char>() );
+    add( contents.size() );
+    add( contents.data(), contents.size() );
+  }
+
+  std::uint64_t get() const { return mValue; }
+
+private:
+  std::uint64_t mValue { 0xcbf29ce484222325ull };
+};
@@ -0,0 +1,248 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "HotReloader.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "MapFile.hpp"
+#include "MemoryTracker.hpp"
+#include "Profiler.hpp"
+#include "Systems.hpp"
+#include "TextParser.hpp"
+#include "TileAtlas.hpp"
+
+namespace
+{
+  bool sameFrames( const std::vector<AssetLoader::SequenceElement>& aLeft, const std::vector<AssetLoader::SequenceElement>& aRight )
+  {
+    return std::equal( aLeft.begin(), aLeft.end(), aRight.begin(), aRight.end(),
+      []( const AssetLoader::SequenceElement& aA, const AssetLoader::SequenceElement& aB )
+      {
+        return aA.mSpriteIndex == aB.mSpriteIndex && aA.mRatio == aB.mRatio;
+      } );
+  }
+
+
+  template<typename T>
+  bool isReady( const std::future<T>& aFuture )
+  {
+    return aFuture.wait_for( std::chrono::seconds( 0 ) ) == std::future_status::ready;
+  }
+}
+
+
+HotReloader::HotReloader( AssetLoader& aAssetsLoader, SystemRenderer& aRenderer )
+  : mAssetsLoader ( aAssetsLoader )
+  , mRenderer ( aRenderer )
+  , mAtlas ( aAssetsLoader.GetAtlas( AssetLoader::ASSET_TILEMAP ) )
+  , mPool ( std::make_unique<ThreadPool>( 1 ) )
+{
+}
+
+
+HotReloader::~HotReloader()
+{
+}
+
+
+void
+HotReloader::watchMap( AssetLoader::Asset aAsset )
+{
+  mMapPath       = mAssetsLoader.GetPath( aAsset );
+  mBinaryMapPath = mAssetsLoader.GetBinaryMapPath( aAsset );
+  mWatcher.watch( mMapPath );
+  mWatcher.watch( mBinaryMapPath );
+
+  // The first diff is against the map as loaded; the copy is made off the
+  // render thread, the view stays valid for the loader's lifetime.
+  const TileGridView loaded = mAssetsLoader.GetMapData( aAsset );
+  mPool->submit( [this, loaded]()
+  {
+    mMap.resize( loaded.getSize() );
+    for ( int y = 0; y < loaded.getSize().y; ++y )
+      std::copy( loaded.row( y ), loaded.row( y ) + loaded.getSize().x, &mMap.at( 0, y ) );
+  } );
+}
+
+
+void
+HotReloader::watchMainAnimations( AssetLoader::Asset aAsset )
+{
+  mAnimationsPath = mAssetsLoader.GetPath( aAsset );
+  mWatcher.watch( mAnimationsPath );
+
+  AssetLoader::Animations loaded = mAssetsLoader.GetMainAnimations( aAsset );
+  mPool->submit( [this, loaded]()
+  {
+    mAnimations = loaded;
+  } );
+}
+
+
+void
+HotReloader::update( entt::registry& aRegistry )
+{
+  PROFILE_ZONE( "hot reload" );
+
+  mChangedPaths.clear();
+  mWatcher.poll( mChangedPaths );
+
+  for ( const std::string& path : mChangedPaths )
+  {
+    // The file that changed is read, whichever one the map was loaded from.
+    if ( path == mMapPath || path == mBinaryMapPath )
+      mMapReloads.push_back( mPool->submit( [this, path]() { return reloadMap( path, path == mBinaryMapPath ); } ) );
+    else if ( path == mAnimationsPath )
+      mAnimationReloads.push_back( mPool->submit( [this, path]() { return reloadMainAnimations( path ); } ) );
+  }
+
+  while ( !mMapReloads.empty() && isReady( mMapReloads.front() ) )
+  {
+    const MapChanges changes = mMapReloads.front().get();
+    mMapReloads.pop_front();
+
+    for ( std::size_t i = 0; i < changes.mPositions.size(); ++i )
+      mRenderer.setTile( changes.mPositions[i].x, changes.mPositions[i].y, changes.mTiles[i] );
+  }
+
+  while ( !mAnimationReloads.empty() && isReady( mAnimationReloads.front() ) )
+  {
+    const AnimationChanges changes = mAnimationReloads.front().get();
+    mAnimationReloads.pop_front();
+
+    for ( std::size_t i = 0; i < changes.mDirections.size(); ++i )
+      mRenderer.replaceMainAnimation( aRegistry, changes.mDirections[i], *mAtlas, changes.mFrames[i] );
+  }
+}
+
+
+HotReloader::MapChanges
+HotReloader::reloadMap( const std::string& aPath, bool aBinary )
+{
+  PROFILE_ZONE( "reload map" );
+  MEMORY_TAG( TAG_ASSETS );
+
+  MapChanges changes;
+
+  MappedFile file;
+  TileGrid grid;
+  TileGridView map;
+  TextParser::Error error;
+  bool read = false;
+  if ( aBinary )
+  {
+    read = MapFile::openBinary( aPath, file, grid, map );
+    error.mMessage = "cannot read the file, or it is not a valid binary map";
+  }
+  else
+  {
+    read = MapFile::readText( aPath, grid, &error, mAssetsLoader.GetJobSystem() );
+    map = grid.getView();
+  }
+
+  // Deleted, or caught halfway through a write: the next save reloads it.
+  if ( !read )
+  {
+    std::cerr << "Cannot reload " << TextParser::describe( aPath, error ) << std::endl;
+    return changes;
+  }
+
+  if ( map.getSize() != mMap.getSize() )
+  {
+    std::cerr << "The size of " << aPath << " changed, restart to load it" << std::endl;
+    return changes;
+  }
+
+  std::size_t missingTiles = 0;
+  for ( int y = 0; y < map.getSize().y; ++y )
+  {
+    const TileId* row = map.row( y );
+    TileId* previousRow = &mMap.at( 0, y );
+
+    if ( std::equal( row, row + map.getSize().x, previousRow ) )
+      continue;
+
+    for ( int x = 0; x < map.getSize().x; ++x )
+    {
+      if ( row[x] == previousRow[x] )
+        continue;
+
+      previousRow[x] = row[x];
+
+      if ( !mAtlas->contains( row[x] ) )
+      {
+        ++missingTiles;
+        continue;
+      }
+
+      changes.mPositions.push_back( sf::Vector2i( x, y ) );
+      changes.mTiles.push_back( row[x] );
+    }
+  }
+
+  if ( missingTiles > 0 )
+    std::cerr << missingTiles << " tiles of " << aPath << " are not in the atlas, restart to load them" << std::endl;
+
+  return changes;
+}
+
+
+HotReloader::AnimationChanges
+HotReloader::reloadMainAnimations( const std::string& aPath )
+{
+  PROFILE_ZONE( "reload animations" );
+  MEMORY_TAG( TAG_ASSETS );
+
+  AnimationChanges changes;
+
+  AssetLoader::Animations animations;
+  TextParser::Error error;
+  if ( !AssetLoader::ReadMainAnimations( aPath, animations, &error ) )
+  {
+    std::cerr << "Cannot reload " << TextParser::describe( aPath, error ) << std::endl;
+    return changes;
+  }
+
+  for ( std::size_t direction = 0; direction < animations.size() && direction < mAnimations.size(); ++direction )
+  {
+    if ( sameFrames( animations[direction], mAnimations[direction] ) )
+      continue;
+
+    const bool inAtlas = std::all_of( animations[direction].begin(), animations[direction].end(),
+      [this]( const AssetLoader::SequenceElement& aFrame ) { return mAtlas->contains( tileIdFromSpriteIndex( aFrame.mSpriteIndex ) ); } );
+    if ( !inAtlas )
+    {
+      std::cerr << "Animation " << direction << " of " << aPath << " has tiles not in the atlas, restart to load it" << std::endl;
+      continue;
+    }
+
+    mAnimations[direction] = animations[direction];
+    changes.mDirections.push_back( static_cast<int>( direction ) );
+    changes.mFrames.push_back( animations[direction] );
+  }
+
+  return changes;
+}
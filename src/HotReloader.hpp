@@ -0,0 +1,103 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include <entt/entt.hpp>
+
+#include "AssetLoader.hpp"
+#include "FileWatcher.hpp"
+#include "ThreadPool.hpp"
+#include "TileGrid.hpp"
+
+class SystemRenderer;
+class TileAtlas;
+
+// Pushes the changes saved to the map and animation files into the running
+// game. A changed file is parsed and diffed on a worker, against the version
+// read last; the render thread then applies only the tiles and clips that
+// differ, through the same path as runtime edits. Entities are kept and the
+// atlas is not uploaded again, so a tile missing from it is skipped. Tiles
+// edited at runtime keep their value unless the file changes them too.
+class HotReloader
+{
+public:
+  HotReloader( AssetLoader& aAssetsLoader, SystemRenderer& aRenderer );
+  ~HotReloader();
+
+  // The map built by SystemRenderer::createMap(), from its text or binary file.
+  void watchMap( AssetLoader::Asset aAsset );
+
+  // The clips built by SystemRenderer::createMainAnimation().
+  void watchMainAnimations( AssetLoader::Asset aAsset );
+
+  // Polls the files and applies the reloads finished since the last call,
+  // in a time proportional to the changes. Call it once a frame, on the
+  // render thread.
+  void update( entt::registry& aRegistry );
+
+private:
+  struct MapChanges
+  {
+    std::vector<sf::Vector2i> mPositions;
+    std::vector<TileId>       mTiles;
+  };
+
+  struct AnimationChanges
+  {
+    std::vector<int>        mDirections;
+    AssetLoader::Animations mFrames; // Parallel to mDirections.
+  };
+
+  // Worker side: read a file and diff it against the last version read.
+  MapChanges reloadMap( const std::string& aPath, bool aBinary );
+  AnimationChanges reloadMainAnimations( const std::string& aPath );
+
+  AssetLoader&                     mAssetsLoader;
+  SystemRenderer&                  mRenderer;
+  std::shared_ptr<const TileAtlas> mAtlas;
+  FileWatcher                      mWatcher;
+  std::vector<std::string>         mChangedPaths;
+
+  std::string mMapPath;
+  std::string mBinaryMapPath;
+  std::string mAnimationsPath;
+
+  // Last version read of each file. Only the worker touches them once
+  // watched; its jobs run one at a time, in order.
+  TileGrid                mMap;
+  AssetLoader::Animations mAnimations;
+
+  // Applied in order, as they finish.
+  std::deque<std::future<MapChanges>>       mMapReloads;
+  std::deque<std::future<AnimationChanges>> mAnimationReloads;
+
+  // Reloads diff against mMap and mAnimations; declared last so the worker is
+  // joined before they go.
+  std::unique_ptr<ThreadPool> mPool;
+};
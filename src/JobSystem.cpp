@@ -0,0 +1,153 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "JobSystem.hpp"
+
+#include "Profiler.hpp"
+
+namespace
+{
+  // Queue owned by the current thread: its worker queue, or the shared one.
+  thread_local const JobSystem* tJobSystem = nullptr;
+  thread_local std::size_t      tQueue     = 0;
+}
+
+JobSystem::JobSystem( unsigned aThreadCount )
+{
+  if ( aThreadCount == 0 )
+    aThreadCount = std::max( 2u, std::thread::hardware_concurrency() ) - 1;
+
+  for ( unsigned i = 0; i <= aThreadCount; ++i )
+    mQueues.push_back( std::make_unique<Queue>() );
+
+  // Queue 0 is the shared one.
+  for ( unsigned i = 1; i <= aThreadCount; ++i )
+    mWorkers.emplace_back( &JobSystem::workerLoop, this, i );
+}
+
+
+JobSystem::~JobSystem()
+{
+  {
+    std::lock_guard<std::mutex> lock( mSleepMutex );
+    mStopping = true;
+  }
+  mWake.notify_all();
+
+  for ( auto& worker : mWorkers )
+    worker.join();
+}
+
+
+void
+JobSystem::run( Job aJob, Counter& aCounter )
+{
+  aCounter.mPending.fetch_add( 1, std::memory_order_relaxed );
+
+  Job job = [job = std::move( aJob ), &aCounter]() 
+  {
+    job();
+    aCounter.mPending.fetch_sub( 1, std::memory_order_release );
+  };
+
+  const std::size_t queue = tJobSystem == this ? tQueue : 0;
+  {
+    std::lock_guard<std::mutex> lock( mQueues[queue]->mMutex );
+    mQueues[queue]->mJobs.push_back( std::move( job ) );
+  }
+
+  mQueued.fetch_add( 1, std::memory_order_release );
+  {
+    // Pairs with the predicate check in workerLoop, so no wake up is lost.
+    std::lock_guard<std::mutex> lock( mSleepMutex );
+  }
+  mWake.notify_one();
+}
+
+
+void
+JobSystem::wait( Counter& aCounter )
+{
+  const std::size_t queue = tJobSystem == this ? tQueue : 0;
+
+  while ( !aCounter.isDone() )
+  {
+    if ( !tryRunOne( queue ) )
+      std::this_thread::yield();
+  }
+}
+
+
+bool
+JobSystem::tryRunOne( std::size_t aQueue )
+{
+  Job job;
+
+  // Own queue first, newest job first: it is the most likely to be in cache.
+  {
+    Queue& own = *mQueues[aQueue];
+    std::lock_guard<std::mutex> lock( own.mMutex );
+    if ( !own.mJobs.empty() )
+    {
+      job = std::move( own.mJobs.back() );
+      own.mJobs.pop_back();
+    }
+  }
+
+  // Then steal the oldest job of another queue.
+  for ( std::size_t offset = 1; !job && offset < mQueues.size(); ++offset )
+  {
+    Queue& victim = *mQueues[( aQueue + offset ) % mQueues.size()];
+    std::lock_guard<std::mutex> lock( victim.mMutex );
+    if ( !victim.mJobs.empty() )
+    {
+      job = std::move( victim.mJobs.front() );
+      victim.mJobs.pop_front();
+    }
+  }
+
+  if ( !job )
+    return false;
+
+  mQueued.fetch_sub( 1, std::memory_order_relaxed );
+  job();
+  return true;
+}
+
+
+void
+JobSystem::workerLoop( std::size_t aQueue )
+{
+  tJobSystem = this;
+  tQueue     = aQueue;
+  Profiler::setThreadName( "job worker" );
+
+  while ( !mStopping )
+  {
+    if ( tryRunOne( aQueue ) )
+      continue;
+
+    std::unique_lock<std::mutex> lock( mSleepMutex );
+    mWake.wait( lock, [this]() { return mStopping || mQueued.load( std::memory_order_acquire ) > 0; } );
+  }
+}
@@ -0,0 +1,111 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool for short CPU-bound jobs. Each worker pops from the back
+// of its own queue and steals from the front of the others' when it runs dry.
+// Threads waiting on a Counter run jobs instead of blocking, so jobs may
+// themselves spawn and wait on jobs.
+class JobSystem
+{
+public:
+  typedef std::function<void()> Job;
+
+  // Number of unfinished jobs started with a counter.
+  class Counter
+  {
+  public:
+    bool isDone() const { return mPending.load( std::memory_order_acquire ) == 0; }
+
+  private:
+    friend class JobSystem;
+    std::atomic<int> mPending { 0 };
+  };
+
+  // 0 uses one thread per hardware thread, the caller of wait() being one of them.
+  explicit JobSystem( unsigned aThreadCount = 0 );
+  ~JobSystem();
+
+  JobSystem( const JobSystem& ) = delete;
+  JobSystem& operator=( const JobSystem& ) = delete;
+
+  void run( Job aJob, Counter& aCounter );
+  void wait( Counter& aCounter );
+
+  // Calls aFunction( begin, end ) over [0, aCount) in ranges of about aGrain
+  // items, in parallel, and returns when all of them are done.
+  template<typename Function>
+  void parallelFor( std::size_t aCount, std::size_t aGrain, Function aFunction )
+  {
+    aGrain = std::max<std::size_t>( aGrain, 1 );
+
+    if ( aCount <= aGrain || mWorkers.empty() )
+    {
+      if ( aCount > 0 )
+        aFunction( std::size_t( 0 ), aCount );
+      return;
+    }
+
+    Counter counter;
+    for ( std::size_t begin = 0; begin < aCount; begin += aGrain )
+    {
+      const std::size_t end = std::min( aCount, begin + aGrain );
+      run( [&aFunction, begin, end]() { aFunction( begin, end ); }, counter );
+    }
+    wait( counter );
+  }
+
+  // Worker threads, not counting threads calling wait().
+  unsigned getThreadCount() const { return static_cast<unsigned>( mWorkers.size() ); }
+
+private:
+  struct Queue
+  {
+    std::mutex      mMutex;
+    std::deque<Job> mJobs;
+  };
+
+  bool tryRunOne( std::size_t aQueue );
+  void workerLoop( std::size_t aQueue );
+
+  // One queue per worker, plus one shared by every other thread.
+  std::vector<std::unique_ptr<Queue>> mQueues;
+  std::vector<std::thread>            mWorkers;
+
+  std::atomic<int>                    mQueued { 0 };
+  std::atomic<bool>                   mStopping { false };
+  std::mutex                          mSleepMutex;
+  std::condition_variable             mWake;
+};
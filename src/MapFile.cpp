@@ -0,0 +1,364 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "MapFile.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "TextParser.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool
+MapFile::isValid( const void* aData, std::size_t aSize )
+{
+  if ( aData == nullptr || aSize < sizeof( Header ) )
+    return false;
+
+  const Header header = getHeader( aData );
+
+  if ( std::memcmp( header.mMagic, MAGIC, sizeof( MAGIC ) ) != 0
+    || header.mVersion != VERSION
+    || ( header.mTileIndexBytes != 1 && header.mTileIndexBytes != 2 ) )
+    return false;
+
+  const std::size_t tileCount = static_cast<std::size_t>( header.mWidth ) * header.mHeight;
+  if ( aSize < sizeof( Header ) + tileCount * header.mTileIndexBytes )
+    return false;
+
+  // Every 1-byte id is in the tileset. 2-byte ids past it would index out of
+  // the atlas and of every per-tile table.
+  static_assert( Globals::TILESET_COLUMNS * Globals::TILESET_ROWS > 0xFF, "1-byte tile ids may leave the tileset." );
+  if ( header.mTileIndexBytes == 1 )
+    return true;
+
+  const TileId* tiles = reinterpret_cast<const TileId*>( getTiles( aData ) );
+  TileId maxTile = 0;
+  for ( std::size_t tile = 0; tile < tileCount; ++tile )
+    maxTile = std::max( maxTile, tiles[tile] );
+
+  return tileCount == 0 || isInTileset( maxTile );
+}
+
+
+MapFile::Header
+MapFile::getHeader( const void* aData )
+{
+  Header header;
+  std::memcpy( &header, aData, sizeof( Header ) );
+  return header;
+}
+
+
+const std::uint8_t*
+MapFile::getTiles( const void* aData )
+{
+  return static_cast<const std::uint8_t*>( aData ) + sizeof( Header );
+}
+
+
+bool
+MapFile::openBinary( const std::string& aPath, MappedFile& aFile, TileGrid& aGrid, TileGridView& aView )
+{
+  if ( !aFile.open( aPath ) )
+    return false;
+
+  if ( !isValid( aFile.getData(), aFile.getSize() ) )
+  {
+    // Stale, corrupted or half written: the caller reports it or falls back.
+    aFile.close();
+    return false;
+  }
+
+  const Header header = getHeader( aFile.getData() );
+  const sf::Vector2i size( static_cast<int>( header.mWidth ), static_cast<int>( header.mHeight ) );
+  const std::uint8_t* tiles = getTiles( aFile.getData() );
+
+  if ( header.mTileIndexBytes == sizeof( TileId ) )
+  {
+    aView = TileGridView( reinterpret_cast<const TileId*>( tiles ), size, size.x );
+    return true;
+  }
+
+  aGrid.resize( size );
+  std::copy( tiles, tiles + static_cast<std::size_t>( size.x ) * size.y, aGrid.data() );
+  aView = aGrid.getView();
+  aFile.close();
+  return true;
+}
+
+
+bool
+MapFile::readText( const std::string& aPath, TileGrid& aGrid, TextParser::Error* aError, JobSystem* aJobSystem )
+{
+  MappedFile file;
+  if ( !TextParser::openFile( aPath, file, aError ) )
+    return false;
+
+  const char* text = static_cast<const char*>( file.getData() );
+  TextParser::Reader reader( text, text + file.getSize() );
+
+  sf::Vector2i size;
+  bool read = reader.read( size.x, 0 ) && reader.read( size.y, 0 );
+
+  if ( read )
+  {
+    aGrid.resize( size );
+
+    TileId* tiles = aGrid.data();
+    read = TextParser::readGroups<2>( reader, static_cast<std::size_t>( size.x ) * size.y, aJobSystem,
+      [tiles]( std::size_t aTile, const int* aValues ) -> const char*
+      {
+        const sf::Vector2i spriteIndex( aValues[0], aValues[1] );
+        if ( !isInTileset( spriteIndex ) )
+          return "sprite index outside the tileset";
+
+        tiles[aTile] = tileIdFromSpriteIndex( spriteIndex );
+        return nullptr;
+      } );
+  }
+
+  if ( !read )
+  {
+    aGrid.resize( sf::Vector2i() );
+    if ( aError != nullptr )
+      reader.getError( text, *aError );
+  }
+
+  return read;
+}
+
+
+bool
+MapFile::writeBinary( const std::string& aPath, const TileGridView& aTiles, int aTileIndexBytes )
+{
+  assert( aTileIndexBytes == 1 || aTileIndexBytes == 2 );
+
+  const sf::Vector2i size = aTiles.getSize();
+
+  Header header;
+  std::memcpy( header.mMagic, MAGIC, sizeof( MAGIC ) );
+  header.mVersion        = VERSION;
+  header.mTileIndexBytes = static_cast<std::uint16_t>( aTileIndexBytes );
+  header.mWidth          = static_cast<std::uint32_t>( size.x );
+  header.mHeight         = static_cast<std::uint32_t>( size.y );
+
+  // Written aside then renamed: the file may be mapped, by openBinary() in
+  // this process or another, and rewriting it in place would change or cut
+  // the mapped tiles under the reader.
+  const std::string temporaryPath = aPath + ".tmp";
+  std::ofstream writer( temporaryPath, std::ios::binary );
+  if ( !writer.is_open() )
+    return false;
+
+  writer.write( reinterpret_cast<const char*>( &header ), sizeof( Header ) );
+
+  std::vector<std::uint8_t> narrowRow( aTileIndexBytes == 1 ? size.x : 0 );
+  for ( int y = 0; y < size.y; ++y )
+  {
+    const TileId* row = aTiles.row( y );
+
+    if ( aTileIndexBytes == 2 )
+    {
+      writer.write( reinterpret_cast<const char*>( row ), static_cast<std::streamsize>( size.x * sizeof( TileId ) ) );
+      continue;
+    }
+
+    for ( int x = 0; x < size.x; ++x )
+    {
+      assert( row[x] <= 0xFF );
+      narrowRow[x] = static_cast<std::uint8_t>( row[x] );
+    }
+    writer.write( reinterpret_cast<const char*>( narrowRow.data() ), static_cast<std::streamsize>( size.x ) );
+  }
+
+  writer.close();
+
+  // A file not renamed over the map is not left beside it.
+  std::error_code error;
+  if ( !writer.fail() )
+    std::filesystem::rename( temporaryPath, aPath, error );
+  if ( writer.fail() || error )
+  {
+    std::error_code ignored;
+    std::filesystem::remove( temporaryPath, ignored );
+    return false;
+  }
+  return true;
+}
+
+
+bool
+MapFile::readWorld( const std::string& aDirectory, WorldInfo& aInfo )
+{
+  std::ifstream reader( aDirectory + "/world.txt" );
+
+  if ( !reader.is_open() )
+    return false;
+
+  reader >> aInfo.mPageSize >> aInfo.mSize.x >> aInfo.mSize.y;
+
+  return !reader.fail() && aInfo.mPageSize > 0;
+}
+
+
+bool
+MapFile::writeWorld( const std::string& aDirectory, const WorldInfo& aInfo )
+{
+  std::ofstream writer( aDirectory + "/world.txt" );
+
+  if ( !writer.is_open() )
+    return false;
+
+  writer << aInfo.mPageSize << "\n" << aInfo.mSize.x << "\n" << aInfo.mSize.y << "\n";
+
+  return writer.good();
+}
+
+
+std::string
+MapFile::getPagePath( const std::string& aDirectory, sf::Vector2i aPage )
+{
+  return aDirectory + "/page_" + std::to_string( aPage.x ) + "_" + std::to_string( aPage.y ) + ".bin";
+}
+
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+
+#ifdef _WIN32
+
+bool
+MappedFile::open( const std::string& aPath )
+{
+  close();
+
+  HANDLE file = CreateFileA( aPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+  if ( file == INVALID_HANDLE_VALUE )
+    return false;
+
+  LARGE_INTEGER size;
+  if ( !GetFileSizeEx( file, &size ) || size.QuadPart == 0 )
+  {
+    CloseHandle( file );
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+  if ( mapping == nullptr )
+  {
+    CloseHandle( file );
+    return false;
+  }
+
+  mData    = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+  mSize    = static_cast<std::size_t>( size.QuadPart );
+  mFile    = file;
+  mMapping = mapping;
+
+  if ( mData == nullptr )
+  {
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+
+void
+MappedFile::close()
+{
+  if ( mData != nullptr )
+    UnmapViewOfFile( mData );
+  if ( mMapping != nullptr )
+    CloseHandle( mMapping );
+  if ( mFile != nullptr )
+    CloseHandle( mFile );
+
+  mData    = nullptr;
+  mSize    = 0;
+  mFile    = nullptr;
+  mMapping = nullptr;
+}
+
+#else
+
+bool
+MappedFile::open( const std::string& aPath )
+{
+  close();
+
+  int file = ::open( aPath.c_str(), O_RDONLY );
+  if ( file < 0 )
+    return false;
+
+  struct stat status;
+  if ( fstat( file, &status ) != 0 || status.st_size == 0 )
+  {
+    ::close( file );
+    return false;
+  }
+
+  void* data = mmap( nullptr, static_cast<std::size_t>( status.st_size ), PROT_READ, MAP_PRIVATE, file, 0 );
+
+  // The mapping keeps its own reference on the file.
+  ::close( file );
+
+  if ( data == MAP_FAILED )
+    return false;
+
+  mData = data;
+  mSize = static_cast<std::size_t>( status.st_size );
+
+  return true;
+}
+
+
+void
+MappedFile::close()
+{
+  if ( mData != nullptr )
+    munmap( const_cast<void*>( mData ), mSize );
+
+  mData = nullptr;
+  mSize = 0;
+}
+
+#endif
@@ -0,0 +1,114 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "TileGrid.hpp"
+
+class JobSystem;
+class MappedFile;
+namespace TextParser { struct Error; }
+
+// Binary map format, read through a memory mapping: 2-byte tiles in place,
+// 1-byte tiles widened to TileIds once at load, which costs a copy of the
+// grid but halves the file:
+//
+//   Header (16 bytes, little endian)
+//   Tiles  width * height tile ids of mTileIndexBytes bytes each, row-major.
+//
+// Tile ids are TileIds: the index of the tile in the tileset, counted row by row.
+namespace MapFile
+{
+  const char          MAGIC[4] = { 'R', 'P', 'G', 'M' };
+  const std::uint16_t VERSION  = 1;
+
+  struct Header
+  {
+    char          mMagic[4];
+    std::uint16_t mVersion;
+    std::uint16_t mTileIndexBytes; // 1 or 2.
+    std::uint32_t mWidth;
+    std::uint32_t mHeight;
+  };
+  static_assert( sizeof( Header ) == 16, "MapFile::Header must stay 16 bytes, tiles are aligned on it." );
+
+  // Checks the header of an in-memory map image of aSize bytes, and that its
+  // tile ids are in the tileset.
+  bool isValid( const void* aData, std::size_t aSize );
+
+  Header getHeader( const void* aData );
+  const std::uint8_t* getTiles( const void* aData );
+
+  // Opens a binary map. 2-byte tiles are viewed in place in aFile; 1-byte
+  // tiles are widened once into aGrid, so every consumer reads TileIds.
+  // Returns false when the file does not exist or is not a valid map.
+  bool openBinary( const std::string& aPath, MappedFile& aFile, TileGrid& aGrid, TileGridView& aView );
+
+  // Reads the text format (width, height, then x y sprite index pairs). The
+  // rows of a large map are parsed in parallel on aJobSystem when given.
+  // On failure aGrid is left empty and aError, when given, says where.
+  bool readText( const std::string& aPath, TileGrid& aGrid, TextParser::Error* aError = nullptr, JobSystem* aJobSystem = nullptr );
+
+  bool writeBinary( const std::string& aPath, const TileGridView& aTiles, int aTileIndexBytes );
+
+  // A world too large to load at once is split into pages: binary maps of
+  // mPageSize x mPageSize tiles (smaller on the right and bottom edges),
+  // stored next to a world.txt manifest holding the page and world sizes.
+  struct WorldInfo
+  {
+    int          mPageSize { 0 };
+    sf::Vector2i mSize; // In tiles.
+  };
+
+  bool readWorld( const std::string& aDirectory, WorldInfo& aInfo );
+  bool writeWorld( const std::string& aDirectory, const WorldInfo& aInfo );
+  std::string getPagePath( const std::string& aDirectory, sf::Vector2i aPage );
+}
+
+// Read-only memory mapping of a whole file.
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile( const MappedFile& ) = delete;
+  MappedFile& operator=( const MappedFile& ) = delete;
+
+  bool open( const std::string& aPath );
+  void close();
+
+  const void* getData() const { return mData; }
+  std::size_t getSize() const { return mSize; }
+
+private:
+  const void* mData { nullptr };
+  std::size_t mSize { 0 };
+#ifdef _WIN32
+  void* mFile { nullptr };
+  void* mMapping { nullptr };
+#endif
+};
@@ -0,0 +1,441 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "MemoryTracker.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <new>
+#include <type_traits>
+
+#include "AssetLoader.hpp"
+#include "Components.hpp"
+
+namespace
+{
+  // In front of every tracked block. 16 bytes, so the block keeps the
+  // alignment malloc gives it.
+  struct BlockHeader
+  {
+    std::uint64_t mSize;
+    std::uint32_t mTag;
+    std::uint32_t mUnused;
+  };
+  static_assert( sizeof( BlockHeader ) == 16, "BlockHeader must stay 16 bytes, blocks are aligned on it." );
+
+  struct Counters
+  {
+    std::atomic<std::uint64_t> mBytes { 0 };
+    std::atomic<std::uint64_t> mAllocations { 0 };
+    std::atomic<std::uint64_t> mTotalAllocations { 0 };
+    std::atomic<std::uint64_t> mPeakBytes { 0 };
+  };
+
+  // One per tag, then the totals. Constant initialized, so they are ready
+  // for the allocations made before main().
+  Counters gCounters[MemoryTracker::TAG_COUNT + 1];
+  Counters& gTotal = gCounters[MemoryTracker::TAG_COUNT];
+
+  thread_local MemoryTracker::Tag gCurrentTag = MemoryTracker::TAG_UNTAGGED;
+
+  void raisePeak( std::atomic<std::uint64_t>& aPeak, std::uint64_t aBytes )
+  {
+    std::uint64_t peak = aPeak.load( std::memory_order_relaxed );
+    while ( aBytes > peak && !aPeak.compare_exchange_weak( peak, aBytes, std::memory_order_relaxed ) )
+    {}
+  }
+
+  void count( Counters& aCounters, std::uint64_t aSize )
+  {
+    const std::uint64_t bytes = aCounters.mBytes.fetch_add( aSize, std::memory_order_relaxed ) + aSize;
+    aCounters.mAllocations.fetch_add( 1, std::memory_order_relaxed );
+    aCounters.mTotalAllocations.fetch_add( 1, std::memory_order_relaxed );
+    raisePeak( aCounters.mPeakBytes, bytes );
+  }
+
+  void uncount( Counters& aCounters, std::uint64_t aSize )
+  {
+    aCounters.mBytes.fetch_sub( aSize, std::memory_order_relaxed );
+    aCounters.mAllocations.fetch_sub( 1, std::memory_order_relaxed );
+  }
+
+  MemoryTracker::TagStats read( const Counters& aCounters )
+  {
+    MemoryTracker::TagStats stats;
+    stats.mBytes            = aCounters.mBytes.load( std::memory_order_relaxed );
+    stats.mAllocations      = aCounters.mAllocations.load( std::memory_order_relaxed );
+    stats.mTotalAllocations = aCounters.mTotalAllocations.load( std::memory_order_relaxed );
+    stats.mPeakBytes        = aCounters.mPeakBytes.load( std::memory_order_relaxed );
+    return stats;
+  }
+
+  // The packed components and the packed entities owning them; the sparse
+  // pages indexing them are left out.
+  template<typename Component>
+  MemoryTracker::PoolStats getPool( entt::registry& aRegistry, const char* aName )
+  {
+    MemoryTracker::PoolStats stats;
+    stats.mName     = aName;
+    stats.mSize     = aRegistry.size<Component>();
+    stats.mCapacity = aRegistry.capacity<Component>();
+
+    std::size_t componentSize = sizeof( entt::registry::entity_type );
+    if constexpr ( !std::is_empty<Component>::value )
+      componentSize += sizeof( Component );
+    stats.mBytes = stats.mCapacity * componentSize;
+
+    return stats;
+  }
+
+  void writeTagStats( std::ostream& aStream, const MemoryTracker::TagStats& aStats )
+  {
+    aStream << "{ \"bytes\": " << aStats.mBytes
+      << ", \"allocations\": " << aStats.mAllocations
+      << ", \"total_allocations\": " << aStats.mTotalAllocations
+      << ", \"peak_bytes\": " << aStats.mPeakBytes << " }";
+  }
+}
+
+
+const char*
+MemoryTracker::getTagName( Tag aTag )
+{
+  switch ( aTag )
+  {
+  case TAG_UNTAGGED:    return "untagged";
+  case TAG_ECS:         return "ecs";
+  case TAG_ASSETS:      return "assets";
+  case TAG_RENDER:      return "render";
+  case TAG_PATHFINDING: return "pathfinding";
+  case TAG_SNAPSHOT:    return "snapshot";
+  case TAG_COUNT:       break;
+  }
+
+  assert( false );
+  return "";
+}
+
+
+double
+MemoryTracker::Report::getBytesPerEntity() const
+{
+  if ( mEntities == 0 )
+    return 0.0;
+
+  std::size_t bytes = mEntityBytes;
+  for ( const PoolStats& pool : mPools )
+    bytes += pool.mBytes + pool.mOwnedBytes;
+
+  return static_cast<double>( bytes ) / mEntities;
+}
+
+
+double
+MemoryTracker::Report::getBytesPerTile() const
+{
+  if ( mTiles == 0 )
+    return 0.0;
+
+  return static_cast<double>( mMapBytes + mChunkBytes ) / mTiles;
+}
+
+
+bool
+MemoryTracker::isHooked()
+{
+#ifdef RPG_MEMORY_TRACKING
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+MemoryTracker::TagStats
+MemoryTracker::getTagStats( Tag aTag )
+{
+  assert( aTag < TAG_COUNT );
+  return read( gCounters[aTag] );
+}
+
+
+MemoryTracker::TagStats
+MemoryTracker::getTotalStats()
+{
+  return read( gTotal );
+}
+
+
+void
+MemoryTracker::resetPeaks()
+{
+  for ( Counters& counters : gCounters )
+    counters.mPeakBytes.store( counters.mBytes.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+}
+
+
+std::vector<MemoryTracker::PoolStats>
+MemoryTracker::getPoolStats( entt::registry& aRegistry )
+{
+  // VertexArray does not tell its capacity: its vertex count is a lower bound.
+  PoolStats chunks = getPool<ComponentTileChunk>( aRegistry, "ComponentTileChunk" );
+  aRegistry.view<ComponentTileChunk>().each( [&chunks]( const ComponentTileChunk& aChunk )
+  {
+    chunks.mOwnedBytes += aChunk.mVertices.getVertexCount() * sizeof( sf::Vertex );
+  } );
+
+  PoolStats paths = getPool<ComponentPath>( aRegistry, "ComponentPath" );
+  aRegistry.view<ComponentPath>().each( [&paths]( const ComponentPath& aPath )
+  {
+    paths.mOwnedBytes += aPath.mWaypoints.capacity() * sizeof( sf::Vector2i );
+  } );
+
+  std::vector<PoolStats> pools;
+  pools.push_back( getPool<ComponentPositionWorld>( aRegistry, "ComponentPositionWorld" ) );
+  pools.push_back( getPool<ComponentPositionWorldPrevious>( aRegistry, "ComponentPositionWorldPrevious" ) );
+  pools.push_back( getPool<ComponentSprite>( aRegistry, "ComponentSprite" ) );
+  pools.push_back( getPool<ComponentLayerBackground>( aRegistry, "ComponentLayerBackground" ) );
+  pools.push_back( chunks );
+  pools.push_back( getPool<ComponentSpriteAnimated>( aRegistry, "ComponentSpriteAnimated" ) );
+  pools.push_back( getPool<ComponentWorldMovement>( aRegistry, "ComponentWorldMovement" ) );
+  pools.push_back( paths );
+  pools.push_back( getPool<ComponentMainCharacter>( aRegistry, "ComponentMainCharacter" ) );
+  pools.push_back( getPool<ComponentCharacterAnimation>( aRegistry, "ComponentCharacterAnimation" ) );
+
+  return pools;
+}
+
+
+MemoryTracker::Report
+MemoryTracker::getReport( entt::registry& aRegistry )
+{
+  Report report;
+
+  report.mHooked = isHooked();
+  for ( int tag = 0; tag < TAG_COUNT; ++tag )
+    report.mTags[tag] = getTagStats( static_cast<Tag>( tag ) );
+  report.mTotal = getTotalStats();
+
+  report.mPools       = getPoolStats( aRegistry );
+  report.mEntities    = aRegistry.alive();
+  report.mEntityBytes = aRegistry.capacity() * sizeof( entt::registry::entity_type );
+  for ( const PoolStats& pool : report.mPools )
+  {
+    if ( std::strcmp( pool.mName, "ComponentTileChunk" ) == 0 )
+      report.mChunkBytes = pool.mBytes + pool.mOwnedBytes;
+  }
+
+  return report;
+}
+
+
+MemoryTracker::Report
+MemoryTracker::getReport( entt::registry& aRegistry, AssetLoader& aAssets )
+{
+  Report report = getReport( aRegistry );
+
+  const AssetLoader::MemoryStats assets = aAssets.GetMemoryStats();
+  report.mTextureBytes = assets.mTextureBytes;
+  report.mAtlasBytes   = assets.mAtlasBytes;
+  report.mMapBytes     = assets.mMapBytes;
+  report.mUploadBytes  = assets.mUploadBytes;
+  report.mTiles        = assets.mTiles;
+
+  return report;
+}
+
+
+void
+MemoryTracker::writeJson( const Report& aReport, std::ostream& aStream )
+{
+  const std::ios_base::fmtflags flags = aStream.flags();
+  aStream << std::fixed << std::setprecision( 1 );
+
+  aStream << "{\n  \"hooked\": " << ( aReport.mHooked ? "true" : "false" );
+
+  aStream << ",\n  \"tags\": {";
+  for ( int tag = 0; tag < TAG_COUNT; ++tag )
+  {
+    aStream << ( tag > 0 ? "," : "" ) << "\n    \"" << getTagName( static_cast<Tag>( tag ) ) << "\": ";
+    writeTagStats( aStream, aReport.mTags[tag] );
+  }
+  aStream << "\n  },\n  \"total\": ";
+  writeTagStats( aStream, aReport.mTotal );
+
+  aStream << ",\n  \"pools\": [";
+  for ( std::size_t i = 0; i < aReport.mPools.size(); ++i )
+  {
+    const PoolStats& pool = aReport.mPools[i];
+    aStream << ( i > 0 ? "," : "" ) << "\n    { \"name\": \"" << pool.mName << "\""
+      << ", \"size\": " << pool.mSize
+      << ", \"capacity\": " << pool.mCapacity
+      << ", \"bytes\": " << pool.mBytes
+      << ", \"owned_bytes\": " << pool.mOwnedBytes << " }";
+  }
+
+  aStream << "\n  ],\n  \"entities\": " << aReport.mEntities
+    << ",\n  \"entity_bytes\": " << aReport.mEntityBytes
+    << ",\n  \"texture_bytes\": " << aReport.mTextureBytes
+    << ",\n  \"atlas_bytes\": " << aReport.mAtlasBytes
+    << ",\n  \"map_bytes\": " << aReport.mMapBytes
+    << ",\n  \"chunk_bytes\": " << aReport.mChunkBytes
+    << ",\n  \"upload_bytes\": " << aReport.mUploadBytes
+    << ",\n  \"tiles\": " << aReport.mTiles
+    << ",\n  \"bytes_per_entity\": " << aReport.getBytesPerEntity()
+    << ",\n  \"bytes_per_tile\": " << aReport.getBytesPerTile()
+    << "\n}\n";
+
+  aStream.flags( flags );
+}
+
+
+bool
+MemoryTracker::writeJson( const Report& aReport, const std::string& aPath )
+{
+  std::ofstream writer( aPath );
+  if ( !writer )
+    return false;
+
+  writeJson( aReport, writer );
+  return static_cast<bool>( writer );
+}
+
+
+void*
+MemoryTracker::allocate( std::size_t aSize ) noexcept
+{
+  void* memory = std::malloc( sizeof( BlockHeader ) + aSize );
+  if ( memory == nullptr )
+    return nullptr;
+
+  const Tag tag = gCurrentTag;
+
+  BlockHeader* header = static_cast<BlockHeader*>( memory );
+  header->mSize = aSize;
+  header->mTag  = tag;
+
+  count( gCounters[tag], aSize );
+  count( gTotal, aSize );
+
+  return header + 1;
+}
+
+
+void
+MemoryTracker::deallocate( void* aMemory ) noexcept
+{
+  if ( aMemory == nullptr )
+    return;
+
+  BlockHeader* header = static_cast<BlockHeader*>( aMemory ) - 1;
+  uncount( gCounters[header->mTag], header->mSize );
+  uncount( gTotal, header->mSize );
+
+  std::free( header );
+}
+
+
+MemoryTracker::Scope::Scope( Tag aTag )
+  : mPrevious ( gCurrentTag )
+{
+  gCurrentTag = aTag;
+}
+
+
+MemoryTracker::Scope::~Scope()
+{
+  gCurrentTag = mPrevious;
+}
+
+
+#ifdef RPG_MEMORY_TRACKING
+
+// Every allocation of a program linked with the tracker goes through here.
+// The over-aligned forms are left to the standard library: they are
+// allocated and freed apart from these, and not counted.
+void* operator new( std::size_t aSize )
+{
+  if ( void* memory = MemoryTracker::allocate( aSize ? aSize : 1 ) )
+    return memory;
+  throw std::bad_alloc();
+}
+
+
+void* operator new[]( std::size_t aSize )
+{
+  return operator new( aSize );
+}
+
+
+void* operator new( std::size_t aSize, const std::nothrow_t& ) noexcept
+{
+  return MemoryTracker::allocate( aSize ? aSize : 1 );
+}
+
+
+void* operator new[]( std::size_t aSize, const std::nothrow_t& ) noexcept
+{
+  return MemoryTracker::allocate( aSize ? aSize : 1 );
+}
+
+
+void operator delete( void* aMemory ) noexcept
+{
+  MemoryTracker::deallocate( aMemory );
+}
+
+
+void operator delete[]( void* aMemory ) noexcept
+{
+  MemoryTracker::deallocate( aMemory );
+}
+
+
+void operator delete( void* aMemory, std::size_t ) noexcept
+{
+  MemoryTracker::deallocate( aMemory );
+}
+
+
+void operator delete[]( void* aMemory, std::size_t ) noexcept
+{
+  MemoryTracker::deallocate( aMemory );
+}
+
+
+void operator delete( void* aMemory, const std::nothrow_t& ) noexcept
+{
+  MemoryTracker::deallocate( aMemory );
+}
+
+
+void operator delete[]( void* aMemory, const std::nothrow_t& ) noexcept
+{
+  MemoryTracker::deallocate( aMemory );
+}
+
+#endif
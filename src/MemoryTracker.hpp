@@ -0,0 +1,144 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+class AssetLoader;
+
+// Memory accounting. With RPG_MEMORY_TRACKING, the global operator new is
+// replaced: every block carries a small header with its size and the tag
+// of the scope it was allocated in, so per-subsystem byte counts stay
+// right when blocks are freed on another thread. MEMORY_TAG( tag ) sets
+// the calling thread's tag for the rest of the enclosing scope; blocks
+// allocated outside any tagged scope count as TAG_UNTAGGED.
+//
+// Pools, textures and maps are measured from their owners when a report
+// is taken, so they are available even without the allocation hooks.
+namespace MemoryTracker
+{
+  enum Tag
+  {
+    TAG_UNTAGGED,
+    TAG_ECS,         // Entities and components built by the systems.
+    TAG_ASSETS,      // Decoded images, parsed maps and animations.
+    TAG_RENDER,      // Chunk geometry, sprite batches, paged tiles.
+    TAG_PATHFINDING,
+    TAG_SNAPSHOT,
+    TAG_COUNT
+  };
+
+  const char* getTagName( Tag aTag );
+
+  struct TagStats
+  {
+    std::uint64_t mBytes { 0 };            // Live.
+    std::uint64_t mAllocations { 0 };      // Live.
+    std::uint64_t mTotalAllocations { 0 }; // Since the start.
+    std::uint64_t mPeakBytes { 0 };        // High-water mark of mBytes since the last resetPeaks().
+  };
+
+  // Storage of one component type: the components and the entities
+  // owning them, plus the heap blocks the components own themselves.
+  struct PoolStats
+  {
+    const char* mName { nullptr };
+    std::size_t mSize { 0 };
+    std::size_t mCapacity { 0 };
+    std::size_t mBytes { 0 };      // Reserved, from mCapacity.
+    std::size_t mOwnedBytes { 0 }; // Vertices of the tile chunks, waypoints of the paths.
+  };
+
+  struct Report
+  {
+    bool                              mHooked { false }; // The allocation counts are filled.
+    std::array<TagStats, TAG_COUNT>   mTags;
+    TagStats                          mTotal;
+    std::vector<PoolStats>            mPools;
+    std::size_t                       mEntities { 0 };
+    std::size_t                       mEntityBytes { 0 }; // Entity storage of the registry.
+    std::size_t                       mTextureBytes { 0 };
+    std::size_t                       mAtlasBytes { 0 };
+    std::size_t                       mMapBytes { 0 };    // Parsed maps and memory mapped files.
+    std::size_t                       mChunkBytes { 0 };  // The tile chunk pool and its geometry.
+    std::size_t                       mUploadBytes { 0 }; // Decoded images not uploaded yet.
+    std::size_t                       mTiles { 0 };
+
+    // Pools and entity storage per entity; map data and chunk geometry per tile.
+    double getBytesPerEntity() const;
+    double getBytesPerTile() const;
+  };
+
+  // Whether the allocation hooks are compiled in.
+  bool isHooked();
+
+  TagStats getTagStats( Tag aTag );
+  TagStats getTotalStats();
+
+  // Starts new high-water marks from the current live bytes.
+  void resetPeaks();
+
+  std::vector<PoolStats> getPoolStats( entt::registry& aRegistry );
+
+  // The allocation counts and the pools of aRegistry; with aAssets, from
+  // the render thread, what the loader holds as well.
+  Report getReport( entt::registry& aRegistry );
+  Report getReport( entt::registry& aRegistry, AssetLoader& aAssets );
+
+  void writeJson( const Report& aReport, std::ostream& aStream );
+  bool writeJson( const Report& aReport, const std::string& aPath );
+
+  // The allocation hooks, for the replaced operator new and delete. Blocks
+  // from allocate() are 16-byte aligned and freed by deallocate() only.
+  void* allocate( std::size_t aSize ) noexcept;
+  void deallocate( void* aMemory ) noexcept;
+
+  class Scope
+  {
+  public:
+    explicit Scope( Tag aTag );
+    ~Scope();
+
+    Scope( const Scope& ) = delete;
+    Scope& operator=( const Scope& ) = delete;
+
+  private:
+    Tag mPrevious;
+  };
+}
+
+#ifdef RPG_MEMORY_TRACKING
+#define MEMORY_CONCATENATE_( aLeft, aRight ) aLeft##aRight
+#define MEMORY_CONCATENATE( aLeft, aRight ) MEMORY_CONCATENATE_( aLeft, aRight )
+#define MEMORY_TAG( aTag ) MemoryTracker::Scope MEMORY_CONCATENATE( memoryTag, __LINE__ )( MemoryTracker::aTag )
+#else
+#define MEMORY_TAG( aTag ) do {} while ( false )
+#endif
@@ -0,0 +1,735 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "Pathfinder.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <queue>
+
+#include "Components.hpp"
+#include "GlobalDefs.hpp"
+#include "MemoryTracker.hpp"
+#include "Profiler.hpp"
+#include "SystemMovement.hpp"
+
+namespace
+{
+  const std::uint32_t UNREACHABLE = ~std::uint32_t( 0 );
+
+  // Abstract graph nodes are keyed by cluster << 32 | index in the cluster.
+  const std::uint64_t START_KEY = ~std::uint64_t( 0 );
+  const std::uint64_t GOAL_KEY  = ~std::uint64_t( 0 ) - 1;
+
+  // Borders open over fewer tiles get one node, in their middle; longer ones
+  // get one at each end, so paths along a wall need no detour.
+  const int LONG_OPENING = 6;
+
+  const sf::Vector2i STEPS[] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+  std::uint64_t nodeKey( int aCluster, std::size_t aIndex )
+  {
+    return static_cast<std::uint64_t>( aCluster ) << 32 | aIndex;
+  }
+
+  std::uint32_t manhattan( sf::Vector2i aFrom, sf::Vector2i aTo )
+  {
+    return static_cast<std::uint32_t>( std::abs( aTo.x - aFrom.x ) + std::abs( aTo.y - aFrom.y ) );
+  }
+
+  std::size_t localIndex( const sf::IntRect& aRect, sf::Vector2i aTile )
+  {
+    return static_cast<std::size_t>( aTile.y - aRect.top ) * aRect.width + ( aTile.x - aRect.left );
+  }
+
+  // Keeps the tiles of aPath where it turns, and its last one.
+  std::vector<sf::Vector2i> toWaypoints( sf::Vector2i aStart, const std::vector<sf::Vector2i>& aPath )
+  {
+    std::vector<sf::Vector2i> waypoints;
+    sf::Vector2i previous = aStart;
+    for ( std::size_t i = 0; i < aPath.size(); ++i )
+    {
+      if ( i + 1 == aPath.size() || aPath[i] - previous != aPath[i + 1] - aPath[i] )
+        waypoints.push_back( aPath[i] );
+      previous = aPath[i];
+    }
+    return waypoints;
+  }
+}
+
+
+Pathfinder::Pathfinder( const TileGridView& aMap, std::vector<bool> aWalkableTiles, const Settings& aSettings )
+  : mSettings ( aSettings )
+  , mSize ( aMap.getSize() )
+  , mWalkableTiles ( std::move( aWalkableTiles ) )
+  , mPool ( std::make_unique<ThreadPool>( aSettings.mThreadCount ) )
+{
+  PROFILE_ZONE( "build pathfinder" );
+  MEMORY_TAG( TAG_PATHFINDING );
+
+  assert( mSettings.mClusterSize > 0 && mSettings.mBatchSize > 0 );
+
+  mClusterCount.x = ( mSize.x + mSettings.mClusterSize - 1 ) / mSettings.mClusterSize;
+  mClusterCount.y = ( mSize.y + mSettings.mClusterSize - 1 ) / mSettings.mClusterSize;
+
+  mWalkable.resize( static_cast<std::size_t>( mSize.x ) * mSize.y );
+  for ( int y = 0; y < mSize.y; ++y )
+  {
+    const TileId* row = aMap.row( y );
+    for ( int x = 0; x < mSize.x; ++x )
+      mWalkable[static_cast<std::size_t>( y ) * mSize.x + x] = row[x] >= mWalkableTiles.size() || mWalkableTiles[row[x]];
+  }
+
+  // Clusters only read the tiles: each worker builds a range of them.
+  mClusters.resize( static_cast<std::size_t>( mClusterCount.x ) * mClusterCount.y );
+  const int clusterCount = static_cast<int>( mClusters.size() );
+  const int rangeSize = std::max( 1, clusterCount / static_cast<int>( mPool->getThreadCount() * 4 ) );
+
+  std::vector<std::future<void>> ranges;
+  for ( int first = 0; first < clusterCount; first += rangeSize )
+  {
+    const int last = std::min( first + rangeSize, clusterCount );
+    ranges.push_back( mPool->submit( [this, first, last]()
+    {
+      for ( int cluster = first; cluster < last; ++cluster )
+        buildCluster( cluster, mClusters[cluster] );
+    } ) );
+  }
+  for ( auto& range : ranges )
+    range.get();
+}
+
+
+std::vector<bool>
+Pathfinder::readWalkableTiles( const std::string& aPath )
+{
+  std::vector<bool> walkableTiles( Globals::TILESET_COLUMNS * Globals::TILESET_ROWS, true );
+
+  std::ifstream reader( aPath );
+  sf::Vector2i spriteIndex;
+  while ( reader >> spriteIndex.x >> spriteIndex.y )
+  {
+    const TileId tileId = tileIdFromSpriteIndex( spriteIndex );
+    if ( tileId < walkableTiles.size() )
+      walkableTiles[tileId] = false;
+  }
+
+  return walkableTiles;
+}
+
+
+void
+Pathfinder::requestPath( entt::registry& aRegistry, entt::entity aEntity, sf::Vector2i aGoal, float aSpeed )
+{
+  const sf::Vector2f position = aRegistry.get<ComponentPositionWorld>( aEntity ).mPosition;
+
+  Request request;
+  request.mEntity = aEntity;
+  request.mSerial = ++mNextSerial;
+  request.mStart  = sf::Vector2i( static_cast<int>( std::lround( position.x ) ), static_cast<int>( std::lround( position.y ) ) );
+  request.mGoal   = aGoal;
+  request.mSpeed  = aSpeed;
+
+  mLatestSerials[aEntity] = request.mSerial;
+  mQueued.push_back( request );
+  ++mRequestCount;
+}
+
+
+void
+Pathfinder::updateTiles( const TileGridView& aMap, const std::vector<sf::Vector2i>& aTiles )
+{
+  if ( aTiles.empty() )
+    return;
+
+  assert( aMap.getSize() == mSize );
+
+  // The new walkability of every tile; the workers compare it with theirs.
+  std::vector<std::pair<std::size_t, bool>> patch;
+  patch.reserve( aTiles.size() );
+  for ( const sf::Vector2i& tile : aTiles )
+  {
+    const TileId tileId = aMap.at( tile.x, tile.y );
+    patch.emplace_back( static_cast<std::size_t>( tile.y ) * mSize.x + tile.x, tileId >= mWalkableTiles.size() || mWalkableTiles[tileId] );
+  }
+
+  mJobs.push_back( mPool->submit( [this, patch]() { rebuild( patch ); } ) );
+}
+
+
+void
+Pathfinder::update( entt::registry& aRegistry, SystemMovement& aMovement )
+{
+  PROFILE_ZONE( "update pathfinder" );
+  MEMORY_TAG( TAG_PATHFINDING );
+
+  submitQueued();
+
+  while ( !mJobs.empty() && mJobs.front().wait_for( std::chrono::seconds( 0 ) ) == std::future_status::ready )
+  {
+    mJobs.front().get();
+    mJobs.pop_front();
+  }
+
+  // Paths found start their first leg, within the budget; the rest wait for
+  // the next tick.
+  sf::Clock clock;
+  for ( ;; )
+  {
+    Result result;
+    {
+      std::lock_guard<std::mutex> lock( mResultsMutex );
+      if ( mResults.empty() )
+        break;
+      result = std::move( mResults.front() );
+      mResults.pop_front();
+    }
+
+    // Superseded by a later request for the same entity.
+    auto latest = mLatestSerials.find( result.mEntity );
+    if ( latest == mLatestSerials.end() || latest->second != result.mSerial )
+      continue;
+    mLatestSerials.erase( latest );
+
+    if ( aRegistry.valid( result.mEntity ) )
+    {
+      if ( result.mFound && !result.mWaypoints.empty() )
+      {
+        const sf::Vector2i first = result.mWaypoints.front();
+        aRegistry.assign_or_replace<ComponentPath>( result.mEntity, ComponentPath { std::move( result.mWaypoints ), 1, result.mSpeed } );
+        aMovement.startMove( aRegistry, result.mEntity, sf::Vector2f( first ), result.mSpeed );
+      }
+      else if ( aRegistry.has<ComponentPath>( result.mEntity ) )
+        aRegistry.remove<ComponentPath>( result.mEntity );
+    }
+
+    if ( clock.getElapsedTime() >= mSettings.mApplyBudget )
+      break;
+  }
+
+  // Legs walked: on to the next waypoint, or done.
+  auto view = aRegistry.view<ComponentPath, ComponentWorldMovement>();
+  for ( auto entity : view )
+  {
+    if ( view.get<ComponentWorldMovement>( entity ).mRatio < 1.0f )
+      continue;
+
+    auto& path = view.get<ComponentPath>( entity );
+    if ( path.mNext < path.mWaypoints.size() )
+      aMovement.startMove( aRegistry, entity, sf::Vector2f( path.mWaypoints[path.mNext++] ), path.mSpeed );
+    else
+      mArrived.push_back( entity );
+  }
+
+  for ( auto entity : mArrived )
+    aRegistry.remove<ComponentPath>( entity );
+  mArrived.clear();
+}
+
+
+void
+Pathfinder::waitIdle()
+{
+  submitQueued();
+
+  for ( auto& job : mJobs )
+    job.get();
+  mJobs.clear();
+}
+
+
+bool
+Pathfinder::isWalkable( sf::Vector2i aTile ) const
+{
+  std::shared_lock<std::shared_mutex> lock( mGraphMutex );
+  return isOpen( aTile );
+}
+
+
+Pathfinder::Stats
+Pathfinder::getStats() const
+{
+  Stats stats;
+  stats.mRequests        = mRequestCount;
+  stats.mFound           = mFoundCount;
+  stats.mNotFound        = mNotFoundCount;
+  stats.mCacheHits       = mCacheHitCount;
+  stats.mClusterRebuilds = mClusterRebuildCount;
+  return stats;
+}
+
+
+bool
+Pathfinder::isOpen( sf::Vector2i aTile ) const
+{
+  if ( aTile.x < 0 || aTile.y < 0 || aTile.x >= mSize.x || aTile.y >= mSize.y )
+    return false;
+
+  return mWalkable[static_cast<std::size_t>( aTile.y ) * mSize.x + aTile.x];
+}
+
+
+int
+Pathfinder::getClusterIndex( sf::Vector2i aTile ) const
+{
+  return ( aTile.y / mSettings.mClusterSize ) * mClusterCount.x + aTile.x / mSettings.mClusterSize;
+}
+
+
+sf::IntRect
+Pathfinder::getClusterRect( int aCluster ) const
+{
+  const int left = ( aCluster % mClusterCount.x ) * mSettings.mClusterSize;
+  const int top  = ( aCluster / mClusterCount.x ) * mSettings.mClusterSize;
+  return sf::IntRect( left, top, std::min( mSettings.mClusterSize, mSize.x - left ), std::min( mSettings.mClusterSize, mSize.y - top ) );
+}
+
+
+void
+Pathfinder::buildCluster( int aCluster, Cluster& aOut ) const
+{
+  const sf::IntRect rect = getClusterRect( aCluster );
+
+  aOut.mNodes.clear();
+  for ( const sf::Vector2i& outward : STEPS )
+    addBorderNodes( rect, outward, aOut );
+
+  // Every node to every other it reaches without leaving the cluster.
+  std::vector<std::uint32_t> distances;
+  for ( Node& node : aOut.mNodes )
+  {
+    searchCluster( rect, node.mTile, distances );
+
+    for ( std::size_t other = 0; other < aOut.mNodes.size(); ++other )
+    {
+      const std::uint32_t distance = distances[localIndex( rect, aOut.mNodes[other].mTile )];
+      if ( &aOut.mNodes[other] != &node && distance != UNREACHABLE )
+        node.mEdges.emplace_back( static_cast<std::uint32_t>( other ), distance );
+    }
+  }
+}
+
+
+void
+Pathfinder::addBorderNodes( const sf::IntRect& aRect, sf::Vector2i aOutward, Cluster& aOut ) const
+{
+  // The border tiles of aRect on the aOutward side, walked along the side.
+  const sf::Vector2i along( aOutward.y != 0 ? 1 : 0, aOutward.x != 0 ? 1 : 0 );
+  const sf::Vector2i first(
+    aOutward.x > 0 ? aRect.left + aRect.width - 1 : aRect.left,
+    aOutward.y > 0 ? aRect.top + aRect.height - 1 : aRect.top );
+  const int length = along.x != 0 ? aRect.width : aRect.height;
+
+  auto addNode = [&aOut, aOutward]( sf::Vector2i aTile )
+  {
+    // Corner tiles may open on two sides.
+    auto node = std::find_if( aOut.mNodes.begin(), aOut.mNodes.end(), [aTile]( const Node& aNode ) { return aNode.mTile == aTile; } );
+    if ( node == aOut.mNodes.end() )
+    {
+      aOut.mNodes.emplace_back();
+      node = aOut.mNodes.end() - 1;
+      node->mTile = aTile;
+    }
+    node->mExits.push_back( aTile + aOutward );
+  };
+
+  // Both clusters of a border find the same openings, so their nodes face
+  // each other.
+  int openingStart = -1;
+  for ( int i = 0; i <= length; ++i )
+  {
+    const sf::Vector2i tile = first + along * i;
+    const bool open = i < length && isOpen( tile ) && isOpen( tile + aOutward );
+
+    if ( open && openingStart < 0 )
+      openingStart = i;
+    else if ( !open && openingStart >= 0 )
+    {
+      const int openingLength = i - openingStart;
+      if ( openingLength < LONG_OPENING )
+        addNode( first + along * ( openingStart + openingLength / 2 ) );
+      else
+      {
+        addNode( first + along * openingStart );
+        addNode( first + along * ( i - 1 ) );
+      }
+      openingStart = -1;
+    }
+  }
+}
+
+
+void
+Pathfinder::searchCluster( const sf::IntRect& aRect, sf::Vector2i aFrom, std::vector<std::uint32_t>& aDistances ) const
+{
+  aDistances.assign( static_cast<std::size_t>( aRect.width ) * aRect.height, UNREACHABLE );
+  if ( !aRect.contains( aFrom ) || !isOpen( aFrom ) )
+    return;
+
+  thread_local std::vector<sf::Vector2i> frontier;
+  frontier.clear();
+  frontier.push_back( aFrom );
+  aDistances[localIndex( aRect, aFrom )] = 0;
+
+  for ( std::size_t next = 0; next < frontier.size(); ++next )
+  {
+    const sf::Vector2i tile = frontier[next];
+    const std::uint32_t distance = aDistances[localIndex( aRect, tile )] + 1;
+
+    for ( const sf::Vector2i& step : STEPS )
+    {
+      const sf::Vector2i neighbor = tile + step;
+      if ( !aRect.contains( neighbor ) || !isOpen( neighbor ) )
+        continue;
+
+      std::uint32_t& neighborDistance = aDistances[localIndex( aRect, neighbor )];
+      if ( neighborDistance == UNREACHABLE )
+      {
+        neighborDistance = distance;
+        frontier.push_back( neighbor );
+      }
+    }
+  }
+}
+
+
+bool
+Pathfinder::findClusterPath( const sf::IntRect& aRect, sf::Vector2i aFrom, sf::Vector2i aTo, std::vector<sf::Vector2i>& aPath ) const
+{
+  // Searched from aTo: walking down the distances from aFrom leads there.
+  thread_local std::vector<std::uint32_t> distances;
+  searchCluster( aRect, aTo, distances );
+
+  if ( !aRect.contains( aFrom ) || distances[localIndex( aRect, aFrom )] == UNREACHABLE )
+    return false;
+
+  sf::Vector2i tile = aFrom;
+  for ( std::uint32_t distance = distances[localIndex( aRect, aFrom )]; distance > 0; --distance )
+  {
+    for ( const sf::Vector2i& step : STEPS )
+    {
+      const sf::Vector2i neighbor = tile + step;
+      if ( aRect.contains( neighbor ) && distances[localIndex( aRect, neighbor )] == distance - 1 )
+      {
+        tile = neighbor;
+        break;
+      }
+    }
+    aPath.push_back( tile );
+  }
+
+  return true;
+}
+
+
+bool
+Pathfinder::findAbstractPath( sf::Vector2i aStart, sf::Vector2i aGoal, std::vector<sf::Vector2i>& aNodes ) const
+{
+  const int startCluster = getClusterIndex( aStart );
+  const int goalCluster = getClusterIndex( aGoal );
+  const sf::IntRect startRect = getClusterRect( startCluster );
+  const sf::IntRect goalRect = getClusterRect( goalCluster );
+
+  // The start and the goal join the graph through the nodes of their cluster.
+  std::vector<std::uint32_t> startDistances;
+  std::vector<std::uint32_t> goalDistances;
+  searchCluster( startRect, aStart, startDistances );
+  searchCluster( goalRect, aGoal, goalDistances );
+
+  auto tileOf = [this]( std::uint64_t aKey ) -> sf::Vector2i
+  {
+    return mClusters[aKey >> 32].mNodes[aKey & 0xffffffffu].mTile;
+  };
+
+  typedef std::pair<std::uint32_t, std::uint64_t> OpenEntry; // Estimated length, node.
+  std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> open;
+  std::unordered_map<std::uint64_t, std::pair<std::uint32_t, std::uint64_t>> visited; // Length so far, previous node.
+
+  auto reach = [&]( std::uint64_t aKey, std::uint32_t aLength, std::uint64_t aPrevious )
+  {
+    auto node = visited.find( aKey );
+    if ( node != visited.end() && node->second.first <= aLength )
+      return;
+
+    visited[aKey] = std::make_pair( aLength, aPrevious );
+    open.emplace( aLength + ( aKey == GOAL_KEY ? 0 : manhattan( tileOf( aKey ), aGoal ) ), aKey );
+  };
+
+  const Cluster& start = mClusters[startCluster];
+  for ( std::size_t index = 0; index < start.mNodes.size(); ++index )
+  {
+    const std::uint32_t distance = startDistances[localIndex( startRect, start.mNodes[index].mTile )];
+    if ( distance != UNREACHABLE )
+      reach( nodeKey( startCluster, index ), distance, START_KEY );
+  }
+
+  while ( !open.empty() )
+  {
+    const OpenEntry entry = open.top();
+    open.pop();
+
+    if ( entry.second == GOAL_KEY )
+    {
+      for ( std::uint64_t key = visited[GOAL_KEY].second; key != START_KEY; key = visited[key].second )
+        aNodes.push_back( tileOf( key ) );
+      std::reverse( aNodes.begin(), aNodes.end() );
+      return true;
+    }
+
+    const std::uint32_t length = visited[entry.second].first;
+    const sf::Vector2i tile = tileOf( entry.second );
+    if ( entry.first > length + manhattan( tile, aGoal ) )
+      continue; // Reached again, shorter, since it was queued.
+
+    const int cluster = static_cast<int>( entry.second >> 32 );
+    const Node& node = mClusters[cluster].mNodes[entry.second & 0xffffffffu];
+
+    if ( cluster == goalCluster && goalDistances[localIndex( goalRect, tile )] != UNREACHABLE )
+      reach( GOAL_KEY, length + goalDistances[localIndex( goalRect, tile )], entry.second );
+
+    for ( const auto& edge : node.mEdges )
+      reach( nodeKey( cluster, edge.first ), length + edge.second, entry.second );
+
+    for ( const sf::Vector2i& exit : node.mExits )
+    {
+      const int neighborCluster = getClusterIndex( exit );
+      const auto& neighborNodes = mClusters[neighborCluster].mNodes;
+      for ( std::size_t index = 0; index < neighborNodes.size(); ++index )
+      {
+        if ( neighborNodes[index].mTile == exit )
+        {
+          reach( nodeKey( neighborCluster, index ), length + 1, entry.second );
+          break;
+        }
+      }
+    }
+  }
+
+  return false;
+}
+
+
+bool
+Pathfinder::refinePath( sf::Vector2i aStart, sf::Vector2i aGoal, const std::vector<sf::Vector2i>& aNodes, std::vector<sf::Vector2i>& aPath ) const
+{
+  // Nodes follow each other either within a cluster or across a border.
+  sf::Vector2i previous = aStart;
+  for ( std::size_t i = 0; i <= aNodes.size(); ++i )
+  {
+    const sf::Vector2i next = i < aNodes.size() ? aNodes[i] : aGoal;
+    const int cluster = getClusterIndex( previous );
+
+    if ( cluster == getClusterIndex( next ) )
+    {
+      if ( !findClusterPath( getClusterRect( cluster ), previous, next, aPath ) )
+        return false;
+    }
+    else if ( manhattan( previous, next ) == 1 && isOpen( next ) )
+      aPath.push_back( next );
+    else
+      return false;
+
+    previous = next;
+  }
+
+  return true;
+}
+
+
+Pathfinder::Result
+Pathfinder::findPath( const Request& aRequest )
+{
+  Result result;
+  result.mEntity = aRequest.mEntity;
+  result.mSerial = aRequest.mSerial;
+  result.mSpeed  = aRequest.mSpeed;
+  result.mFound  = false;
+
+  std::shared_lock<std::shared_mutex> lock( mGraphMutex );
+
+  const sf::Vector2i start = aRequest.mStart;
+  const sf::Vector2i goal = aRequest.mGoal;
+  if ( !isOpen( start ) || !isOpen( goal ) )
+  {
+    ++mNotFoundCount;
+    return result;
+  }
+
+  const int startCluster = getClusterIndex( start );
+  const int goalCluster = getClusterIndex( goal );
+
+  std::vector<sf::Vector2i> path;
+  if ( startCluster == goalCluster )
+    result.mFound = findClusterPath( getClusterRect( startCluster ), start, goal, path );
+
+  // The route of a former search between the same clusters is reused when
+  // both ends still connect to it.
+  std::vector<sf::Vector2i> nodes;
+  const std::uint64_t routeKey = nodeKey( startCluster, static_cast<std::size_t>( goalCluster ) );
+  if ( !result.mFound && startCluster != goalCluster && lookupRoute( routeKey, nodes ) )
+  {
+    result.mFound = refinePath( start, goal, nodes, path );
+    if ( result.mFound )
+      ++mCacheHitCount;
+  }
+
+  if ( !result.mFound )
+  {
+    nodes.clear();
+    path.clear();
+    result.mFound = findAbstractPath( start, goal, nodes ) && refinePath( start, goal, nodes, path );
+    if ( result.mFound && startCluster != goalCluster )
+      storeRoute( routeKey, nodes );
+  }
+
+  if ( result.mFound )
+  {
+    result.mWaypoints = toWaypoints( start, path );
+    ++mFoundCount;
+  }
+  else
+    ++mNotFoundCount;
+
+  return result;
+}
+
+
+void
+Pathfinder::searchBatch( const std::vector<Request>& aRequests )
+{
+  PROFILE_ZONE( "search paths" );
+  MEMORY_TAG( TAG_PATHFINDING );
+
+  std::vector<Result> results;
+  results.reserve( aRequests.size() );
+  for ( const Request& request : aRequests )
+    results.push_back( findPath( request ) );
+
+  std::lock_guard<std::mutex> lock( mResultsMutex );
+  for ( Result& result : results )
+    mResults.push_back( std::move( result ) );
+}
+
+
+void
+Pathfinder::rebuild( const std::vector<std::pair<std::size_t, bool>>& aPatch )
+{
+  PROFILE_ZONE( "rebuild pathfinder clusters" );
+  MEMORY_TAG( TAG_PATHFINDING );
+
+  std::unique_lock<std::shared_mutex> lock( mGraphMutex );
+
+  // A changed tile moves the openings of its cluster's borders: the
+  // neighbors' nodes on those borders are rebuilt too.
+  std::vector<int> clusters;
+  for ( const auto& tile : aPatch )
+  {
+    if ( mWalkable[tile.first] == tile.second )
+      continue;
+    mWalkable[tile.first] = tile.second;
+
+    const sf::Vector2i position( static_cast<int>( tile.first % mSize.x ), static_cast<int>( tile.first / mSize.x ) );
+    const sf::Vector2i cluster( position.x / mSettings.mClusterSize, position.y / mSettings.mClusterSize );
+    clusters.push_back( cluster.y * mClusterCount.x + cluster.x );
+    for ( const sf::Vector2i& step : STEPS )
+    {
+      const sf::Vector2i neighbor = cluster + step;
+      if ( neighbor.x >= 0 && neighbor.y >= 0 && neighbor.x < mClusterCount.x && neighbor.y < mClusterCount.y )
+        clusters.push_back( neighbor.y * mClusterCount.x + neighbor.x );
+    }
+  }
+
+  if ( clusters.empty() )
+    return;
+
+  std::sort( clusters.begin(), clusters.end() );
+  clusters.erase( std::unique( clusters.begin(), clusters.end() ), clusters.end() );
+
+  for ( int cluster : clusters )
+    buildCluster( cluster, mClusters[cluster] );
+  mClusterRebuildCount += clusters.size();
+
+  // Cached routes may cross the old openings.
+  std::lock_guard<std::mutex> cacheLock( mCacheMutex );
+  mRoutes.clear();
+  mRouteIndex.clear();
+}
+
+
+bool
+Pathfinder::lookupRoute( std::uint64_t aKey, std::vector<sf::Vector2i>& aNodes )
+{
+  std::lock_guard<std::mutex> lock( mCacheMutex );
+
+  auto route = mRouteIndex.find( aKey );
+  if ( route == mRouteIndex.end() )
+    return false;
+
+  mRoutes.splice( mRoutes.begin(), mRoutes, route->second );
+  aNodes = route->second->second;
+  return true;
+}
+
+
+void
+Pathfinder::storeRoute( std::uint64_t aKey, const std::vector<sf::Vector2i>& aNodes )
+{
+  if ( mSettings.mCacheSize == 0 )
+    return;
+
+  std::lock_guard<std::mutex> lock( mCacheMutex );
+
+  auto route = mRouteIndex.find( aKey );
+  if ( route != mRouteIndex.end() )
+  {
+    route->second->second = aNodes;
+    mRoutes.splice( mRoutes.begin(), mRoutes, route->second );
+    return;
+  }
+
+  mRoutes.emplace_front( aKey, aNodes );
+  mRouteIndex[aKey] = mRoutes.begin();
+
+  if ( mRoutes.size() > mSettings.mCacheSize )
+  {
+    mRouteIndex.erase( mRoutes.back().first );
+    mRoutes.pop_back();
+  }
+}
+
+
+void
+Pathfinder::submitQueued()
+{
+  for ( std::size_t first = 0; first < mQueued.size(); first += mSettings.mBatchSize )
+  {
+    const std::size_t last = std::min( first + mSettings.mBatchSize, mQueued.size() );
+    std::vector<Request> batch( mQueued.begin() + first, mQueued.begin() + last );
+    mJobs.push_back( mPool->submit( [this, batch]() { searchBatch( batch ); } ) );
+  }
+  mQueued.clear();
+}
@@ -0,0 +1,214 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <entt/entt.hpp>
+#include <SFML/System.hpp>
+
+#include "ThreadPool.hpp"
+#include "TileGrid.hpp"
+
+class SystemMovement;
+
+// Paths for many agents over the tile grid, with hierarchical path-finding
+// (HPA*). The map is cut into square clusters; the walkable openings between
+// neighboring clusters are the nodes of an abstract graph, whose edges are
+// the distances between the nodes of each cluster. A query searches that
+// small graph, then refines each leg within a single cluster. Movement is in
+// 4 directions, tiles are walkable or not depending on their id.
+//
+// Requests are queued on the calling thread and searched in batches on
+// worker threads; update() hands the paths found to the entities, within a
+// time budget. Routes between the same two clusters are cached. Edited tiles
+// rebuild their clusters and their neighbors in the background.
+class Pathfinder
+{
+public:
+  struct Settings
+  {
+    int         mClusterSize { 32 };                     // In tiles, per side.
+    std::size_t mCacheSize   { 4096 };                   // Routes kept, the least recently used dropped first.
+    std::size_t mBatchSize   { 32 };                     // Requests per worker job.
+    sf::Time    mApplyBudget { sf::milliseconds( 1 ) };  // Spent by update() handing out paths.
+    unsigned    mThreadCount { 0 };                      // 0 for one per hardware thread, minus one.
+  };
+
+  struct Stats
+  {
+    std::uint64_t mRequests { 0 };
+    std::uint64_t mFound { 0 };
+    std::uint64_t mNotFound { 0 };
+    std::uint64_t mCacheHits { 0 };
+    std::uint64_t mClusterRebuilds { 0 };
+  };
+
+  // aWalkableTiles is indexed by TileId; ids past its end are walkable.
+  // Builds the abstract graph of aMap on the workers and waits for it.
+  Pathfinder( const TileGridView& aMap, std::vector<bool> aWalkableTiles, const Settings& aSettings );
+
+  Pathfinder( const Pathfinder& ) = delete;
+  Pathfinder& operator=( const Pathfinder& ) = delete;
+
+  // Every tile is walkable but the ones listed in aPath, as "x y" tileset
+  // sprite indices like the map's. No file blocks nothing.
+  static std::vector<bool> readWalkableTiles( const std::string& aPath );
+
+  // Finds a path from aEntity's tile to aGoal, which aEntity then walks at
+  // aSpeed tiles per second, one ComponentWorldMovement per straight leg. A
+  // new request for an entity supersedes its previous one.
+  void requestPath( entt::registry& aRegistry, entt::entity aEntity, sf::Vector2i aGoal, float aSpeed );
+
+  // A request for aEntity is still being searched.
+  bool isPending( entt::entity aEntity ) const { return mLatestSerials.count( aEntity ) != 0; }
+
+  // aTiles of aMap were edited: their walkability is read now, their
+  // clusters are rebuilt in the background. Paths already handed out are
+  // not revised.
+  void updateTiles( const TileGridView& aMap, const std::vector<sf::Vector2i>& aTiles );
+
+  // Once per tick, outside of the Scheduler as it creates components:
+  // submits the queued requests, hands out the paths found, and starts the
+  // next leg of the entities which finished one.
+  void update( entt::registry& aRegistry, SystemMovement& aMovement );
+
+  // Submits the queued requests and blocks until every one is searched, and
+  // every tile update applied.
+  void waitIdle();
+
+  bool isWalkable( sf::Vector2i aTile ) const;
+
+  Stats getStats() const;
+
+private:
+  struct Request
+  {
+    entt::entity  mEntity;
+    std::uint32_t mSerial;
+    sf::Vector2i  mStart;
+    sf::Vector2i  mGoal;
+    float         mSpeed;
+  };
+
+  struct Result
+  {
+    entt::entity              mEntity;
+    std::uint32_t             mSerial;
+    float                     mSpeed;
+    bool                      mFound;
+    std::vector<sf::Vector2i> mWaypoints;
+  };
+
+  // A tile of a cluster next to a walkable tile of a neighboring cluster.
+  struct Node
+  {
+    sf::Vector2i               mTile;
+    std::vector<sf::Vector2i>  mExits; // Tiles across the borders, one step away.
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> mEdges; // Node index and distance, within the cluster.
+  };
+
+  struct Cluster
+  {
+    std::vector<Node> mNodes;
+  };
+
+  // isWalkable() for the callers already holding mGraphMutex.
+  bool isOpen( sf::Vector2i aTile ) const;
+
+  int getClusterIndex( sf::Vector2i aTile ) const;
+  sf::IntRect getClusterRect( int aCluster ) const;
+
+  void buildCluster( int aCluster, Cluster& aOut ) const;
+  void addBorderNodes( const sf::IntRect& aRect, sf::Vector2i aOutward, Cluster& aOut ) const;
+
+  // Breadth first search over the tiles of aRect from aFrom: distances to
+  // every tile of aRect, ~0 when unreachable.
+  void searchCluster( const sf::IntRect& aRect, sf::Vector2i aFrom, std::vector<std::uint32_t>& aDistances ) const;
+
+  // Appends the tiles after aFrom up to aTo, both in aRect. False when aTo
+  // cannot be reached within aRect.
+  bool findClusterPath( const sf::IntRect& aRect, sf::Vector2i aFrom, sf::Vector2i aTo, std::vector<sf::Vector2i>& aPath ) const;
+
+  // Nodes crossed between aStart and aGoal, from the abstract graph.
+  bool findAbstractPath( sf::Vector2i aStart, sf::Vector2i aGoal, std::vector<sf::Vector2i>& aNodes ) const;
+  bool refinePath( sf::Vector2i aStart, sf::Vector2i aGoal, const std::vector<sf::Vector2i>& aNodes, std::vector<sf::Vector2i>& aPath ) const;
+
+  // Worker side.
+  Result findPath( const Request& aRequest );
+  void searchBatch( const std::vector<Request>& aRequests );
+  void rebuild( const std::vector<std::pair<std::size_t, bool>>& aPatch );
+
+  bool lookupRoute( std::uint64_t aKey, std::vector<sf::Vector2i>& aNodes );
+  void storeRoute( std::uint64_t aKey, const std::vector<sf::Vector2i>& aNodes );
+
+  // Calling thread side.
+  void submitQueued();
+
+  Settings     mSettings;
+  sf::Vector2i mSize;
+  sf::Vector2i mClusterCount;
+  std::vector<bool> mWalkableTiles; // By TileId.
+
+  // The graph, guarded by mGraphMutex: searches share it, rebuilds own it.
+  mutable std::shared_mutex mGraphMutex;
+  std::vector<bool>         mWalkable; // By tile, row-major.
+  std::vector<Cluster>      mClusters;
+
+  // Routes by start and goal cluster, guarded by mCacheMutex.
+  std::mutex mCacheMutex;
+  std::list<std::pair<std::uint64_t, std::vector<sf::Vector2i>>> mRoutes; // Most recently used first.
+  std::unordered_map<std::uint64_t, decltype( mRoutes )::iterator> mRouteIndex;
+
+  // Calling thread side.
+  std::vector<Request> mQueued;
+  std::unordered_map<entt::entity, std::uint32_t> mLatestSerials;
+  std::uint32_t mNextSerial { 0 };
+  std::deque<std::future<void>> mJobs;
+  std::vector<entt::entity> mArrived;
+
+  // Paths found, handed from the workers to update().
+  std::mutex          mResultsMutex;
+  std::deque<Result>  mResults;
+
+  std::atomic<std::uint64_t> mRequestCount { 0 };
+  std::atomic<std::uint64_t> mFoundCount { 0 };
+  std::atomic<std::uint64_t> mNotFoundCount { 0 };
+  std::atomic<std::uint64_t> mCacheHitCount { 0 };
+  std::atomic<std::uint64_t> mClusterRebuildCount { 0 };
+
+  // Searches read the graph and the route cache and post to mResults; declared
+  // last so pending searches finish before any of them goes.
+  std::unique_ptr<ThreadPool> mPool;
+};
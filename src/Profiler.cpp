@@ -0,0 +1,338 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+  // Zones kept per thread; older ones are overwritten.
+  const std::size_t RING_SIZE = 1 << 15;
+  // Frames and samples per zone kept for the rolling statistics.
+  const std::size_t WINDOW_SIZE = 600;
+
+  // Written by the owning thread only. The fields are atomic so the main
+  // thread may read a slot while it is being overwritten: such slots are
+  // detected from the write index and dropped.
+  struct Event
+  {
+    std::atomic<const char*>  mName { nullptr };
+    std::atomic<std::int64_t> mStart { 0 };    // Nanoseconds since the profiler epoch.
+    std::atomic<std::int64_t> mDuration { 0 };
+  };
+
+  struct EventCopy
+  {
+    const char*  mName;
+    std::int64_t mStart;
+    std::int64_t mDuration;
+  };
+
+  struct ThreadBuffer
+  {
+    std::array<Event, RING_SIZE> mEvents;
+    std::atomic<std::uint64_t>   mWriteIndex { 0 };
+    std::atomic<const char*>     mName { nullptr };
+    std::uint32_t                mId { 0 };
+    std::uint64_t                mReadIndex { 0 }; // Main thread only: next event endFrame() collects.
+  };
+
+  // A fixed size window of the latest samples.
+  struct Window
+  {
+    std::vector<double> mSamples;
+    std::size_t         mNext { 0 };
+
+    void add( double aSample )
+    {
+      if ( mSamples.size() < WINDOW_SIZE )
+        mSamples.push_back( aSample );
+      else
+        mSamples[mNext] = aSample;
+      mNext = ( mNext + 1 ) % WINDOW_SIZE;
+    }
+  };
+
+  std::atomic<bool> gEnabled { false };
+
+  std::mutex                                 gBuffersMutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> gBuffers; // Never shrinks: buffers outlive their thread.
+
+  std::int64_t                  gLastFrameEnd { -1 };
+  Window                        gFrameTimes;
+  std::map<std::string, Window> gZoneTimes;
+  // Zone name pointers seen so far, so endFrame() compares strings once per name.
+  std::unordered_map<const char*, Window*> gZoneTimesByName;
+
+  std::int64_t now()
+  {
+    static const auto epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - epoch ).count();
+  }
+
+  // Created on the first zone the thread records, so threads that never
+  // record one cost nothing.
+  thread_local ThreadBuffer* tBuffer = nullptr;
+  thread_local const char*   tThreadName = nullptr;
+
+  ThreadBuffer& threadBuffer()
+  {
+    if ( tBuffer == nullptr )
+    {
+      std::lock_guard<std::mutex> lock( gBuffersMutex );
+      gBuffers.push_back( std::make_unique<ThreadBuffer>() );
+      tBuffer = gBuffers.back().get();
+      tBuffer->mId = static_cast<std::uint32_t>( gBuffers.size() - 1 );
+      tBuffer->mName.store( tThreadName, std::memory_order_relaxed );
+    }
+    return *tBuffer;
+  }
+
+  // Copies the events of aBuffer from aFrom on that were not overwritten
+  // while copying. Returns the index following the last one.
+  std::uint64_t copyEvents( const ThreadBuffer& aBuffer, std::uint64_t aFrom, std::vector<EventCopy>& aEvents )
+  {
+    const std::uint64_t end = aBuffer.mWriteIndex.load( std::memory_order_acquire );
+    std::uint64_t begin = std::max( aFrom, end > RING_SIZE ? end - RING_SIZE : 0 );
+
+    std::vector<EventCopy> events;
+    events.reserve( static_cast<std::size_t>( end - begin ) );
+    for ( std::uint64_t i = begin; i < end; ++i )
+    {
+      const Event& event = aBuffer.mEvents[i % RING_SIZE];
+      events.push_back( { event.mName.load( std::memory_order_relaxed ),
+        event.mStart.load( std::memory_order_relaxed ),
+        event.mDuration.load( std::memory_order_relaxed ) } );
+    }
+
+    // Slots the owner wrapped around to while we copied hold newer events,
+    // and the slot after its write index may be half written.
+    const std::uint64_t endAfter = aBuffer.mWriteIndex.load( std::memory_order_acquire ) + 1;
+    const std::uint64_t firstIntact = endAfter > RING_SIZE ? endAfter - RING_SIZE : 0;
+    const std::size_t overwritten = static_cast<std::size_t>( std::min( end, std::max( begin, firstIntact ) ) - begin );
+
+    aEvents.insert( aEvents.end(), events.begin() + overwritten, events.end() );
+    return end;
+  }
+
+  double percentile( std::vector<double> aSamples, double aPercentile )
+  {
+    if ( aSamples.empty() )
+      return 0.0;
+
+    const std::size_t index = static_cast<std::size_t>( aPercentile * ( aSamples.size() - 1 ) + 0.5 );
+    std::nth_element( aSamples.begin(), aSamples.begin() + index, aSamples.end() );
+    return aSamples[index];
+  }
+
+  void writeEscaped( std::ostream& aStream, const char* aText )
+  {
+    aStream << '"';
+    for ( const char* c = aText; *c != '\0'; ++c )
+    {
+      if ( *c == '"' || *c == '\\' )
+        aStream << '\\';
+      aStream << *c;
+    }
+    aStream << '"';
+  }
+}
+
+void
+Profiler::setEnabled( bool aEnabled )
+{
+  gEnabled.store( aEnabled, std::memory_order_relaxed );
+}
+
+
+bool
+Profiler::isEnabled()
+{
+  return gEnabled.load( std::memory_order_relaxed );
+}
+
+
+void
+Profiler::setThreadName( const char* aName )
+{
+  tThreadName = aName;
+  if ( tBuffer != nullptr )
+    tBuffer->mName.store( aName, std::memory_order_relaxed );
+}
+
+
+void
+Profiler::endFrame()
+{
+  if ( !isEnabled() )
+    return;
+
+  const std::int64_t frameEnd = now();
+  if ( gLastFrameEnd >= 0 )
+    gFrameTimes.add( ( frameEnd - gLastFrameEnd ) / 1e6 );
+  gLastFrameEnd = frameEnd;
+
+  std::vector<EventCopy> events;
+  {
+    std::lock_guard<std::mutex> lock( gBuffersMutex );
+    for ( auto& buffer : gBuffers )
+      buffer->mReadIndex = copyEvents( *buffer, buffer->mReadIndex, events );
+  }
+
+  for ( const EventCopy& event : events )
+  {
+    Window*& zoneTimes = gZoneTimesByName[event.mName];
+    if ( zoneTimes == nullptr )
+      zoneTimes = &gZoneTimes[event.mName];
+    zoneTimes->add( event.mDuration / 1e6 );
+  }
+}
+
+
+std::vector<Profiler::ZoneStats>
+Profiler::getZoneStats()
+{
+  std::vector<ZoneStats> stats;
+
+  for ( const auto& zone : gZoneTimes )
+  {
+    ZoneStats zoneStats;
+    zoneStats.mName  = zone.first;
+    zoneStats.mCount = zone.second.mSamples.size();
+    zoneStats.mP50   = percentile( zone.second.mSamples, 0.50 );
+    zoneStats.mP95   = percentile( zone.second.mSamples, 0.95 );
+    zoneStats.mP99   = percentile( zone.second.mSamples, 0.99 );
+    stats.push_back( zoneStats );
+  }
+
+  return stats;
+}
+
+
+void
+Profiler::writeReport( std::ostream& aStream )
+{
+  // Bucket upper bounds in milliseconds: 240, 120, 60, 30, 15 fps and below.
+  const double bounds[] = { 4.17, 8.33, 16.67, 33.33, 66.67 };
+  const char* const labels[] = { "   < 4.2 ms", "   < 8.3 ms", "  < 16.7 ms", "  < 33.3 ms", "  < 66.7 ms", " >= 66.7 ms" };
+  std::array<std::size_t, 6> counts {};
+
+  for ( double frameTime : gFrameTimes.mSamples )
+    ++counts[std::upper_bound( std::begin( bounds ), std::end( bounds ), frameTime ) - std::begin( bounds )];
+
+  const std::ios_base::fmtflags flags = aStream.flags();
+  aStream << std::fixed << std::setprecision( 3 );
+
+  aStream << "Frame times, last " << gFrameTimes.mSamples.size() << " frames:" << std::endl;
+  for ( std::size_t bucket = 0; bucket < counts.size(); ++bucket )
+  {
+    const std::size_t bar = gFrameTimes.mSamples.empty() ? 0 : counts[bucket] * 50 / gFrameTimes.mSamples.size();
+    aStream << labels[bucket] << " " << std::setw( 5 ) << counts[bucket] << " " << std::string( bar, '#' ) << std::endl;
+  }
+
+  aStream << "Zones (ms):          p50        p95        p99   samples" << std::endl;
+  for ( const ZoneStats& zone : getZoneStats() )
+  {
+    aStream << std::left << std::setw( 16 ) << zone.mName << std::right
+      << std::setw( 11 ) << zone.mP50 << std::setw( 11 ) << zone.mP95 << std::setw( 11 ) << zone.mP99
+      << std::setw( 10 ) << zone.mCount << std::endl;
+  }
+
+  aStream.flags( flags );
+}
+
+
+bool
+Profiler::exportChromeTrace( const std::string& aPath )
+{
+  std::ofstream writer( aPath );
+  if ( !writer.is_open() )
+    return false;
+
+  writer << "{\"traceEvents\":[";
+  bool first = true;
+
+  std::lock_guard<std::mutex> lock( gBuffersMutex );
+  for ( auto& buffer : gBuffers )
+  {
+    std::vector<EventCopy> events;
+    copyEvents( *buffer, 0, events );
+
+    if ( const char* name = buffer->mName.load( std::memory_order_relaxed ) )
+    {
+      writer << ( first ? "\n" : ",\n" ) << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":" << buffer->mId << ",\"args\":{\"name\":";
+      writeEscaped( writer, name );
+      writer << "}}";
+      first = false;
+    }
+
+    // Timestamps and durations are in microseconds.
+    for ( const EventCopy& event : events )
+    {
+      writer << ( first ? "\n" : ",\n" ) << "{\"ph\":\"X\",\"name\":";
+      writeEscaped( writer, event.mName );
+      writer << ",\"pid\":0,\"tid\":" << buffer->mId
+        << ",\"ts\":" << event.mStart / 1000 << "." << std::setw( 3 ) << std::setfill( '0' ) << event.mStart % 1000
+        << ",\"dur\":" << event.mDuration / 1000 << "." << std::setw( 3 ) << std::setfill( '0' ) << event.mDuration % 1000 << "}";
+      first = false;
+    }
+  }
+
+  writer << "\n]}\n";
+  return !writer.fail();
+}
+
+
+Profiler::Zone::Zone( const char* aName )
+  : mName ( isEnabled() ? aName : nullptr )
+{
+  if ( mName != nullptr )
+    mStart = now();
+}
+
+
+Profiler::Zone::~Zone()
+{
+  if ( mName == nullptr )
+    return;
+
+  const std::int64_t end = now();
+
+  ThreadBuffer& buffer = threadBuffer();
+  const std::uint64_t index = buffer.mWriteIndex.load( std::memory_order_relaxed );
+  Event& event = buffer.mEvents[index % RING_SIZE];
+  event.mName.store( mName, std::memory_order_relaxed );
+  event.mStart.store( mStart, std::memory_order_relaxed );
+  event.mDuration.store( end - mStart, std::memory_order_relaxed );
+  buffer.mWriteIndex.store( index + 1, std::memory_order_release );
+}
@@ -0,0 +1,90 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Frame profiler. PROFILE_ZONE( "name" ) times the rest of the enclosing
+// scope into a ring buffer owned by the calling thread: recording takes no
+// lock, and costs a single relaxed load while the profiler is disabled.
+// Building without RPG_PROFILER removes the zones entirely.
+//
+// Zone names must be string literals, or otherwise outlive the last export.
+// Everything but the zones themselves is called from the main thread.
+namespace Profiler
+{
+  struct ZoneStats
+  {
+    std::string   mName;
+    std::uint64_t mCount { 0 }; // Samples in the rolling window.
+    double        mP50 { 0.0 }; // Milliseconds.
+    double        mP95 { 0.0 };
+    double        mP99 { 0.0 };
+  };
+
+  void setEnabled( bool aEnabled );
+  bool isEnabled();
+
+  // Name of the calling thread in exported traces.
+  void setThreadName( const char* aName );
+
+  // Closes a frame: its duration goes into the rolling frame-time
+  // histogram, and the zones recorded since the last call into the
+  // rolling per-zone statistics.
+  void endFrame();
+
+  std::vector<ZoneStats> getZoneStats();
+
+  // Frame-time histogram and per-zone percentiles, as text.
+  void writeReport( std::ostream& aStream );
+
+  // Writes the zones still held in the ring buffers in the Chrome trace
+  // event format, for chrome://tracing or Perfetto.
+  bool exportChromeTrace( const std::string& aPath );
+
+  class Zone
+  {
+  public:
+    explicit Zone( const char* aName );
+    ~Zone();
+
+    Zone( const Zone& ) = delete;
+    Zone& operator=( const Zone& ) = delete;
+
+  private:
+    const char*  mName; // Null when the profiler was disabled on entry.
+    std::int64_t mStart { 0 };
+  };
+}
+
+#ifdef RPG_PROFILER
+#define PROFILE_CONCATENATE_( aLeft, aRight ) aLeft##aRight
+#define PROFILE_CONCATENATE( aLeft, aRight ) PROFILE_CONCATENATE_( aLeft, aRight )
+#define PROFILE_ZONE( aName ) Profiler::Zone PROFILE_CONCATENATE( profileZone, __LINE__ )( aName )
+#else
+#define PROFILE_ZONE( aName ) do {} while ( false )
+#endif
@@ -0,0 +1,128 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "Scheduler.hpp"
+
+#include <algorithm>
+
+#include "Profiler.hpp"
+
+Scheduler::Scheduler( JobSystem& aJobSystem )
+  : mJobSystem ( aJobSystem )
+{
+}
+
+
+void
+Scheduler::update( entt::registry& aRegistry, float aDt )
+{
+  PROFILE_ZONE( "scheduler" );
+
+  if ( mPhases.empty() )
+  {
+    buildPhases();
+    mPreparedRegistry = nullptr;
+  }
+
+  if ( mPreparedRegistry != &aRegistry )
+  {
+    for ( auto& system : mSystems )
+      system.mPrepare( aRegistry );
+    mPreparedRegistry = &aRegistry;
+  }
+
+  for ( const auto& phase : mPhases )
+  {
+    if ( phase.size() == 1 )
+    {
+      System& system = mSystems[phase.front()];
+      PROFILE_ZONE( system.mName );
+      system.mUpdate( aRegistry, aDt, mJobSystem );
+      continue;
+    }
+
+    JobSystem::Counter counter;
+    for ( std::size_t index : phase )
+    {
+      System& system = mSystems[index];
+      mJobSystem.run( [&system, &aRegistry, aDt, this]()
+      {
+        PROFILE_ZONE( system.mName );
+        system.mUpdate( aRegistry, aDt, mJobSystem );
+      }, counter );
+    }
+    mJobSystem.wait( counter );
+  }
+}
+
+
+bool
+Scheduler::conflicts( const System& aLeft, const System& aRight )
+{
+  auto touches = []( const std::vector<std::type_index>& aTypes, std::type_index aType )
+  {
+    return std::find( aTypes.begin(), aTypes.end(), aType ) != aTypes.end();
+  };
+
+  for ( const auto& type : aLeft.mWrites )
+  {
+    if ( touches( aRight.mReads, type ) || touches( aRight.mWrites, type ) )
+      return true;
+  }
+
+  for ( const auto& type : aRight.mWrites )
+  {
+    if ( touches( aLeft.mReads, type ) )
+      return true;
+  }
+
+  return false;
+}
+
+
+void
+Scheduler::buildPhases()
+{
+  // A system goes in the phase after the last one holding a system it
+  // conflicts with, so conflicting systems keep the order they were added in.
+  for ( std::size_t index = 0; index < mSystems.size(); ++index )
+  {
+    std::size_t phase = 0;
+    for ( std::size_t previous = 0; previous < index; ++previous )
+    {
+      if ( !conflicts( mSystems[previous], mSystems[index] ) )
+        continue;
+
+      for ( std::size_t candidate = 0; candidate < mPhases.size(); ++candidate )
+      {
+        const auto& systems = mPhases[candidate];
+        if ( std::find( systems.begin(), systems.end(), previous ) != systems.end() )
+          phase = std::max( phase, candidate + 1 );
+      }
+    }
+
+    if ( phase == mPhases.size() )
+      mPhases.emplace_back();
+    mPhases[phase].push_back( index );
+  }
+}
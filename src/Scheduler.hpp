@@ -0,0 +1,98 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <functional>
+#include <typeindex>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+#include "JobSystem.hpp"
+
+// Runs the update phase of the systems on a JobSystem. Every system declares
+// the component types it reads and writes; systems are grouped in phases of
+// mutually compatible systems (no system writes what another one of the
+// phase reads or writes), phases run in the order systems were added, and
+// the systems of a phase run at the same time.
+//
+// Systems must not create or destroy entities or components: the registry
+// is only safe for concurrent access to existing pools.
+class Scheduler
+{
+public:
+  template<typename... Components>
+  struct Reads {};
+
+  template<typename... Components>
+  struct Writes {};
+
+  typedef std::function<void( entt::registry&, float, JobSystem& )> Update;
+
+  explicit Scheduler( JobSystem& aJobSystem );
+
+  // aName is also the system's profiler zone, which keeps the pointer: pass
+  // a string literal.
+  template<typename... Read, typename... Write>
+  void addSystem( const char* aName, Reads<Read...>, Writes<Write...>, Update aUpdate )
+  {
+    System system;
+    system.mName    = aName;
+    system.mReads   = { std::type_index( typeid( Read ) )... };
+    system.mWrites  = { std::type_index( typeid( Write ) )... };
+    system.mUpdate  = std::move( aUpdate );
+    // Pools are created up front, never concurrently.
+    system.mPrepare = []( entt::registry& aRegistry ) 
+    { 
+      if constexpr ( sizeof...( Read ) + sizeof...( Write ) > 0 )
+        aRegistry.reserve<Read..., Write...>( 0 );
+    };
+
+    mSystems.push_back( std::move( system ) );
+    mPhases.clear();
+  }
+
+  void update( entt::registry& aRegistry, float aDt );
+
+  // Indices of the systems of each phase, as last built by update().
+  const std::vector<std::vector<std::size_t>>& getPhases() const { return mPhases; }
+
+private:
+  struct System
+  {
+    const char*                            mName;
+    std::vector<std::type_index>           mReads;
+    std::vector<std::type_index>           mWrites;
+    Update                                 mUpdate;
+    std::function<void( entt::registry& )> mPrepare;
+  };
+
+  static bool conflicts( const System& aLeft, const System& aRight );
+  void buildPhases();
+
+  JobSystem&                            mJobSystem;
+  std::vector<System>                   mSystems;
+  std::vector<std::vector<std::size_t>> mPhases;
+  const entt::registry*                 mPreparedRegistry { nullptr };
+};
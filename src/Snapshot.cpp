@@ -0,0 +1,747 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "Snapshot.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+#include "AnimationLibrary.hpp"
+#include "AssetLoader.hpp"
+#include "BulkSpawn.hpp"
+#include "Components.hpp"
+#include "Hash.hpp"
+#include "MemoryTracker.hpp"
+#include "Profiler.hpp"
+
+namespace
+{
+  // Section types. New ones go last: the numbers are in the files.
+  enum Section : std::uint32_t
+  {
+    SECTION_ENTITIES,
+    SECTION_TEXTURES,
+    SECTION_POSITION_WORLD,
+    SECTION_POSITION_WORLD_PREVIOUS,
+    SECTION_SPRITE,
+    SECTION_LAYER_BACKGROUND,
+    SECTION_TILE_CHUNK,
+    SECTION_SPRITE_ANIMATED,
+    SECTION_WORLD_MOVEMENT,
+    SECTION_PATH,
+    SECTION_MAIN_CHARACTER,
+    SECTION_CHARACTER_ANIMATION,
+    SECTION_MAP,
+    SECTION_WORLD
+  };
+
+  // The asset a texture handle of the snapshot was bound to.
+  struct TextureBinding
+  {
+    TextureHandle mHandle;
+    std::uint8_t  mAsset;
+    std::uint8_t  mAtlas;
+  };
+
+  struct DeltaHeader
+  {
+    char          mMagic[4];
+    std::uint16_t mVersion;
+    std::uint16_t mReserved;
+    std::uint32_t mBlockSize;
+    std::uint32_t mBlockCount;
+    std::uint64_t mBaseBytes;
+    std::uint64_t mBaseHash;
+    std::uint64_t mBytes;
+  };
+
+  const std::uint32_t DELTA_BLOCK_SIZE = 4096;
+
+  std::uint64_t hashBuffer( const Snapshot::Buffer& aBuffer )
+  {
+    Hash hash;
+    hash.add( aBuffer.data(), aBuffer.size() );
+    return hash.get();
+  }
+
+  static_assert( sizeof( entt::entity ) == sizeof( std::uint32_t ), "Entity identifiers are stored on 4 bytes." );
+  static_assert( std::is_trivially_copyable<sf::Vertex>::value, "Tile chunk vertices are copied as bytes." );
+
+  class Writer
+  {
+  public:
+    explicit Writer( Snapshot::Buffer& aBuffer ) : mBuffer( aBuffer ) {}
+
+    void begin( Section aType, std::size_t aCount )
+    {
+      mSectionStart = mBuffer.size();
+      Snapshot::SectionHeader header {};
+      header.mType  = aType;
+      header.mCount = static_cast<std::uint32_t>( aCount );
+      write( &header, sizeof( header ) );
+      ++mSectionCount;
+    }
+
+    void write( const void* aData, std::size_t aBytes )
+    {
+      if ( aBytes == 0 )
+        return;
+      const std::size_t offset = mBuffer.size();
+      mBuffer.resize( offset + aBytes );
+      std::memcpy( mBuffer.data() + offset, aData, aBytes );
+    }
+
+    void end()
+    {
+      mBuffer.resize( ( mBuffer.size() + 7 ) / 8 * 8, 0 );
+      const std::uint64_t bytes = mBuffer.size() - mSectionStart - sizeof( Snapshot::SectionHeader );
+      std::memcpy( mBuffer.data() + mSectionStart + offsetof( Snapshot::SectionHeader, mBytes ), &bytes, sizeof( bytes ) );
+    }
+
+    std::size_t getSectionCount() const { return mSectionCount; }
+
+  private:
+    Snapshot::Buffer& mBuffer;
+    std::size_t       mSectionStart { 0 };
+    std::size_t       mSectionCount { 0 };
+  };
+
+  // Bounds checked reads within one section.
+  class Reader
+  {
+  public:
+    Reader( const char* aData, std::size_t aBytes ) : mData( aData ), mBytes( aBytes ) {}
+
+    const char* take( std::size_t aBytes )
+    {
+      if ( aBytes > mBytes - mOffset )
+        return nullptr;
+      const char* data = mData + mOffset;
+      mOffset += aBytes;
+      return data;
+    }
+
+    bool read( void* aOut, std::size_t aBytes )
+    {
+      const char* data = take( aBytes );
+      if ( data != nullptr && aBytes > 0 )
+        std::memcpy( aOut, data, aBytes );
+      return data != nullptr;
+    }
+
+  private:
+    const char* mData;
+    std::size_t mBytes;
+    std::size_t mOffset { 0 };
+  };
+
+  // Restore side: new entities by saved entity index, new texture handles
+  // by saved handle.
+  struct Restore
+  {
+    entt::registry&            mRegistry;
+    std::vector<entt::entity>  mEntities;
+    std::vector<TextureHandle> mTextures;
+    std::vector<entt::entity>  mOwners; // Of the section being read.
+
+    TextureHandle rebind( TextureHandle aHandle ) const
+    {
+      return aHandle < mTextures.size() ? mTextures[aHandle] : NO_TEXTURE;
+    }
+  };
+
+  template<typename Component>
+  void writeOwners( Writer& aWriter, Section aType, const entt::basic_view<Component>& aView )
+  {
+    aWriter.begin( aType, aView.size() );
+    aWriter.write( aView.data(), aView.size() * sizeof( entt::entity ) );
+  }
+
+  // Plain data: the owners, then the pool's components as they are.
+  template<typename Component>
+  void savePool( entt::registry& aRegistry, Section aType, Writer& aWriter )
+  {
+    static_assert( std::is_trivially_copyable<Component>::value, "Only plain data is copied as bytes." );
+
+    auto view = aRegistry.view<Component>();
+    writeOwners( aWriter, aType, view );
+    if constexpr ( !std::is_empty<Component>::value )
+      aWriter.write( view.raw(), view.size() * sizeof( Component ) );
+    aWriter.end();
+  }
+
+  void saveTileChunks( entt::registry& aRegistry, Writer& aWriter )
+  {
+    auto view = aRegistry.view<ComponentTileChunk>();
+    const ComponentTileChunk* chunks = view.raw();
+    writeOwners( aWriter, SECTION_TILE_CHUNK, view );
+
+    for ( std::size_t i = 0; i < view.size(); ++i )
+      aWriter.write( &chunks[i].mTexture, sizeof( TextureHandle ) );
+    for ( std::size_t i = 0; i < view.size(); ++i )
+    {
+      const std::uint32_t layout[2] = { static_cast<std::uint32_t>( chunks[i].mVertices.getPrimitiveType() ), static_cast<std::uint32_t>( chunks[i].mVertices.getVertexCount() ) };
+      aWriter.write( layout, sizeof( layout ) );
+    }
+    for ( std::size_t i = 0; i < view.size(); ++i )
+    {
+      if ( chunks[i].mVertices.getVertexCount() > 0 )
+        aWriter.write( &chunks[i].mVertices[0], chunks[i].mVertices.getVertexCount() * sizeof( sf::Vertex ) );
+    }
+    aWriter.end();
+  }
+
+  void savePaths( entt::registry& aRegistry, Writer& aWriter )
+  {
+    auto view = aRegistry.view<ComponentPath>();
+    const ComponentPath* paths = view.raw();
+    writeOwners( aWriter, SECTION_PATH, view );
+
+    for ( std::size_t i = 0; i < view.size(); ++i )
+    {
+      const std::uint32_t layout[2] = { static_cast<std::uint32_t>( paths[i].mNext ), static_cast<std::uint32_t>( paths[i].mWaypoints.size() ) };
+      aWriter.write( layout, sizeof( layout ) );
+      aWriter.write( &paths[i].mSpeed, sizeof( float ) );
+    }
+    for ( std::size_t i = 0; i < view.size(); ++i )
+      aWriter.write( paths[i].mWaypoints.data(), paths[i].mWaypoints.size() * sizeof( sf::Vector2i ) );
+    aWriter.end();
+  }
+
+  // Textures of the sprites and chunks, bound to the asset they come from.
+  void saveTextures( entt::registry& aRegistry, const AssetLoader& aAssets, Writer& aWriter )
+  {
+    std::vector<bool> used;
+    auto use = [&used]( TextureHandle aHandle )
+    {
+      if ( aHandle >= used.size() )
+        used.resize( aHandle + 1, false );
+      used[aHandle] = true;
+    };
+
+    auto sprites = aRegistry.view<ComponentSprite>();
+    for ( std::size_t i = 0; i < sprites.size(); ++i )
+      use( sprites.raw()[i].mTexture );
+    auto chunks = aRegistry.view<ComponentTileChunk>();
+    for ( std::size_t i = 0; i < chunks.size(); ++i )
+      use( chunks.raw()[i].mTexture );
+
+    std::vector<TextureBinding> bindings;
+    for ( std::size_t handle = 1; handle < used.size(); ++handle )
+    {
+      AssetLoader::Asset asset;
+      bool atlas = false;
+      if ( used[handle] && aAssets.FindTextureAsset( static_cast<TextureHandle>( handle ), asset, atlas ) )
+        bindings.push_back( { static_cast<TextureHandle>( handle ), static_cast<std::uint8_t>( asset ), static_cast<std::uint8_t>( atlas ? 1 : 0 ) } );
+    }
+
+    aWriter.begin( SECTION_TEXTURES, bindings.size() );
+    aWriter.write( bindings.data(), bindings.size() * sizeof( TextureBinding ) );
+    aWriter.end();
+  }
+
+  // The size, then the tiles row by row.
+  void saveMap( const TileGridView& aMap, Writer& aWriter )
+  {
+    const sf::Vector2i size = aMap.getSize();
+    const std::int32_t layout[2] = { size.x, size.y };
+    aWriter.begin( SECTION_MAP, 1 );
+    aWriter.write( layout, sizeof( layout ) );
+    for ( int y = 0; y < size.y; ++y )
+      aWriter.write( aMap.row( y ), static_cast<std::size_t>( size.x ) * sizeof( TileId ) );
+    aWriter.end();
+  }
+
+  bool restoreEntities( Reader& aReader, std::size_t aCount, Restore& aRestore )
+  {
+    const char* ids = aReader.take( aCount * sizeof( entt::entity ) );
+    if ( ids == nullptr )
+      return false;
+
+    std::vector<entt::entity> created;
+    BulkSpawn::reserve<>( aRestore.mRegistry, aCount );
+    BulkSpawn::create( aRestore.mRegistry, aCount, created );
+
+    for ( std::size_t i = 0; i < aCount; ++i )
+    {
+      entt::entity saved;
+      std::memcpy( &saved, ids + i * sizeof( entt::entity ), sizeof( saved ) );
+      const std::size_t index = static_cast<std::size_t>( entt::registry::entity( saved ) );
+      if ( index >= aRestore.mEntities.size() )
+        aRestore.mEntities.resize( index + 1, entt::null );
+      aRestore.mEntities[index] = created[i];
+    }
+    return true;
+  }
+
+  bool restoreTextures( Reader& aReader, std::size_t aCount, Restore& aRestore, AssetLoader& aAssets )
+  {
+    std::vector<TextureBinding> bindings( aCount );
+    if ( !aReader.read( bindings.data(), aCount * sizeof( TextureBinding ) ) )
+      return false;
+
+    for ( const TextureBinding& binding : bindings )
+    {
+      if ( binding.mAsset >= AssetLoader::ASSET_COUNT )
+        return false;
+
+      const AssetLoader::Asset asset = static_cast<AssetLoader::Asset>( binding.mAsset );
+      if ( binding.mHandle >= aRestore.mTextures.size() )
+        aRestore.mTextures.resize( binding.mHandle + 1, NO_TEXTURE );
+      aRestore.mTextures[binding.mHandle] = binding.mAtlas ? aAssets.GetAtlas( asset )->getTextureHandle() : aAssets.GetTextureHandle( asset );
+    }
+    return true;
+  }
+
+  // Fills aRestore.mOwners with the new entities of the section's owners.
+  bool restoreOwners( Reader& aReader, std::size_t aCount, Restore& aRestore )
+  {
+    aRestore.mOwners.resize( aCount );
+    if ( !aReader.read( aRestore.mOwners.data(), aCount * sizeof( entt::entity ) ) )
+      return false;
+
+    for ( entt::entity& owner : aRestore.mOwners )
+    {
+      const std::size_t index = static_cast<std::size_t>( entt::registry::entity( owner ) );
+      if ( index >= aRestore.mEntities.size() || aRestore.mEntities[index] == entt::null )
+        return false;
+      owner = aRestore.mEntities[index];
+    }
+    return true;
+  }
+
+  // Plain data: assigned to the owners in one range, then copied over in
+  // one go. aComponents receives the new components, for fix-ups.
+  template<typename Component>
+  bool restorePool( Reader& aReader, std::size_t aCount, Restore& aRestore, Component** aComponents = nullptr )
+  {
+    if ( !restoreOwners( aReader, aCount, aRestore ) )
+      return false;
+
+    const entt::entity* first = aRestore.mOwners.data();
+    BulkSpawn::reserve<Component>( aRestore.mRegistry, aCount );
+    if constexpr ( std::is_empty<Component>::value )
+    {
+      BulkSpawn::assign<Component>( aRestore.mRegistry, first, first + aCount );
+      return true;
+    }
+    else
+    {
+      const char* data = aReader.take( aCount * sizeof( Component ) );
+      if ( data == nullptr )
+        return false;
+
+      Component* components = BulkSpawn::assign<Component>( aRestore.mRegistry, first, first + aCount );
+      if ( aCount > 0 )
+        std::memcpy( static_cast<void*>( components ), data, aCount * sizeof( Component ) );
+      if ( aComponents != nullptr )
+        *aComponents = components;
+      return true;
+    }
+  }
+
+  bool restoreTileChunks( Reader& aReader, std::size_t aCount, Restore& aRestore )
+  {
+    if ( !restoreOwners( aReader, aCount, aRestore ) )
+      return false;
+
+    std::vector<TextureHandle> textures( aCount );
+    std::vector<std::uint32_t> layouts( aCount * 2 );
+    if ( !aReader.read( textures.data(), aCount * sizeof( TextureHandle ) ) || !aReader.read( layouts.data(), layouts.size() * sizeof( std::uint32_t ) ) )
+      return false;
+
+    const entt::entity* first = aRestore.mOwners.data();
+    BulkSpawn::reserve<ComponentTileChunk>( aRestore.mRegistry, aCount );
+    ComponentTileChunk* chunks = BulkSpawn::assign<ComponentTileChunk>( aRestore.mRegistry, first, first + aCount );
+
+    for ( std::size_t i = 0; i < aCount; ++i )
+    {
+      const std::size_t vertexCount = layouts[i * 2 + 1];
+      const char* vertices = aReader.take( vertexCount * sizeof( sf::Vertex ) );
+      if ( vertices == nullptr || layouts[i * 2] > sf::Quads )
+        return false;
+
+      chunks[i].mTexture = aRestore.rebind( textures[i] );
+      chunks[i].mVertices.setPrimitiveType( static_cast<sf::PrimitiveType>( layouts[i * 2] ) );
+      chunks[i].mVertices.resize( vertexCount );
+      if ( vertexCount > 0 )
+        std::memcpy( static_cast<void*>( &chunks[i].mVertices[0] ), vertices, vertexCount * sizeof( sf::Vertex ) );
+    }
+    return true;
+  }
+
+  bool restorePaths( Reader& aReader, std::size_t aCount, Restore& aRestore )
+  {
+    if ( !restoreOwners( aReader, aCount, aRestore ) )
+      return false;
+
+    struct Layout
+    {
+      std::uint32_t mNext;
+      std::uint32_t mWaypointCount;
+      float         mSpeed;
+    };
+    std::vector<Layout> layouts( aCount );
+    if ( !aReader.read( layouts.data(), aCount * sizeof( Layout ) ) )
+      return false;
+
+    const entt::entity* first = aRestore.mOwners.data();
+    BulkSpawn::reserve<ComponentPath>( aRestore.mRegistry, aCount );
+    ComponentPath* paths = BulkSpawn::assign<ComponentPath>( aRestore.mRegistry, first, first + aCount );
+
+    for ( std::size_t i = 0; i < aCount; ++i )
+    {
+      paths[i].mNext  = layouts[i].mNext;
+      paths[i].mSpeed = layouts[i].mSpeed;
+      paths[i].mWaypoints.resize( layouts[i].mWaypointCount );
+      if ( !aReader.read( paths[i].mWaypoints.data(), paths[i].mWaypoints.size() * sizeof( sf::Vector2i ) ) )
+        return false;
+    }
+    return true;
+  }
+
+  bool restoreMap( Reader& aReader, std::size_t aCount, TileGrid& aMap )
+  {
+    std::int32_t layout[2];
+    if ( aCount != 1 || !aReader.read( layout, sizeof( layout ) ) || layout[0] <= 0 || layout[1] <= 0 )
+      return false;
+
+    const std::size_t tileCount = static_cast<std::size_t>( layout[0] ) * static_cast<std::size_t>( layout[1] );
+    const char* tiles = aReader.take( tileCount * sizeof( TileId ) );
+    if ( tiles == nullptr )
+      return false;
+
+    aMap.resize( sf::Vector2i( layout[0], layout[1] ) );
+    std::memcpy( aMap.data(), tiles, tileCount * sizeof( TileId ) );
+    return std::all_of( aMap.data(), aMap.data() + tileCount, []( TileId aTileId ) { return isInTileset( aTileId ); } );
+  }
+
+  // The components' indices into what lies outside of the registry, which a
+  // damaged or foreign snapshot could point past. aMapSize is 0 when there
+  // is no map to check the paths against.
+  bool checkReferences( entt::registry& aRegistry, const Snapshot::World& aWorld, sf::Vector2i aMapSize )
+  {
+    if ( aWorld.mAnimations != nullptr )
+    {
+      const std::size_t clipCount = aWorld.mAnimations->getClipCount();
+
+      auto animations = aRegistry.view<ComponentSpriteAnimated>();
+      for ( auto entity : animations )
+      {
+        const ComponentSpriteAnimated& animation = animations.get( entity );
+        if ( animation.mClip >= clipCount )
+          return false;
+
+        const AnimationClip& clip = aWorld.mAnimations->getClip( animation.mClip );
+        if ( animation.mCurrentSequenceElementIndex < 0 || animation.mCurrentSequenceElementIndex >= static_cast<int>( clip.mFrameCount )
+          || !( animation.mTimeInCurrentLoop >= 0.0f && animation.mTimeInCurrentLoop <= clip.mDuration ) )
+          return false;
+      }
+
+      auto characters = aRegistry.view<ComponentCharacterAnimation>();
+      for ( auto entity : characters )
+      {
+        const ComponentCharacterAnimation& character = characters.get( entity );
+        const int direction = static_cast<int>( character.mDirection );
+        if ( direction < 0 || direction >= ComponentCharacterAnimation::NUM_DIRECTIONS
+          || std::any_of( character.mMoveAnimations.begin(), character.mMoveAnimations.end(), [clipCount]( AnimationClipId aClip ) { return aClip >= clipCount; } ) )
+          return false;
+      }
+    }
+
+    auto paths = aRegistry.view<ComponentPath>();
+    for ( auto entity : paths )
+    {
+      const ComponentPath& path = paths.get( entity );
+      if ( path.mNext > path.mWaypoints.size() || !std::isfinite( path.mSpeed ) )
+        return false;
+
+      const bool inMap = aMapSize.x <= 0 || std::all_of( path.mWaypoints.begin(), path.mWaypoints.end(), [aMapSize]( sf::Vector2i aTile )
+      {
+        return aTile.x >= 0 && aTile.y >= 0 && aTile.x < aMapSize.x && aTile.y < aMapSize.y;
+      } );
+      if ( !inMap )
+        return false;
+    }
+
+    auto movements = aRegistry.view<ComponentWorldMovement>();
+    for ( auto entity : movements )
+    {
+      const ComponentWorldMovement& movement = movements.get( entity );
+      for ( float value : { movement.mOrigin.x, movement.mOrigin.y, movement.mDestination.x, movement.mDestination.y, movement.mSpeed, movement.mRatio } )
+      {
+        if ( !std::isfinite( value ) )
+          return false;
+      }
+    }
+
+    return true;
+  }
+}
+
+
+void
+Snapshot::save( entt::registry& aRegistry, const AssetLoader& aAssets, Buffer& aSnapshot, const World& aWorld )
+{
+  PROFILE_ZONE( "save snapshot" );
+  MEMORY_TAG( TAG_SNAPSHOT );
+
+  aSnapshot.clear();
+  aSnapshot.resize( sizeof( Header ) );
+  Writer writer( aSnapshot );
+
+  writer.begin( SECTION_WORLD, 1 );
+  writer.write( &aWorld.mBackgroundMode, sizeof( aWorld.mBackgroundMode ) );
+  writer.end();
+
+  std::vector<entt::entity> entities;
+  entities.reserve( aRegistry.alive() );
+  aRegistry.each( [&entities]( entt::entity aEntity ) { entities.push_back( aEntity ); } );
+  writer.begin( SECTION_ENTITIES, entities.size() );
+  writer.write( entities.data(), entities.size() * sizeof( entt::entity ) );
+  writer.end();
+
+  saveTextures( aRegistry, aAssets, writer );
+
+  savePool<ComponentPositionWorld>( aRegistry, SECTION_POSITION_WORLD, writer );
+  savePool<ComponentPositionWorldPrevious>( aRegistry, SECTION_POSITION_WORLD_PREVIOUS, writer );
+  savePool<ComponentSprite>( aRegistry, SECTION_SPRITE, writer );
+  savePool<ComponentLayerBackground>( aRegistry, SECTION_LAYER_BACKGROUND, writer );
+  saveTileChunks( aRegistry, writer );
+  savePool<ComponentSpriteAnimated>( aRegistry, SECTION_SPRITE_ANIMATED, writer );
+  savePool<ComponentWorldMovement>( aRegistry, SECTION_WORLD_MOVEMENT, writer );
+  savePaths( aRegistry, writer );
+  savePool<ComponentMainCharacter>( aRegistry, SECTION_MAIN_CHARACTER, writer );
+  savePool<ComponentCharacterAnimation>( aRegistry, SECTION_CHARACTER_ANIMATION, writer );
+  if ( aWorld.mMap != nullptr )
+    saveMap( *aWorld.mMap, writer );
+
+  Header header {};
+  std::memcpy( header.mMagic, MAGIC, sizeof( MAGIC ) );
+  header.mVersion      = VERSION;
+  header.mSectionCount = static_cast<std::uint16_t>( writer.getSectionCount() );
+  header.mBytes        = aSnapshot.size();
+  std::memcpy( aSnapshot.data(), &header, sizeof( header ) );
+}
+
+
+bool
+Snapshot::restore( const Buffer& aSnapshot, entt::registry& aRegistry, AssetLoader& aAssets, const World& aWorld, TileGrid* aMap )
+{
+  PROFILE_ZONE( "restore snapshot" );
+  MEMORY_TAG( TAG_ECS );
+
+  assert( aRegistry.alive() == 0 );
+
+  Header header;
+  if ( aSnapshot.size() < sizeof( header ) )
+    return false;
+  std::memcpy( &header, aSnapshot.data(), sizeof( header ) );
+  if ( std::memcmp( header.mMagic, MAGIC, sizeof( MAGIC ) ) != 0 || header.mVersion != VERSION || header.mBytes != aSnapshot.size() )
+    return false;
+
+  Restore restore { aRegistry, {}, {}, {} };
+  TileGrid map;
+  bool worldRead = false;
+  bool entitiesRead = false;
+
+  Reader sections( aSnapshot.data() + sizeof( header ), aSnapshot.size() - sizeof( header ) );
+  for ( std::uint16_t i = 0; i < header.mSectionCount; ++i )
+  {
+    SectionHeader section;
+    const char* payload = nullptr;
+    if ( !sections.read( &section, sizeof( section ) ) || ( payload = sections.take( section.mBytes ) ) == nullptr )
+      return false;
+
+    // The entities come first, after the world: every other section refers to them.
+    if ( !entitiesRead && section.mType != SECTION_ENTITIES && section.mType != SECTION_WORLD )
+      return false;
+
+    Reader reader( payload, section.mBytes );
+    bool read = true;
+    switch ( section.mType )
+    {
+    case SECTION_WORLD:
+    {
+      std::uint32_t backgroundMode = 0;
+      read = !worldRead && section.mCount == 1 && reader.read( &backgroundMode, sizeof( backgroundMode ) ) && backgroundMode == aWorld.mBackgroundMode;
+      worldRead = true;
+      break;
+    }
+    case SECTION_ENTITIES:
+      read = !entitiesRead && restoreEntities( reader, section.mCount, restore );
+      entitiesRead = true;
+      break;
+    case SECTION_TEXTURES:                read = restoreTextures( reader, section.mCount, restore, aAssets ); break;
+    case SECTION_POSITION_WORLD:          read = restorePool<ComponentPositionWorld>( reader, section.mCount, restore ); break;
+    case SECTION_POSITION_WORLD_PREVIOUS: read = restorePool<ComponentPositionWorldPrevious>( reader, section.mCount, restore ); break;
+    case SECTION_LAYER_BACKGROUND:        read = restorePool<ComponentLayerBackground>( reader, section.mCount, restore ); break;
+    case SECTION_TILE_CHUNK:              read = restoreTileChunks( reader, section.mCount, restore ); break;
+    case SECTION_SPRITE_ANIMATED:         read = restorePool<ComponentSpriteAnimated>( reader, section.mCount, restore ); break;
+    case SECTION_WORLD_MOVEMENT:          read = restorePool<ComponentWorldMovement>( reader, section.mCount, restore ); break;
+    case SECTION_PATH:                    read = restorePaths( reader, section.mCount, restore ); break;
+    case SECTION_MAIN_CHARACTER:          read = restorePool<ComponentMainCharacter>( reader, section.mCount, restore ); break;
+    case SECTION_CHARACTER_ANIMATION:     read = restorePool<ComponentCharacterAnimation>( reader, section.mCount, restore ); break;
+    case SECTION_MAP:                     read = restoreMap( reader, section.mCount, map ); break;
+    case SECTION_SPRITE:
+    {
+      // Texture handles are bound to this session's textures.
+      ComponentSprite* sprites = nullptr;
+      read = restorePool<ComponentSprite>( reader, section.mCount, restore, &sprites );
+      for ( std::size_t sprite = 0; read && sprite < section.mCount; ++sprite )
+        sprites[sprite].mTexture = restore.rebind( sprites[sprite].mTexture );
+      break;
+    }
+    default:
+      break; // From a later version: skipped.
+    }
+
+    if ( !read )
+      return false;
+  }
+
+  const sf::Vector2i mapSize = map.getSize().x > 0 ? map.getSize() : aWorld.mMap != nullptr ? aWorld.mMap->getSize() : sf::Vector2i();
+  if ( !worldRead || !entitiesRead || !checkReferences( aRegistry, aWorld, mapSize ) )
+    return false;
+
+  if ( aMap != nullptr )
+    *aMap = std::move( map );
+  return true;
+}
+
+
+void
+Snapshot::diff( const Buffer& aBase, const Buffer& aCurrent, Buffer& aDelta )
+{
+  PROFILE_ZONE( "diff snapshot" );
+  MEMORY_TAG( TAG_SNAPSHOT );
+
+  aDelta.resize( sizeof( DeltaHeader ) );
+
+  std::uint32_t blockCount = 0;
+  for ( std::size_t offset = 0; offset < aCurrent.size(); offset += DELTA_BLOCK_SIZE )
+  {
+    const std::size_t bytes = std::min<std::size_t>( DELTA_BLOCK_SIZE, aCurrent.size() - offset );
+    if ( offset + bytes <= aBase.size() && std::memcmp( aBase.data() + offset, aCurrent.data() + offset, bytes ) == 0 )
+      continue;
+
+    const std::uint32_t block = static_cast<std::uint32_t>( offset / DELTA_BLOCK_SIZE );
+    const std::size_t end = aDelta.size();
+    aDelta.resize( end + sizeof( block ) + bytes );
+    std::memcpy( aDelta.data() + end, &block, sizeof( block ) );
+    std::memcpy( aDelta.data() + end + sizeof( block ), aCurrent.data() + offset, bytes );
+    ++blockCount;
+  }
+
+  DeltaHeader header {};
+  std::memcpy( header.mMagic, DELTA_MAGIC, sizeof( DELTA_MAGIC ) );
+  header.mVersion    = DELTA_VERSION;
+  header.mBlockSize  = DELTA_BLOCK_SIZE;
+  header.mBlockCount = blockCount;
+  header.mBaseBytes  = aBase.size();
+  header.mBaseHash   = hashBuffer( aBase );
+  header.mBytes      = aCurrent.size();
+  std::memcpy( aDelta.data(), &header, sizeof( header ) );
+}
+
+
+bool
+Snapshot::patch( Buffer& aBase, const Buffer& aDelta )
+{
+  PROFILE_ZONE( "patch snapshot" );
+  MEMORY_TAG( TAG_SNAPSHOT );
+
+  DeltaHeader header;
+  if ( aDelta.size() < sizeof( header ) )
+    return false;
+  std::memcpy( &header, aDelta.data(), sizeof( header ) );
+  // Snapshots of a world are often the same size: only the hash tells a
+  // delta against an older base.
+  if ( std::memcmp( header.mMagic, DELTA_MAGIC, sizeof( DELTA_MAGIC ) ) != 0 || header.mVersion != DELTA_VERSION
+    || header.mBaseBytes != aBase.size() || header.mBlockSize == 0 || header.mBaseHash != hashBuffer( aBase ) )
+    return false;
+
+  // Checked whole before aBase changes.
+  Reader blocks( aDelta.data() + sizeof( header ), aDelta.size() - sizeof( header ) );
+  std::vector<std::pair<std::size_t, const char*>> changes;
+  for ( std::uint32_t i = 0; i < header.mBlockCount; ++i )
+  {
+    std::uint32_t block = 0;
+    if ( !blocks.read( &block, sizeof( block ) ) )
+      return false;
+
+    const std::size_t offset = static_cast<std::size_t>( block ) * header.mBlockSize;
+    if ( offset >= header.mBytes )
+      return false;
+    const char* data = blocks.take( std::min<std::size_t>( header.mBlockSize, header.mBytes - offset ) );
+    if ( data == nullptr )
+      return false;
+    changes.emplace_back( offset, data );
+  }
+
+  aBase.resize( header.mBytes );
+  for ( const auto& change : changes )
+    std::memcpy( aBase.data() + change.first, change.second, std::min<std::size_t>( header.mBlockSize, header.mBytes - change.first ) );
+  return true;
+}
+
+
+bool
+Snapshot::readFile( const std::string& aPath, Buffer& aBuffer )
+{
+  std::ifstream reader( aPath, std::ios::binary | std::ios::ate );
+  if ( !reader.is_open() )
+    return false;
+
+  aBuffer.resize( static_cast<std::size_t>( reader.tellg() ) );
+  reader.seekg( 0 );
+  return static_cast<bool>( reader.read( aBuffer.data(), aBuffer.size() ) );
+}
+
+
+bool
+Snapshot::writeFile( const std::string& aPath, const Buffer& aBuffer )
+{
+  const std::string temporaryPath = aPath + ".tmp";
+  bool written = false;
+  {
+    std::ofstream writer( temporaryPath, std::ios::binary | std::ios::trunc );
+    written = writer.is_open() && writer.write( aBuffer.data(), aBuffer.size() ) && writer.flush();
+  }
+
+  std::error_code error;
+  if ( written )
+    std::filesystem::rename( temporaryPath, aPath, error );
+  if ( !written || error )
+  {
+    std::remove( temporaryPath.c_str() );
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,113 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+#include "TileGrid.hpp"
+
+class AnimationLibrary;
+class AssetLoader;
+
+// Binary snapshot of a registry, with every component of Components.hpp:
+//
+//   Header   (16 bytes, native byte order)
+//   Sections the world, the entities, the textures, then one per component
+//            type, and the map's tiles when given: a SectionHeader (16 bytes)
+//            and its payload, padded to 8 bytes.
+//
+// A component section holds the identifiers of the owners, then the
+// components. Plain data components are copied out of their pool and back
+// into it in one go; the others (tile chunks, paths) are stored as columns
+// of their fields. Texture handles only mean something within a session:
+// the snapshot names the asset behind each, and restore() binds them to
+// the same assets. Animation clip ids are kept as they are, for a library
+// built by the same calls (see SystemRenderer::restoreWorld()); restore()
+// checks them, and every other index, against the World it is given.
+namespace Snapshot
+{
+  const char          MAGIC[4]       = { 'R', 'P', 'G', 'S' };
+  const char          DELTA_MAGIC[4] = { 'R', 'P', 'G', 'D' };
+  const std::uint16_t VERSION        = 1;
+  const std::uint16_t DELTA_VERSION  = 2; // Deltas name their base by hash since 2.
+
+  struct Header
+  {
+    char          mMagic[4];
+    std::uint16_t mVersion;
+    std::uint16_t mSectionCount;
+    std::uint64_t mBytes; // Of the whole snapshot, header included.
+  };
+  static_assert( sizeof( Header ) == 16, "Snapshot::Header must stay 16 bytes, sections are aligned on it." );
+
+  struct SectionHeader
+  {
+    std::uint32_t mType;
+    std::uint32_t mCount; // Entities, textures or components.
+    std::uint64_t mBytes; // Of the payload, padding included.
+  };
+  static_assert( sizeof( SectionHeader ) == 16, "Snapshot::SectionHeader must stay 16 bytes." );
+
+  typedef std::vector<char> Buffer;
+
+  // What the components refer to outside of the registry.
+  struct World
+  {
+    std::uint32_t           mBackgroundMode { 0 };  // SystemRenderer::BackgroundMode, recorded and compared.
+    const AnimationLibrary* mAnimations { nullptr }; // Holds the clips the components play, when given.
+    const TileGridView*     mMap { nullptr };        // Saved with the snapshot when given; none for a streamed world.
+  };
+
+  // Replaces aSnapshot with a snapshot of aRegistry in aWorld. aWorld's map
+  // is saved as it is, edits included, which its asset no longer is.
+  void save( entt::registry& aRegistry, const AssetLoader& aAssets, Buffer& aSnapshot, const World& aWorld = World() );
+
+  // Into an empty aRegistry. The entities get new identifiers, in the same
+  // order. aMap, when given, receives the saved map's tiles, or is left
+  // empty for a snapshot without them; aWorld's map is the one the
+  // snapshot's paths lie in then. Returns false when aSnapshot is not a
+  // valid snapshot of aWorld (another background mode, clips or frames
+  // aWorld does not have, paths out of the map), in which case aRegistry
+  // may hold part of it.
+  bool restore( const Buffer& aSnapshot, entt::registry& aRegistry, AssetLoader& aAssets, const World& aWorld = World(), TileGrid* aMap = nullptr );
+
+  // Incremental saves: aDelta holds the blocks of aCurrent which differ
+  // from aBase, and patch() turns aBase into aCurrent again. A delta is only
+  // as small as the changes are local: spawning or destroying entities
+  // shifts every later component of their pools.
+  void diff( const Buffer& aBase, const Buffer& aCurrent, Buffer& aDelta );
+
+  // Returns false, leaving aBase alone, when aDelta was not made against it:
+  // its size and hash are checked.
+  bool patch( Buffer& aBase, const Buffer& aDelta );
+
+  bool readFile( const std::string& aPath, Buffer& aBuffer );
+
+  // Written aside then renamed: a crash leaves the previous file whole.
+  bool writeFile( const std::string& aPath, const Buffer& aBuffer );
+}
@@ -0,0 +1,96 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "SpatialGrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+SpatialGrid::SpatialGrid( float aCellSize )
+  : mCellSize ( aCellSize )
+{
+}
+
+
+void
+SpatialGrid::insert( entt::entity aEntity, const sf::FloatRect& aBounds )
+{
+  const float centerX = aBounds.left + aBounds.width / 2;
+  const float centerY = aBounds.top + aBounds.height / 2;
+
+  mMaxHalfExtent = std::max( mMaxHalfExtent, std::max( aBounds.width, aBounds.height ) / 2 );
+
+  mCells[cellKey( cellCoordinate( centerX ), cellCoordinate( centerY ) )].push_back( { aEntity, aBounds } );
+  ++mSize;
+}
+
+
+void
+SpatialGrid::clear()
+{
+  // Keep the cell vectors around; dynamic grids are refilled every frame.
+  for ( auto& cell : mCells )
+    cell.second.clear();
+
+  mSize = 0;
+}
+
+
+void
+SpatialGrid::query( const sf::FloatRect& aArea, std::vector<entt::entity>& aOut ) const
+{
+  const int left   = cellCoordinate( aArea.left - mMaxHalfExtent );
+  const int top    = cellCoordinate( aArea.top - mMaxHalfExtent );
+  const int right  = cellCoordinate( aArea.left + aArea.width + mMaxHalfExtent );
+  const int bottom = cellCoordinate( aArea.top + aArea.height + mMaxHalfExtent );
+
+  for ( int y = top; y <= bottom; ++y )
+  {
+    for ( int x = left; x <= right; ++x )
+    {
+      if ( auto cell = mCells.find( cellKey( x, y ) );
+        cell != mCells.end() )
+      {
+        for ( const auto& item : cell->second )
+        {
+          if ( item.mBounds.intersects( aArea ) )
+            aOut.push_back( item.mEntity );
+        }
+      }
+    }
+  }
+}
+
+
+std::int64_t
+SpatialGrid::cellKey( int aCellX, int aCellY ) const
+{
+  return ( static_cast<std::int64_t>( aCellY ) << 32 ) | static_cast<std::uint32_t>( aCellX );
+}
+
+
+int
+SpatialGrid::cellCoordinate( float aWorld ) const
+{
+  return static_cast<int>( std::floor( aWorld / mCellSize ) );
+}
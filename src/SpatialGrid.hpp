@@ -0,0 +1,64 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <entt/entt.hpp>
+#include <SFML/Graphics.hpp>
+
+// Uniform grid bucketing entities by the cell containing the center of their
+// bounds. Queries expand the searched cells by the largest half extent ever
+// inserted, so an item overlapping a cell boundary is still found, and each
+// item is reported at most once.
+class SpatialGrid
+{
+public:
+  explicit SpatialGrid( float aCellSize );
+
+  void insert( entt::entity aEntity, const sf::FloatRect& aBounds );
+  void clear();
+
+  // Appends to aOut every entity whose bounds intersect aArea.
+  void query( const sf::FloatRect& aArea, std::vector<entt::entity>& aOut ) const;
+
+  std::size_t size() const { return mSize; }
+
+private:
+  std::int64_t cellKey( int aCellX, int aCellY ) const;
+  int cellCoordinate( float aWorld ) const;
+
+  float mCellSize;
+  float mMaxHalfExtent { 0.0f };
+  std::size_t mSize { 0 };
+  struct Item
+  {
+    entt::entity mEntity;
+    sf::FloatRect mBounds;
+  };
+
+  std::unordered_map<std::int64_t, std::vector<Item>> mCells;
+};
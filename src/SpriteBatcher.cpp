@@ -0,0 +1,111 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "SpriteBatcher.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "Profiler.hpp"
+
+namespace
+{
+  // Maps a float to an unsigned integer of the same order.
+  std::uint32_t orderedBits( float aValue )
+  {
+    std::uint32_t bits;
+    std::memcpy( &bits, &aValue, sizeof( bits ) );
+    return ( bits & 0x80000000u ) != 0 ? ~bits : bits | 0x80000000u;
+  }
+}
+
+
+void
+SpriteBatcher::add( int aLayer, const sf::Texture* aTexture, const sf::FloatRect& aBounds, const sf::IntRect& aTextureRect )
+{
+  // A frame sees a handful of textures: a linear search beats a map.
+  std::size_t texture = std::find( mTextures.begin(), mTextures.end(), aTexture ) - mTextures.begin();
+  if ( texture == mTextures.size() )
+    mTextures.push_back( aTexture );
+  assert( texture <= 0xffff );
+
+  const std::uint64_t layer = static_cast<std::uint16_t>( aLayer + 0x8000 );
+  SortKey key;
+  key.mKey    = layer << 48 | static_cast<std::uint64_t>( texture & 0xffff ) << 32 | orderedBits( aBounds.top );
+  key.mSprite = static_cast<std::uint32_t>( mSprites.size() );
+  mKeys.push_back( key );
+
+  mSprites.push_back( Sprite { aTexture, aBounds, aTextureRect } );
+}
+
+
+void
+SpriteBatcher::flush( sf::RenderTarget& aTarget )
+{
+  PROFILE_ZONE( "flush sprites" );
+
+  mStats = Stats();
+
+  std::sort( mKeys.begin(), mKeys.end(), []( const SortKey& aLeft, const SortKey& aRight )
+  {
+    return aLeft.mKey != aRight.mKey ? aLeft.mKey < aRight.mKey : aLeft.mSprite < aRight.mSprite;
+  } );
+
+  mVertices.resize( mSprites.size() * 4 );
+  for ( std::size_t i = 0; i < mKeys.size(); ++i )
+  {
+    const Sprite& sprite = mSprites[mKeys[i].mSprite];
+    const sf::FloatRect& bounds = sprite.mBounds;
+    const float u = static_cast<float>( sprite.mTextureRect.left );
+    const float v = static_cast<float>( sprite.mTextureRect.top );
+    const float width  = static_cast<float>( sprite.mTextureRect.width );
+    const float height = static_cast<float>( sprite.mTextureRect.height );
+
+    sf::Vertex* quad = &mVertices[i * 4];
+    quad[0] = sf::Vertex( sf::Vector2f( bounds.left,                bounds.top ),                 sf::Vector2f( u,         v ) );
+    quad[1] = sf::Vertex( sf::Vector2f( bounds.left + bounds.width, bounds.top ),                 sf::Vector2f( u + width, v ) );
+    quad[2] = sf::Vertex( sf::Vector2f( bounds.left + bounds.width, bounds.top + bounds.height ), sf::Vector2f( u + width, v + height ) );
+    quad[3] = sf::Vertex( sf::Vector2f( bounds.left,                bounds.top + bounds.height ), sf::Vector2f( u,         v + height ) );
+  }
+
+  // One call per run of sprites sharing their layer and texture.
+  const std::uint64_t RUN_MASK = ~std::uint64_t( 0xffffffff );
+  for ( std::size_t first = 0; first < mKeys.size(); )
+  {
+    std::size_t last = first + 1;
+    while ( last < mKeys.size() && ( mKeys[last].mKey & RUN_MASK ) == ( mKeys[first].mKey & RUN_MASK ) )
+      ++last;
+
+    const sf::Texture* texture = mSprites[mKeys[first].mSprite].mTexture;
+    aTarget.draw( &mVertices[first * 4], ( last - first ) * 4, sf::Quads, sf::RenderStates( texture ) );
+
+    ++mStats.mDrawCalls;
+    first = last;
+  }
+  mStats.mVertices = mVertices.size();
+
+  mSprites.clear();
+  mKeys.clear();
+  mTextures.clear();
+}
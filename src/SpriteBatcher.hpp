@@ -0,0 +1,79 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+// Draws many small sprites in few calls. The sprites added during a frame
+// are sorted by layer, then texture, then y, so within a layer and texture
+// the lower sprites cover the ones above them; sprites of different textures
+// only overlap correctly across layers. Their quads are written into one
+// vertex buffer kept across frames, and each run of a layer and texture is a
+// single draw call.
+class SpriteBatcher
+{
+public:
+  struct Stats
+  {
+    std::size_t mDrawCalls { 0 };
+    std::size_t mVertices  { 0 };
+  };
+
+  // aBounds is in world pixels, aTextureRect in texture pixels. The texture
+  // must outlive the next flush().
+  void add( int aLayer, const sf::Texture* aTexture, const sf::FloatRect& aBounds, const sf::IntRect& aTextureRect );
+
+  // Draws the sprites added since the last flush and clears them.
+  void flush( sf::RenderTarget& aTarget );
+
+  std::size_t getSpriteCount() const { return mSprites.size(); }
+
+  // Counts from the last flush.
+  const Stats& getStats() const { return mStats; }
+
+private:
+  struct Sprite
+  {
+    const sf::Texture* mTexture;
+    sf::FloatRect      mBounds;
+    sf::IntRect        mTextureRect;
+  };
+
+  // Layer, texture index and y packed so one integer comparison sorts; the
+  // sprite index breaks ties, so equal keys keep their order between frames.
+  struct SortKey
+  {
+    std::uint64_t mKey;
+    std::uint32_t mSprite;
+  };
+
+  std::vector<Sprite>             mSprites;
+  std::vector<SortKey>            mKeys;
+  std::vector<const sf::Texture*> mTextures; // Seen this frame, by key index.
+  std::vector<sf::Vertex>         mVertices; // Capacity kept across frames.
+  Stats                           mStats;
+};
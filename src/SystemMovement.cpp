@@ -0,0 +1,326 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "SystemMovement.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Profiler.hpp"
+
+#if defined( __AVX__ )
+#include <immintrin.h>
+#define RPG_MOVEMENT_AVX
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define RPG_MOVEMENT_SSE
+#endif
+
+namespace
+{
+  const std::uint32_t NO_SLOT = ~std::uint32_t( 0 );
+
+  std::size_t entityIndex( entt::entity aEntity )
+  {
+    return static_cast<std::size_t>( entt::registry::entity( aEntity ) );
+  }
+
+  // Direction of the animation matching a move along aDelta.
+  ComponentCharacterAnimation::Direction facing( sf::Vector2f aDelta )
+  {
+    if ( std::abs( aDelta.x ) >= std::abs( aDelta.y ) )
+      return aDelta.x < 0.0f ? ComponentCharacterAnimation::LEFT : ComponentCharacterAnimation::RIGHT;
+
+    return aDelta.y < 0.0f ? ComponentCharacterAnimation::UP : ComponentCharacterAnimation::DOWN;
+  }
+}
+
+
+bool
+SystemMovement::isSimdAvailable()
+{
+#if defined( RPG_MOVEMENT_AVX ) || defined( RPG_MOVEMENT_SSE )
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+void
+SystemMovement::startMove( entt::registry& aRegistry, entt::entity aEntity, sf::Vector2f aDestination, float aSpeed )
+{
+  const sf::Vector2f origin = aRegistry.get<ComponentPositionWorld>( aEntity ).mPosition;
+  const sf::Vector2f delta = aDestination - origin;
+  const float distance = std::sqrt( delta.x * delta.x + delta.y * delta.y );
+
+  ComponentWorldMovement movement;
+  movement.mOrigin      = origin;
+  movement.mDestination = aDestination;
+  movement.mSpeed       = aSpeed;
+  movement.mRatio       = distance > 0.0f ? 0.0f : 1.0f;
+  aRegistry.assign_or_replace<ComponentWorldMovement>( aEntity, movement );
+
+  if ( distance > 0.0f && aRegistry.has<ComponentCharacterAnimation>( aEntity ) )
+  {
+    auto& characterAnimation = aRegistry.get<ComponentCharacterAnimation>( aEntity );
+    characterAnimation.mDirection = facing( delta );
+
+    if ( auto* spriteAnimated = aRegistry.try_get<ComponentSpriteAnimated>( aEntity ) )
+      spriteAnimated->mClip = characterAnimation.mMoveAnimations[characterAnimation.mDirection];
+  }
+
+  const std::size_t index = entityIndex( aEntity );
+  if ( index >= mSlots.size() )
+    mSlots.resize( index + 1, NO_SLOT );
+
+  if ( movement.mRatio >= 1.0f )
+  {
+    if ( mSlots[index] != NO_SLOT )
+      remove( mSlots[index] );
+    return;
+  }
+
+  assign( aEntity, origin, delta, 0.0f, aSpeed / distance );
+}
+
+
+void
+SystemMovement::stopMove( entt::registry& aRegistry, entt::entity aEntity )
+{
+  const std::size_t index = entityIndex( aEntity );
+  if ( index >= mSlots.size() || mSlots[index] == NO_SLOT )
+    return;
+
+  if ( auto* movement = aRegistry.try_get<ComponentWorldMovement>( aEntity ) )
+    movement->mRatio = mRatio[mSlots[index]];
+
+  remove( mSlots[index] );
+}
+
+
+void
+SystemMovement::restoreMoves( entt::registry& aRegistry )
+{
+  PROFILE_ZONE( "restore movement" );
+
+  mEntities.clear();
+  for ( auto* lane : { &mOriginX, &mOriginY, &mDeltaX, &mDeltaY, &mRatio, &mRatioPerSecond, &mPositionX, &mPositionY } )
+    lane->clear();
+  mSlots.assign( mSlots.size(), NO_SLOT );
+
+  auto view = aRegistry.view<ComponentWorldMovement, ComponentPositionWorld>();
+  for ( auto entity : view )
+  {
+    auto& movement = view.get<ComponentWorldMovement>( entity );
+    if ( movement.mRatio >= 1.0f )
+      continue;
+
+    const sf::Vector2f delta = movement.mDestination - movement.mOrigin;
+    const float distanceSquared = delta.x * delta.x + delta.y * delta.y;
+    if ( distanceSquared <= 0.0f )
+    {
+      movement.mRatio = 1.0f;
+      continue;
+    }
+
+    // The component's ratio is only written when a move ends or stops; the
+    // position, written every update, tells how far the move went.
+    const sf::Vector2f walked = view.get<ComponentPositionWorld>( entity ).mPosition - movement.mOrigin;
+    const float ratio = std::max( movement.mRatio, ( walked.x * delta.x + walked.y * delta.y ) / distanceSquared );
+    if ( ratio >= 1.0f )
+    {
+      movement.mRatio = 1.0f;
+      continue;
+    }
+
+    const std::size_t index = entityIndex( entity );
+    if ( index >= mSlots.size() )
+      mSlots.resize( index + 1, NO_SLOT );
+
+    assign( entity, movement.mOrigin, delta, ratio, movement.mSpeed / std::sqrt( distanceSquared ) );
+  }
+}
+
+
+void
+SystemMovement::update( entt::registry& aRegistry, float aDt )
+{
+  PROFILE_ZONE( "update movement" );
+
+  advance( aDt );
+  writeBack( aRegistry );
+}
+
+
+void
+SystemMovement::advance( float aDt )
+{
+  if ( mSimdEnabled && isSimdAvailable() )
+    advanceSimd( aDt );
+  else
+    advanceScalar( aDt, 0, mEntities.size() );
+}
+
+
+void
+SystemMovement::writeBack( entt::registry& aRegistry )
+{
+  // Positions live in the registry: scattered one entity at a time. Ended
+  // moves are removed by swapping the last slot in, which is visited next.
+  for ( std::size_t slot = 0; slot < mEntities.size(); )
+  {
+    const entt::entity entity = mEntities[slot];
+    if ( !aRegistry.valid( entity ) )
+    {
+      remove( slot );
+      continue;
+    }
+
+    aRegistry.get<ComponentPositionWorld>( entity ).mPosition = sf::Vector2f( mPositionX[slot], mPositionY[slot] );
+
+    if ( mRatio[slot] >= 1.0f )
+    {
+      aRegistry.get<ComponentWorldMovement>( entity ).mRatio = 1.0f;
+      remove( slot );
+      continue;
+    }
+
+    ++slot;
+  }
+}
+
+
+void
+SystemMovement::advanceScalar( float aDt, std::size_t aFirst, std::size_t aLast )
+{
+  float* ratio = mRatio.data();
+  float* positionX = mPositionX.data();
+  float* positionY = mPositionY.data();
+  const float* originX = mOriginX.data();
+  const float* originY = mOriginY.data();
+  const float* deltaX = mDeltaX.data();
+  const float* deltaY = mDeltaY.data();
+  const float* ratioPerSecond = mRatioPerSecond.data();
+
+  for ( std::size_t i = aFirst; i < aLast; ++i )
+  {
+    const float r = std::min( ratio[i] + ratioPerSecond[i] * aDt, 1.0f );
+    ratio[i] = r;
+    positionX[i] = originX[i] + deltaX[i] * r;
+    positionY[i] = originY[i] + deltaY[i] * r;
+  }
+}
+
+
+void
+SystemMovement::advanceSimd( float aDt )
+{
+  const std::size_t count = mEntities.size();
+  std::size_t i = 0;
+
+  float* ratio = mRatio.data();
+  float* positionX = mPositionX.data();
+  float* positionY = mPositionY.data();
+  const float* originX = mOriginX.data();
+  const float* originY = mOriginY.data();
+  const float* deltaX = mDeltaX.data();
+  const float* deltaY = mDeltaY.data();
+  const float* ratioPerSecond = mRatioPerSecond.data();
+
+#if defined( RPG_MOVEMENT_AVX )
+  const __m256 dt  = _mm256_set1_ps( aDt );
+  const __m256 one = _mm256_set1_ps( 1.0f );
+  for ( ; i + 8 <= count; i += 8 )
+  {
+    __m256 r = _mm256_add_ps( _mm256_loadu_ps( ratio + i ), _mm256_mul_ps( _mm256_loadu_ps( ratioPerSecond + i ), dt ) );
+    r = _mm256_min_ps( r, one );
+    _mm256_storeu_ps( ratio + i, r );
+    _mm256_storeu_ps( positionX + i, _mm256_add_ps( _mm256_loadu_ps( originX + i ), _mm256_mul_ps( _mm256_loadu_ps( deltaX + i ), r ) ) );
+    _mm256_storeu_ps( positionY + i, _mm256_add_ps( _mm256_loadu_ps( originY + i ), _mm256_mul_ps( _mm256_loadu_ps( deltaY + i ), r ) ) );
+  }
+#elif defined( RPG_MOVEMENT_SSE )
+  const __m128 dt  = _mm_set1_ps( aDt );
+  const __m128 one = _mm_set1_ps( 1.0f );
+  for ( ; i + 4 <= count; i += 4 )
+  {
+    __m128 r = _mm_add_ps( _mm_loadu_ps( ratio + i ), _mm_mul_ps( _mm_loadu_ps( ratioPerSecond + i ), dt ) );
+    r = _mm_min_ps( r, one );
+    _mm_storeu_ps( ratio + i, r );
+    _mm_storeu_ps( positionX + i, _mm_add_ps( _mm_loadu_ps( originX + i ), _mm_mul_ps( _mm_loadu_ps( deltaX + i ), r ) ) );
+    _mm_storeu_ps( positionY + i, _mm_add_ps( _mm_loadu_ps( originY + i ), _mm_mul_ps( _mm_loadu_ps( deltaY + i ), r ) ) );
+  }
+#endif
+
+  // The remainder, or everything without SIMD.
+  advanceScalar( aDt, i, count );
+}
+
+
+void
+SystemMovement::assign( entt::entity aEntity, sf::Vector2f aOrigin, sf::Vector2f aDelta, float aRatio, float aRatioPerSecond )
+{
+  const std::size_t index = entityIndex( aEntity );
+
+  std::uint32_t slot = mSlots[index];
+  if ( slot == NO_SLOT )
+  {
+    slot = static_cast<std::uint32_t>( mEntities.size() );
+    mSlots[index] = slot;
+    mEntities.push_back( aEntity );
+    for ( auto* lane : { &mOriginX, &mOriginY, &mDeltaX, &mDeltaY, &mRatio, &mRatioPerSecond, &mPositionX, &mPositionY } )
+      lane->push_back( 0.0f );
+  }
+  // The slot may still hold a destroyed entity which had the same index.
+  mEntities[slot] = aEntity;
+
+  mOriginX[slot]        = aOrigin.x;
+  mOriginY[slot]        = aOrigin.y;
+  mDeltaX[slot]         = aDelta.x;
+  mDeltaY[slot]         = aDelta.y;
+  mRatio[slot]          = aRatio;
+  mRatioPerSecond[slot] = aRatioPerSecond;
+  mPositionX[slot]      = aOrigin.x + aDelta.x * aRatio;
+  mPositionY[slot]      = aOrigin.y + aDelta.y * aRatio;
+}
+
+
+void
+SystemMovement::remove( std::size_t aSlot )
+{
+  const std::size_t last = mEntities.size() - 1;
+
+  mSlots[entityIndex( mEntities[aSlot] )] = NO_SLOT;
+  if ( aSlot != last )
+  {
+    mEntities[aSlot] = mEntities[last];
+    mSlots[entityIndex( mEntities[aSlot] )] = static_cast<std::uint32_t>( aSlot );
+  }
+  mEntities.pop_back();
+
+  for ( auto* lane : { &mOriginX, &mOriginY, &mDeltaX, &mDeltaY, &mRatio, &mRatioPerSecond, &mPositionX, &mPositionY } )
+  {
+    ( *lane )[aSlot] = ( *lane )[last];
+    lane->pop_back();
+  }
+}
@@ -0,0 +1,87 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <vector>
+
+#include <entt/entt.hpp>
+#include <SFML/System.hpp>
+
+#include "Components.hpp"
+
+// Moves entities in straight lines: ComponentPositionWorld goes from the
+// ComponentWorldMovement's origin to its destination at its speed. The
+// component is the record of a move; the system keeps the hot copy of every
+// move in progress as structure of arrays, advanced by a vectorized loop
+// (AVX when compiled for it, SSE2 otherwise on x86) or a scalar one.
+class SystemMovement
+{
+public:
+  // Starts moving aEntity from where it stands to aDestination, at aSpeed
+  // tiles per second, replacing any move in progress. Characters turn to
+  // face the move. Creates components: not for use from a Scheduler system.
+  void startMove( entt::registry& aRegistry, entt::entity aEntity, sf::Vector2f aDestination, float aSpeed );
+
+  // Stops aEntity where it is, e.g. before it is destroyed.
+  void stopMove( entt::registry& aRegistry, entt::entity aEntity );
+
+  // Forgets every move in progress and takes them back from the
+  // ComponentWorldMovement of aRegistry, e.g. after a snapshot was restored
+  // into it. Call before the next update().
+  void restoreMoves( entt::registry& aRegistry );
+
+  // Advances every move by aDt seconds. Writes ComponentPositionWorld, and
+  // ComponentWorldMovement's ratio once a move ends.
+  void update( entt::registry& aRegistry, float aDt );
+
+  // The arithmetic part of update(), on the system's arrays alone.
+  void advance( float aDt );
+
+  std::size_t getMoverCount() const { return mEntities.size(); }
+
+  // The vectorized loop is used when compiled in, unless disabled here.
+  static bool isSimdAvailable();
+  void setSimdEnabled( bool aEnabled ) { mSimdEnabled = aEnabled; }
+
+private:
+  void advanceScalar( float aDt, std::size_t aFirst, std::size_t aLast );
+  void advanceSimd( float aDt );
+  void writeBack( entt::registry& aRegistry );
+  void assign( entt::entity aEntity, sf::Vector2f aOrigin, sf::Vector2f aDelta, float aRatio, float aRatioPerSecond );
+  void remove( std::size_t aSlot );
+
+  // One slot per move in progress, parallel arrays.
+  std::vector<entt::entity> mEntities;
+  std::vector<float>        mOriginX;
+  std::vector<float>        mOriginY;
+  std::vector<float>        mDeltaX; // Destination minus origin.
+  std::vector<float>        mDeltaY;
+  std::vector<float>        mRatio;
+  std::vector<float>        mRatioPerSecond; // Speed over distance.
+  std::vector<float>        mPositionX; // Output of the advance loops.
+  std::vector<float>        mPositionY;
+
+  std::vector<std::uint32_t> mSlots; // By entity index, ~0 when not moving.
+  bool                       mSimdEnabled { true };
+};
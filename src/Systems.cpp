@@ -24,23 +24,113 @@
 
 #include "Systems.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <utility>
 #include <SFML/Graphics.hpp>
 
+#include "AnimationLibrary.hpp"
 #include "AssetLoader.hpp"
+#include "BulkSpawn.hpp"
 #include "Components.hpp"
 #include "GlobalDefs.hpp"
+#include "JobSystem.hpp"
+#include "MemoryTracker.hpp"
+#include "Profiler.hpp"
+#include "SpatialGrid.hpp"
+#include "SpriteBatcher.hpp"
+#include "TextureRegistry.hpp"
+#include "TileAtlas.hpp"
+#include "TileGrid.hpp"
+#include "TilePyramid.hpp"
+#include "TileQuads.hpp"
+#include "WorldPager.hpp"
+
+namespace
+{
+  // Animations advanced per job: large enough to amortize the job overhead.
+  const std::size_t ANIMATION_JOB_SIZE = 16384;
+
+  // Sprite batcher layer of the characters.
+  const int CHARACTER_LAYER = 0;
+
+  // Extra background cached around the camera on each side, as a fraction
+  // of the camera size: how far it moves before the cache is redrawn.
+  const float BACKGROUND_CACHE_MARGIN = 0.5f;
+
+  // Camera size change per mouse wheel notch.
+  const float ZOOM_STEP = 1.25f;
+
+  // World pixel bounds of a single tile-sized sprite at aPosition (in tiles).
+  sf::FloatRect tileBounds( sf::Vector2f aPosition )
+  {
+    const float size = static_cast<float>( Globals::TILE_SIZE );
+    return sf::FloatRect( aPosition.x * size - size / 2, aPosition.y * size - size / 2, size, size );
+  }
+
+  // Quad of aSprite drawn with its origin at aPosition, in world pixels.
+  void setSpriteQuad( sf::Vertex* aVertices, sf::Vector2f aPosition, const ComponentSprite& aSprite )
+  {
+    const sf::Vector2f topLeft = aPosition - aSprite.mOrigin;
+    const float width  = static_cast<float>( aSprite.mTextureRect.width );
+    const float height = static_cast<float>( aSprite.mTextureRect.height );
+    const float u      = static_cast<float>( aSprite.mTextureRect.left );
+    const float v      = static_cast<float>( aSprite.mTextureRect.top );
+
+    aVertices[0] = sf::Vertex( topLeft,                                 aSprite.mColor, sf::Vector2f( u,         v ) );
+    aVertices[1] = sf::Vertex( topLeft + sf::Vector2f( width, 0.0f ),   aSprite.mColor, sf::Vector2f( u + width, v ) );
+    aVertices[2] = sf::Vertex( topLeft + sf::Vector2f( width, height ), aSprite.mColor, sf::Vector2f( u + width, v + height ) );
+    aVertices[3] = sf::Vertex( topLeft + sf::Vector2f( 0.0f, height ),  aSprite.mColor, sf::Vector2f( u,         v + height ) );
+  }
+
+  // Position to draw aEntity at, aInterpolation of the way through the current tick.
+  sf::Vector2f interpolatedPosition( entt::registry& aRegistry, entt::entity aEntity, float aInterpolation )
+  {
+    const sf::Vector2f current = aRegistry.get<ComponentPositionWorld>( aEntity ).mPosition;
+    if ( !aRegistry.has<ComponentPositionWorldPrevious>( aEntity ) )
+      return current;
+
+    const sf::Vector2f previous = aRegistry.get<ComponentPositionWorldPrevious>( aEntity ).mPosition;
+    return previous + ( current - previous ) * aInterpolation;
+  }
+}
 
-SystemRenderer::SystemRenderer( std::shared_ptr<sf::RenderWindow> aRenderWindow )
-  : mRenderWindow ( aRenderWindow )
+SystemRenderer::SystemRenderer( std::shared_ptr<sf::RenderWindow> aRenderWindow, BackgroundMode aBackgroundMode )
+  : SystemRenderer( aRenderWindow.get(), aBackgroundMode )
 {
+  mRenderWindow = aRenderWindow;
 }
 
 
+SystemRenderer::SystemRenderer( std::shared_ptr<sf::RenderTexture> aRenderTexture, BackgroundMode aBackgroundMode )
+  : SystemRenderer( aRenderTexture.get(), aBackgroundMode )
+{
+  mRenderTexture = aRenderTexture;
+}
+
+
+SystemRenderer::SystemRenderer( sf::RenderTarget* aRenderTarget, BackgroundMode aBackgroundMode )
+  : mBackgroundMode ( aBackgroundMode )
+  , mRenderTarget ( aRenderTarget )
+  , mView ( std::make_unique<sf::View>( aRenderTarget ? aRenderTarget->getDefaultView() : sf::View() ) )
+  , mBackgroundIndex ( std::make_unique<SpatialGrid>( static_cast<float>( Globals::CHUNK_SIZE * Globals::TILE_SIZE ) ) )
+  , mEntityIndex ( std::make_unique<SpatialGrid>( static_cast<float>( Globals::CHUNK_SIZE * Globals::TILE_SIZE ) ) )
+  , mAnimationLibrary ( std::make_unique<AnimationLibrary>() )
+  , mSpriteBatcher ( std::make_unique<SpriteBatcher>() )
+{
+}
+
+
+SystemRenderer::~SystemRenderer() = default;
+
+
 bool
-SystemRenderer::render( entt::registry& aRegistry )
+SystemRenderer::processEvents()
 {
-  if ( !mRenderWindow->isOpen() )
+  PROFILE_ZONE( "pollEvent" );
+
+  if ( !mRenderWindow || !mRenderWindow->isOpen() )
     return false;
 
   sf::Event event;
@@ -48,135 +138,608 @@ SystemRenderer::render( entt::registry& aRegistry )
   {
     if (event.type == sf::Event::Closed)
       mRenderWindow->close();
+    else if ( event.type == sf::Event::MouseWheelScrolled )
+      mView->zoom( event.mouseWheelScroll.delta > 0.0f ? 1.0f / ZOOM_STEP : ZOOM_STEP );
   }
 
-  mRenderWindow->clear();
+  return mRenderWindow->isOpen();
+}
 
-  auto viewBackground = aRegistry.view<ComponentPositionWorld, ComponentSprite, ComponentLayerBackground>();
-  for(auto entity: viewBackground) 
-  {
-    auto& positionWorld = viewBackground.get<ComponentPositionWorld>( entity );
-    auto& sprite = viewBackground.get<ComponentSprite>( entity );
 
-    sf::Vector2f sfPosition(
-      Globals::TILE_SIZE * positionWorld.mPosition.x,
-      Globals::TILE_SIZE * positionWorld.mPosition.y );
-    sprite.mSprite->setPosition( sfPosition );
+void
+SystemRenderer::render( entt::registry& aRegistry, float aInterpolation )
+{
+  PROFILE_ZONE( "render" );
+  MEMORY_TAG( TAG_RENDER );
+
+  applyTileEdits( aRegistry );
+
+  if ( !mRenderTarget )
+    return;
+
+  mRenderTarget->clear();
 
-    mRenderWindow->draw( *sprite.mSprite );
+  auto viewMainCharacter = aRegistry.view<ComponentPositionWorld, ComponentMainCharacter>();
+  for ( auto entity : viewMainCharacter )
+    mView->setCenter( static_cast<float>( Globals::TILE_SIZE ) * interpolatedPosition( aRegistry, entity, aInterpolation ) );
+  mRenderTarget->setView( *mView );
+
+  const sf::FloatRect cameraArea( mView->getCenter() - mView->getSize() / 2.0f, mView->getSize() );
+  mRenderStats = RenderStats();
+
+  renderBackground( aRegistry, cameraArea );
+  renderCharacters( aRegistry, cameraArea, aInterpolation );
+
+  PROFILE_ZONE( "display" );
+  if ( mRenderWindow )
+    mRenderWindow->display();
+  else
+    mRenderTexture->display();
+}
+
+
+void
+SystemRenderer::renderBackground( entt::registry& aRegistry, const sf::FloatRect& aCameraArea )
+{
+  PROFILE_ZONE( "render background" );
+
+  if ( mWorldPager )
+    mWorldPager->update( aCameraArea );
+
+  // Zoomed out far enough, a few pre-rendered blocks stand for the tiles.
+  if ( mTilePyramid && mRenderTarget->getSize().x > 0 )
+  {
+    const float worldPixelsPerPixel = aCameraArea.width / static_cast<float>( mRenderTarget->getSize().x );
+    const int level = mTilePyramid->selectLevel( worldPixelsPerPixel );
+    if ( level >= 0 )
+    {
+      const std::size_t blocks = mTilePyramid->draw( *mRenderTarget, aCameraArea, level, &mRenderStats.mVertices );
+      mRenderStats.mBackgroundVisited = blocks;
+      mRenderStats.mDrawCalls        += blocks;
+      mRenderStats.mBackgroundLevel   = level;
+      return;
+    }
   }
 
-  auto viewMainCharacterAnim = aRegistry.view<ComponentPositionWorld, ComponentSpriteAnimated, ComponentMainCharacter>();
-  for(auto entity: viewMainCharacterAnim) 
+  if ( !mBackgroundCaching || !updateBackgroundCache( aRegistry, aCameraArea ) )
   {
-    auto& positionWorld = viewMainCharacterAnim.get<ComponentPositionWorld>( entity );
-    auto& spriteAnimated = viewMainCharacterAnim.get<ComponentSpriteAnimated>( entity );
+    drawBackground( *mRenderTarget, aRegistry, aCameraArea );
+    return;
+  }
+
+  // Texels of the cache are world pixels, one to one.
+  const sf::FloatRect& area = mBackgroundCacheArea;
+  const sf::Vertex quad[4] =
+  {
+    sf::Vertex( sf::Vector2f( area.left,              area.top ),               sf::Vector2f( 0.0f,       0.0f ) ),
+    sf::Vertex( sf::Vector2f( area.left + area.width, area.top ),               sf::Vector2f( area.width, 0.0f ) ),
+    sf::Vertex( sf::Vector2f( area.left + area.width, area.top + area.height ), sf::Vector2f( area.width, area.height ) ),
+    sf::Vertex( sf::Vector2f( area.left,              area.top + area.height ), sf::Vector2f( 0.0f,       area.height ) )
+  };
+  mRenderTarget->draw( quad, 4, sf::Quads, sf::RenderStates( &mBackgroundCache->getTexture() ) );
+  mRenderStats.mDrawCalls += 1;
+  mRenderStats.mVertices  += 4;
+}
 
-    sf::Vector2f sfPosition(
-      Globals::TILE_SIZE * positionWorld.mPosition.x,
-      Globals::TILE_SIZE * positionWorld.mPosition.y );
-    spriteAnimated.mSequenceElements[spriteAnimated.mCurrentSequenceElementIndex]->mSprite->setPosition( sfPosition );
 
-    mRenderWindow->draw( *spriteAnimated.mSequenceElements[spriteAnimated.mCurrentSequenceElementIndex]->mSprite );
+bool
+SystemRenderer::updateBackgroundCache( entt::registry& aRegistry, const sf::FloatRect& aCameraArea )
+{
+  const sf::FloatRect& cached = mBackgroundCacheArea;
+  const bool cameraInside = aCameraArea.left >= cached.left && aCameraArea.top >= cached.top
+    && aCameraArea.left + aCameraArea.width <= cached.left + cached.width
+    && aCameraArea.top + aCameraArea.height <= cached.top + cached.height;
+  const std::uint64_t pages = mWorldPager ? mWorldPager->getStats().mPagesLoaded : 0;
+
+  if ( mBackgroundCacheValid && cameraInside && pages == mBackgroundCachePages )
+    return true;
+
+  PROFILE_ZONE( "redraw background cache" );
+
+  // Whole world pixels, so texels land on pixels as the tiles would.
+  const sf::Vector2f margin = sf::Vector2f( aCameraArea.width, aCameraArea.height ) * BACKGROUND_CACHE_MARGIN;
+  const float left   = std::floor( aCameraArea.left - margin.x );
+  const float top    = std::floor( aCameraArea.top - margin.y );
+  const float right  = std::ceil( aCameraArea.left + aCameraArea.width + margin.x );
+  const float bottom = std::ceil( aCameraArea.top + aCameraArea.height + margin.y );
+  const sf::Vector2u size( static_cast<unsigned>( right - left ), static_cast<unsigned>( bottom - top ) );
+
+  if ( size.x == 0 || size.y == 0 || size.x > sf::Texture::getMaximumSize() || size.y > sf::Texture::getMaximumSize() )
+  {
+    mBackgroundCacheValid = false;
+    return false;
   }
-  
-  mRenderWindow->display();
 
+  if ( !mBackgroundCache || mBackgroundCache->getSize() != size )
+  {
+    mBackgroundCache = std::make_unique<sf::RenderTexture>();
+    if ( !mBackgroundCache->create( size.x, size.y ) )
+    {
+      mBackgroundCache.reset();
+      mBackgroundCacheValid = false;
+      return false;
+    }
+  }
+
+  mBackgroundCacheArea = sf::FloatRect( left, top, right - left, bottom - top );
+  mBackgroundCache->setView( sf::View( mBackgroundCacheArea ) );
+  mBackgroundCache->clear();
+  drawBackground( *mBackgroundCache, aRegistry, mBackgroundCacheArea );
+  mBackgroundCache->display();
+
+  mBackgroundCacheValid = true;
+  mBackgroundCachePages = pages;
+  mRenderStats.mBackgroundRedrawn = true;
   return true;
 }
 
 
 void
-SystemRenderer::updateAnimation( float aDt, entt::registry& aRegistry )
+SystemRenderer::drawBackground( sf::RenderTarget& aTarget, entt::registry& aRegistry, const sf::FloatRect& aArea )
 {
-  auto view = aRegistry.view<ComponentSpriteAnimated>();
-  for(auto entity: view) 
+  mVisible.clear();
+  mBackgroundIndex->query( aArea, mVisible );
+  for ( auto entity : mVisible )
   {
-    auto& spriteAnimated = view.get( entity );
-
-    spriteAnimated.mTimeInCurrentLoop += aDt;
-    if ( spriteAnimated.mTimeInCurrentLoop >= spriteAnimated.mTotalTime )
-      spriteAnimated.mTimeInCurrentLoop -= spriteAnimated.mTotalTime;
-    float currentRatio = spriteAnimated.mTimeInCurrentLoop / spriteAnimated.mTotalTime;
+    if ( mBackgroundMode == BACKGROUND_MODE_CHUNKS )
+    {
+      auto& chunk = aRegistry.get<ComponentTileChunk>( entity );
 
-    float ratioAccumulator = 0.0f;
-    for ( std::size_t i = 0u; i < spriteAnimated.mSequenceElements.size(); ++i )
+      aTarget.draw( chunk.mVertices, sf::RenderStates( mTextures->get( chunk.mTexture ) ) );
+      mRenderStats.mVertices += chunk.mVertices.getVertexCount();
+    }
+    else
     {
-      ratioAccumulator += spriteAnimated.mSequenceElements[i]->mRatio;
-      if ( currentRatio < ratioAccumulator )
-        spriteAnimated.mCurrentSequenceElementIndex = i;
+      auto& positionWorld = aRegistry.get<ComponentPositionWorld>( entity );
+      auto& sprite = aRegistry.get<ComponentSprite>( entity );
+
+      sf::Vector2f sfPosition(
+        Globals::TILE_SIZE * positionWorld.mPosition.x,
+        Globals::TILE_SIZE * positionWorld.mPosition.y );
+      sf::Vertex quad[4];
+      setSpriteQuad( quad, sfPosition, sprite );
+
+      aTarget.draw( quad, 4, sf::Quads, sf::RenderStates( mTextures->get( sprite.mTexture ) ) );
+      mRenderStats.mVertices += 4;
     }
   }
-  
+  mRenderStats.mDrawCalls += mVisible.size();
+  mRenderStats.mBackgroundVisited = mVisible.size();
+  mRenderStats.mBackgroundCulled  = mBackgroundIndex->size() - mVisible.size();
+
+  if ( mWorldPager )
+  {
+    const std::size_t pages = mWorldPager->draw( aTarget, aArea, &mRenderStats.mVertices );
+    mRenderStats.mBackgroundVisited += pages;
+    mRenderStats.mDrawCalls += pages;
+  }
+}
+
+
+void
+SystemRenderer::renderCharacters( entt::registry& aRegistry, const sf::FloatRect& aCameraArea, float aInterpolation )
+{
+  PROFILE_ZONE( "render characters" );
+
+  // Characters move, so their index is refilled every frame.
+  auto viewMainCharacterAnim = aRegistry.view<ComponentPositionWorld, ComponentSpriteAnimated, ComponentMainCharacter>();
+  mEntityIndex->clear();
+  for ( auto entity : viewMainCharacterAnim )
+    mEntityIndex->insert( entity, tileBounds( interpolatedPosition( aRegistry, entity, aInterpolation ) ) );
+
+  mVisible.clear();
+  mEntityIndex->query( aCameraArea, mVisible );
+  for ( auto entity : mVisible )
+  {
+    const sf::Vector2f position = interpolatedPosition( aRegistry, entity, aInterpolation );
+    auto& spriteAnimated = viewMainCharacterAnim.get<ComponentSpriteAnimated>( entity );
+    const AnimationClip& clip = mAnimationLibrary->getClip( spriteAnimated.mClip );
+
+    mSpriteBatcher->add( CHARACTER_LAYER, mTextures->get( clip.mTexture ), tileBounds( position ),
+      mAnimationLibrary->getFrameRect( clip, spriteAnimated.mCurrentSequenceElementIndex ) );
+  }
+  mSpriteBatcher->flush( *mRenderTarget );
+  mRenderStats.mDrawCalls += mSpriteBatcher->getStats().mDrawCalls;
+  mRenderStats.mVertices  += mSpriteBatcher->getStats().mVertices;
+  mRenderStats.mEntitiesVisited = mVisible.size();
+  mRenderStats.mEntitiesCulled  = mEntityIndex->size() - mVisible.size();
+}
+
+
+void
+SystemRenderer::storePreviousPositions( entt::registry& aRegistry )
+{
+  PROFILE_ZONE( "store previous positions" );
+
+  auto view = aRegistry.view<ComponentPositionWorld, ComponentPositionWorldPrevious>();
+  for ( auto entity : view )
+    view.get<ComponentPositionWorldPrevious>( entity ).mPosition = view.get<ComponentPositionWorld>( entity ).mPosition;
+}
+
+
+void
+SystemRenderer::updateAnimation( float aDt, entt::registry& aRegistry, JobSystem* aJobSystem )
+{
+  PROFILE_ZONE( "updateAnimation" );
+
+  auto view = aRegistry.view<ComponentSpriteAnimated>();
+  ComponentSpriteAnimated* animations = view.raw();
+
+  if ( aJobSystem == nullptr )
+  {
+    mAnimationLibrary->advance( aDt, animations, view.size() );
+    return;
+  }
+
+  aJobSystem->parallelFor( view.size(), ANIMATION_JOB_SIZE, [this, aDt, animations]( std::size_t aBegin, std::size_t aEnd )
+  {
+    mAnimationLibrary->advance( aDt, animations + aBegin, aEnd - aBegin );
+  } );
 }
 
 
 void
 SystemRenderer::createMap( entt::registry& aRegistry, AssetLoader& aAssetsLoader )
+{
+  PROFILE_ZONE( "createMap" );
+  MEMORY_TAG( TAG_ECS );
+
+  mBackgroundCacheValid = false;
+
+  switch ( mBackgroundMode )
+  {
+  case BACKGROUND_MODE_SPRITES: createMapSprites( aRegistry, aAssetsLoader ); break;
+  case BACKGROUND_MODE_CHUNKS:  createMapChunks( aRegistry, aAssetsLoader ); break;
+  }
+}
+
+
+void
+SystemRenderer::createMapSprites( entt::registry& aRegistry, AssetLoader& aAssetsLoader )
 {
   auto mapSize = aAssetsLoader.GetMapSize( AssetLoader::ASSET_MAP );
   auto map     = aAssetsLoader.GetMapData( AssetLoader::ASSET_MAP );
-  std::shared_ptr<sf::Texture> texture = aAssetsLoader.GetTexture( AssetLoader::ASSET_TILEMAP );
+  std::shared_ptr<const TileAtlas> atlas = aAssetsLoader.GetAtlas( AssetLoader::ASSET_TILEMAP );
+
+  mMap.open( map );
+  mAtlas = atlas;
+  mTextures = aAssetsLoader.GetTextureRegistry();
+
+  // Every pool is sized once and filled in bulk, straight from the map rows.
+  const std::size_t tileCount = static_cast<std::size_t>( mapSize.x ) * mapSize.y;
+  mMapEntities.clear();
+  mMapEntities.reserve( tileCount );
+  BulkSpawn::reserve<ComponentPositionWorld, ComponentSprite, ComponentLayerBackground>( aRegistry, tileCount );
+  BulkSpawn::create( aRegistry, tileCount, mMapEntities );
 
- // int entitiesToCreateCount = mapSize.x * mapSize.y;
+  const entt::entity* first = mMapEntities.data();
+  const entt::entity* last  = first + tileCount;
+
+  ComponentSprite sprite;
+  sprite.mTexture = atlas->getTextureHandle();
+  sprite.mOrigin  = sf::Vector2f( Globals::TILE_SIZE / 2, Globals::TILE_SIZE / 2 );
+
+  ComponentPositionWorld* positions = BulkSpawn::assign<ComponentPositionWorld>( aRegistry, first, last );
+  ComponentSprite* sprites = BulkSpawn::assign<ComponentSprite>( aRegistry, first, last, sprite );
+  BulkSpawn::assign<ComponentLayerBackground>( aRegistry, first, last );
 
   for ( int y = 0; y < mapSize.y; ++y )
   {
+    const TileId* row = map.row( y );
+
     for ( int x = 0; x < mapSize.x; ++x )
     {
-      sf::Vector2i spriteIndex = map[y][x];
+      const std::size_t tile = static_cast<std::size_t>( y ) * mapSize.x + x;
+      const sf::Vector2f position( static_cast<float>( x ), static_cast<float>( y ) );
 
-      std::unique_ptr sprite = std::make_unique<sf::Sprite>();
-      sprite->setTexture( *texture );
-      sprite->setTextureRect( sf::IntRect( 
-        spriteIndex.x * Globals::TILE_SIZE, 
-        spriteIndex.y * Globals::TILE_SIZE, 
-        Globals::TILE_SIZE, 
-        Globals::TILE_SIZE ) );
-      sprite->setOrigin( Globals::TILE_SIZE / 2, Globals::TILE_SIZE / 2 );
+      positions[tile].mPosition  = position;
+      sprites[tile].mTextureRect = atlas->getTileRect( row[x] );
+
+      mBackgroundIndex->insert( mMapEntities[tile], tileBounds( position ) );
+    }
+  }
+}
+
+
+void
+SystemRenderer::createMapChunks( entt::registry& aRegistry, AssetLoader& aAssetsLoader )
+{
+  auto mapSize = aAssetsLoader.GetMapSize( AssetLoader::ASSET_MAP );
+  auto map     = aAssetsLoader.GetMapData( AssetLoader::ASSET_MAP );
+  std::shared_ptr<const TileAtlas> atlas = aAssetsLoader.GetAtlas( AssetLoader::ASSET_TILEMAP );
+
+  mMap.open( map );
+  mAtlas = atlas;
+  mTextures = aAssetsLoader.GetTextureRegistry();
+  mMapEntities.clear();
+
+  for ( int chunkTop = 0; chunkTop < mapSize.y; chunkTop += Globals::CHUNK_SIZE )
+  {
+    for ( int chunkLeft = 0; chunkLeft < mapSize.x; chunkLeft += Globals::CHUNK_SIZE )
+    {
+      // Chunks on the right and bottom edges may be partial.
+      const int chunkWidth  = std::min( Globals::CHUNK_SIZE, mapSize.x - chunkLeft );
+      const int chunkHeight = std::min( Globals::CHUNK_SIZE, mapSize.y - chunkTop );
 
       auto entity = aRegistry.create();
-      aRegistry.assign<ComponentPositionWorld>( entity, sf::Vector2f( static_cast<float>( x ), static_cast<float>( y ) ) );
-      aRegistry.assign<ComponentSprite>( entity, texture, std::move( sprite ) );
+      auto& chunk = aRegistry.assign<ComponentTileChunk>( entity );
+      chunk.mTexture = atlas->getTextureHandle();
+      chunk.mVertices.setPrimitiveType( sf::Quads );
+      chunk.mVertices.resize( static_cast<std::size_t>( chunkWidth * chunkHeight * 4 ) );
+
+      const TileGridView tiles = map.region( sf::IntRect( chunkLeft, chunkTop, chunkWidth, chunkHeight ) );
+      for ( int y = 0; y < chunkHeight; ++y )
+      {
+        const TileId* row = tiles.row( y );
+
+        for ( int x = 0; x < chunkWidth; ++x )
+        {
+          sf::Vector2i tile( chunkLeft + x, chunkTop + y );
+          setTileQuad( &chunk.mVertices[( y * chunkWidth + x ) * 4], tile, atlas->getTilePosition( row[x] ) );
+        }
+      }
+
       aRegistry.assign<ComponentLayerBackground>( entity );
+      mMapEntities.push_back( entity );
+
+      mBackgroundIndex->insert( entity, tileAreaBounds( sf::IntRect( chunkLeft, chunkTop, chunkWidth, chunkHeight ) ) );
+    }
+  }
+}
+
+
+void
+SystemRenderer::setTile( int aX, int aY, TileId aTile )
+{
+  assert( mAtlas && mAtlas->contains( aTile ) );
+  mMap.set( sf::Vector2i( aX, aY ), aTile );
+}
+
+
+void
+SystemRenderer::setTiles( const sf::IntRect& aRegion, const TileGridView& aTiles )
+{
+  mMap.setRegion( aRegion, aTiles );
+}
+
+
+void
+SystemRenderer::fillTiles( const sf::IntRect& aRegion, TileId aTile )
+{
+  assert( mAtlas && mAtlas->contains( aTile ) );
+  mMap.fillRegion( aRegion, aTile );
+}
+
+
+void
+SystemRenderer::applyTileEdits( entt::registry& aRegistry )
+{
+  PROFILE_ZONE( "applyTileEdits" );
+
+  mMap.takeDirtyTiles( mEditedTiles );
+  if ( mEditedTiles.empty() )
+    return;
+
+  const TileGridView& map = mMap.getView();
+  const sf::Vector2i mapSize = map.getSize();
+  const int chunksPerRow = ( mapSize.x + Globals::CHUNK_SIZE - 1 ) / Globals::CHUNK_SIZE;
+
+  for ( const sf::Vector2i& tile : mEditedTiles )
+  {
+    const TileId tileId = map.at( tile.x, tile.y );
+
+    if ( mBackgroundCacheValid && tileAreaBounds( sf::IntRect( tile.x, tile.y, 1, 1 ) ).intersects( mBackgroundCacheArea ) )
+      mBackgroundCacheValid = false;
+
+    if ( mBackgroundMode == BACKGROUND_MODE_CHUNKS )
+    {
+      // Patches the tile's quad within its chunk, laid out as in createMapChunks().
+      const sf::Vector2i chunk( tile.x / Globals::CHUNK_SIZE, tile.y / Globals::CHUNK_SIZE );
+      const int chunkWidth = std::min( Globals::CHUNK_SIZE, mapSize.x - chunk.x * Globals::CHUNK_SIZE );
+      const int local = ( tile.y % Globals::CHUNK_SIZE ) * chunkWidth + tile.x % Globals::CHUNK_SIZE;
+
+      auto& tileChunk = aRegistry.get<ComponentTileChunk>( mMapEntities[chunk.y * chunksPerRow + chunk.x] );
+      setTileQuad( &tileChunk.mVertices[local * 4], tile, mAtlas->getTilePosition( tileId ) );
+    }
+    else
+    {
+      auto& sprite = aRegistry.get<ComponentSprite>( mMapEntities[static_cast<std::size_t>( tile.y ) * mapSize.x + tile.x] );
+      sprite.mTextureRect = mAtlas->getTileRect( tileId );
     }
   }
+
+  if ( mTilePyramid )
+    mTilePyramid->updateTiles( map, mEditedTiles );
+}
+
+
+void
+SystemRenderer::setWorldPager( std::shared_ptr<WorldPager> aWorldPager )
+{
+  mWorldPager = aWorldPager;
+  mBackgroundCacheValid = false;
 }
 
 
-void 
+void
+SystemRenderer::setTilePyramid( std::shared_ptr<TilePyramid> aTilePyramid )
+{
+  mTilePyramid = aTilePyramid;
+}
+
+
+void
+SystemRenderer::setBackgroundCaching( bool aEnabled )
+{
+  mBackgroundCaching = aEnabled;
+  mBackgroundCacheValid = false;
+  if ( !aEnabled )
+    mBackgroundCache.reset();
+}
+
+
+void
 SystemRenderer::createMainAnimation( entt::registry& aRegistry, AssetLoader& aAssetsLoader )
 {
-  std::shared_ptr<sf::Texture> texture = aAssetsLoader.GetTexture( AssetLoader::ASSET_TILEMAP );
-  std::vector<std::vector<AssetLoader::SequenceElement>> sequence = aAssetsLoader.GetMainAnimations( AssetLoader::ASSET_MAIN_ANIMATION );
+  PROFILE_ZONE( "createMainAnimation" );
+  MEMORY_TAG( TAG_ECS );
+
+  createMainAnimationClips( aAssetsLoader );
 
   auto mainEntity = aRegistry.create();
 
   aRegistry.assign<ComponentPositionWorld>( mainEntity, sf::Vector2f( 20.0f, 20.0f ) );
+  aRegistry.assign<ComponentPositionWorldPrevious>( mainEntity, sf::Vector2f( 20.0f, 20.0f ) );
   aRegistry.assign<ComponentMainCharacter>( mainEntity );
-  
-  ComponentSpriteAnimated& componentSpriteAnimated = aRegistry.assign<ComponentSpriteAnimated>( mainEntity );
 
-  // We have 4 directions. 
+  auto& characterAnimation = aRegistry.assign<ComponentCharacterAnimation>( mainEntity );
+  std::copy( mMainAnimationClips.begin(), mMainAnimationClips.end(), characterAnimation.mMoveAnimations.begin() );
+
+  auto& spriteAnimated = aRegistry.assign<ComponentSpriteAnimated>( mainEntity );
+  spriteAnimated.mClip = characterAnimation.mMoveAnimations[characterAnimation.mDirection];
+}
+
+
+void
+SystemRenderer::createMainAnimationClips( AssetLoader& aAssetsLoader )
+{
+  // Clips are built on first use, then shared by every character.
+  if ( !mMainAnimationClips.empty() )
+    return;
+
+  std::shared_ptr<const TileAtlas> atlas = aAssetsLoader.GetAtlas( AssetLoader::ASSET_TILEMAP );
+  mTextures = aAssetsLoader.GetTextureRegistry();
+  const AssetLoader::Animations& sequence = aAssetsLoader.GetMainAnimations( AssetLoader::ASSET_MAIN_ANIMATION );
+
+  // We have 4 directions.
   for ( int directionIndex = 0; directionIndex < ComponentCharacterAnimation::NUM_DIRECTIONS; ++directionIndex )
+    mMainAnimationClips.push_back( mAnimationLibrary->addClip( *atlas, sequence[directionIndex], 1.0f ) );
+}
+
+
+bool
+SystemRenderer::restoreWorld( const Snapshot::Buffer& aSnapshot, entt::registry& aRegistry, AssetLoader& aAssetsLoader )
+{
+  PROFILE_ZONE( "restoreWorld" );
+  MEMORY_TAG( TAG_ECS );
+
+  createMainAnimationClips( aAssetsLoader );
+  mBackgroundCacheValid = false;
+
+  // The paths of a snapshot without its map lie in the map's asset.
+  const TileGridView assetMap = mWorldPager ? TileGridView() : aAssetsLoader.GetMapData( AssetLoader::ASSET_MAP );
+  Snapshot::World world;
+  world.mBackgroundMode = mBackgroundMode;
+  world.mAnimations = mAnimationLibrary.get();
+  world.mMap = mWorldPager ? nullptr : &assetMap;
+
+  TileGrid map;
+  if ( !Snapshot::restore( aSnapshot, aRegistry, aAssetsLoader, world, &map ) )
+    return false;
+
+  if ( mWorldPager )
+    return true;
+
+  if ( map.getSize().x > 0 )
+    mMap.open( std::move( map ) );
+  else
+    mMap.open( assetMap );
+  mAtlas = aAssetsLoader.GetAtlas( AssetLoader::ASSET_TILEMAP );
+  mTextures = aAssetsLoader.GetTextureRegistry();
+
+  // The background entities find their place in the map from their position.
+  const sf::Vector2i mapSize = mMap.getSize();
+  const float tileSize = static_cast<float>( Globals::TILE_SIZE );
+  mBackgroundIndex->clear();
+  mMapEntities.clear();
+
+  if ( mBackgroundMode == BACKGROUND_MODE_CHUNKS )
   {
-    for ( std::size_t seqIndex = 0U; seqIndex < sequence[directionIndex].size(); ++seqIndex )
+    const sf::Vector2i chunkCount( ( mapSize.x + Globals::CHUNK_SIZE - 1 ) / Globals::CHUNK_SIZE, ( mapSize.y + Globals::CHUNK_SIZE - 1 ) / Globals::CHUNK_SIZE );
+    mMapEntities.resize( static_cast<std::size_t>( chunkCount.x ) * chunkCount.y, entt::null );
+
+    auto view = aRegistry.view<ComponentTileChunk>();
+    for ( auto entity : view )
     {
-      auto seqenceElement = std::make_unique<SequenceElement>();
-
-      seqenceElement->mTexture = texture;
-      seqenceElement->mSprite = std::make_unique<sf::Sprite>();
-      seqenceElement->mSprite->setTexture( *seqenceElement->mTexture );
-      seqenceElement->mSprite->setTextureRect( sf::IntRect( 
-        sequence[directionIndex][seqIndex].mSpriteIndex.x * Globals::TILE_SIZE, 
-        sequence[directionIndex][seqIndex].mSpriteIndex.y * Globals::TILE_SIZE, 
-        Globals::TILE_SIZE, 
-        Globals::TILE_SIZE ) );
-      seqenceElement->mSprite->setOrigin( Globals::TILE_SIZE / 2, Globals::TILE_SIZE / 2 );
-
-      componentSpriteAnimated.mSequenceElements.emplace_back( std::move( seqenceElement ) );
+      const sf::VertexArray& vertices = view.get( entity ).mVertices;
+      if ( vertices.getVertexCount() == 0 )
+        return failRestoreWorld();
+
+      // The first quad is the chunk's top left tile, as laid out by createMapChunks().
+      const sf::Vector2f topLeft = vertices[0].position + sf::Vector2f( tileSize / 2, tileSize / 2 );
+      const sf::Vector2i tile( static_cast<int>( std::lround( topLeft.x / tileSize ) ), static_cast<int>( std::lround( topLeft.y / tileSize ) ) );
+      const sf::Vector2i chunk( tile.x / Globals::CHUNK_SIZE, tile.y / Globals::CHUNK_SIZE );
+      if ( !mMap.contains( tile ) || chunk.x >= chunkCount.x || chunk.y >= chunkCount.y )
+        return failRestoreWorld();
+
+      mMapEntities[chunk.y * chunkCount.x + chunk.x] = entity;
+      mBackgroundIndex->insert( entity, tileAreaBounds( sf::IntRect( tile.x, tile.y,
+        std::min( Globals::CHUNK_SIZE, mapSize.x - tile.x ), std::min( Globals::CHUNK_SIZE, mapSize.y - tile.y ) ) ) );
+    }
+  }
+  else
+  {
+    mMapEntities.resize( static_cast<std::size_t>( mapSize.x ) * mapSize.y, entt::null );
+
+    auto view = aRegistry.view<ComponentLayerBackground, ComponentPositionWorld>();
+    for ( auto entity : view )
+    {
+      const sf::Vector2f position = view.get<ComponentPositionWorld>( entity ).mPosition;
+      const sf::Vector2i tile( static_cast<int>( std::lround( position.x ) ), static_cast<int>( std::lround( position.y ) ) );
+      if ( !mMap.contains( tile ) )
+        return failRestoreWorld();
+
+      mMapEntities[static_cast<std::size_t>( tile.y ) * mapSize.x + tile.x] = entity;
+      mBackgroundIndex->insert( entity, tileBounds( position ) );
     }
   }
 
+  // Tile edits dereference every one of them.
+  if ( std::find( mMapEntities.begin(), mMapEntities.end(), entt::entity( entt::null ) ) != mMapEntities.end() )
+    return failRestoreWorld();
+
+  return true;
+}
+
+
+bool
+SystemRenderer::failRestoreWorld()
+{
+  mBackgroundIndex->clear();
+  mMapEntities.clear();
+  return false;
+}
+
+
+Snapshot::World
+SystemRenderer::getSnapshotWorld() const
+{
+  Snapshot::World world;
+  world.mBackgroundMode = mBackgroundMode;
+  world.mAnimations = mAnimationLibrary.get();
+  world.mMap = mWorldPager ? nullptr : &mMap.getView();
+  return world;
+}
+
+
+void
+SystemRenderer::replaceMainAnimation( entt::registry& aRegistry, int aDirection, const TileAtlas& aAtlas, const std::vector<AssetLoader::SequenceElement>& aFrames )
+{
+  assert( aDirection >= 0 && aDirection < static_cast<int>( mMainAnimationClips.size() ) );
 
+  const AnimationClipId clipId = mMainAnimationClips[aDirection];
+  mAnimationLibrary->replaceClip( clipId, aAtlas, aFrames, 1.0f );
+
+  // The clip may be shorter now: wrap the time and find the frame again.
+  const AnimationClip& clip = mAnimationLibrary->getClip( clipId );
+  auto view = aRegistry.view<ComponentSpriteAnimated>();
+  for ( auto entity : view )
+  {
+    ComponentSpriteAnimated& animation = view.get( entity );
+    if ( animation.mClip != clipId )
+      continue;
+
+    animation.mTimeInCurrentLoop -= clip.mDuration * std::floor( animation.mTimeInCurrentLoop * clip.mInverseDuration );
+    animation.mCurrentSequenceElementIndex = mAnimationLibrary->findFrame( clip, animation.mTimeInCurrentLoop );
+  }
 }
@@ -24,30 +24,172 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 #include <entt/entt.hpp>
 
-class AssetLoader;
+#include "AssetLoader.hpp"
+#include "Components.hpp"
+#include "EditableTileMap.hpp"
+#include "Snapshot.hpp"
+
+class AnimationLibrary;
+class JobSystem;
+class SpatialGrid;
+class SpriteBatcher;
+class TextureRegistry;
+class TileAtlas;
+class TilePyramid;
+class WorldPager;
 
 namespace sf
 {
+  class RenderTarget;
+  class RenderTexture;
   class RenderWindow;
+  class Texture;
   class View;
 }
 
 class SystemRenderer
 {
 public:
-  SystemRenderer( std::shared_ptr<sf::RenderWindow> aRenderWindow );
+  enum BackgroundMode
+  {
+    BACKGROUND_MODE_SPRITES, // One entity and one draw call per tile.
+    BACKGROUND_MODE_CHUNKS   // One vertex array and one draw call per CHUNK_SIZE x CHUNK_SIZE tiles.
+  };
+
+  // Counts from the last render() call. Visited items intersected the camera
+  // and were drawn, culled items were skipped by the spatial index. Draw
+  // calls and vertices cover the whole frame. Frames reusing the background
+  // cache visit no background item.
+  struct RenderStats
+  {
+    std::size_t mBackgroundVisited { 0 };
+    std::size_t mBackgroundCulled  { 0 };
+    std::size_t mEntitiesVisited   { 0 };
+    std::size_t mEntitiesCulled    { 0 };
+    std::size_t mDrawCalls         { 0 };
+    std::size_t mVertices          { 0 };
+    bool        mBackgroundRedrawn { false }; // The background cache was redrawn.
+    int         mBackgroundLevel   { 0 };     // The TilePyramid level drawn, 0 for the tiles.
+  };
+
+  // A null window runs headless: the simulation works, render() does nothing.
+  SystemRenderer( std::shared_ptr<sf::RenderWindow> aRenderWindow, BackgroundMode aBackgroundMode = BACKGROUND_MODE_CHUNKS );
+  // Renders offscreen, e.g. for benchmarks on a machine without a display.
+  SystemRenderer( std::shared_ptr<sf::RenderTexture> aRenderTexture, BackgroundMode aBackgroundMode = BACKGROUND_MODE_CHUNKS );
+  ~SystemRenderer();
+
+  // Returns false once the window is closed, or when there is no window.
+  bool processEvents();
 
-  bool render( entt::registry& aRegistry );
+  // aInterpolation is the fraction of a tick elapsed since the last simulation
+  // update: moving entities are drawn between their previous and current position.
+  void render( entt::registry& aRegistry, float aInterpolation = 1.0f );
 
-  void updateAnimation( float aDt, entt::registry& aRegistry );
+  // Run at the start of each tick, before anything moves.
+  void storePreviousPositions( entt::registry& aRegistry );
+
+  // Splits the animations over aJobSystem's threads when one is given.
+  void updateAnimation( float aDt, entt::registry& aRegistry, JobSystem* aJobSystem = nullptr );
 
   void createMap( entt::registry& aRegistry, AssetLoader& aAssetsLoader );
   void createMainAnimation( entt::registry& aRegistry, AssetLoader& aAssetsLoader );
 
+  // Instead of createMap() and createMainAnimation(): builds the animation
+  // clips in the same order, restores aSnapshot into the empty aRegistry and
+  // finds the map's entities among them. The map is the one saved with the
+  // snapshot, or its asset for a snapshot without one. Returns false when
+  // aSnapshot does not fit this world (see Snapshot::restore()); aRegistry
+  // then holds part of it and is to be cleared.
+  bool restoreWorld( const Snapshot::Buffer& aSnapshot, entt::registry& aRegistry, AssetLoader& aAssetsLoader );
+
+  // What the snapshots of this world are taken with: its map is saved unless
+  // it is streamed.
+  Snapshot::World getSnapshotWorld() const;
+
+  // Swaps the frames of the main character's animation in aDirection, e.g.
+  // when its file is reloaded. Characters playing it keep their entities and
+  // their time in the loop.
+  void replaceMainAnimation( entt::registry& aRegistry, int aDirection, const TileAtlas& aAtlas, const std::vector<AssetLoader::SequenceElement>& aFrames );
+
+  // Tile edits on the map built by createMap(). The tiles change at once;
+  // the render data of the edited tiles alone is patched by applyTileEdits(),
+  // which render() calls first. Written tiles must be in the atlas.
+  void setTile( int aX, int aY, TileId aTile );
+  void setTiles( const sf::IntRect& aRegion, const TileGridView& aTiles );
+  void fillTiles( const sf::IntRect& aRegion, TileId aTile );
+  void applyTileEdits( entt::registry& aRegistry );
+
+  // The tiles whose edits the last applyTileEdits() call patched.
+  const std::vector<sf::Vector2i>& getEditedTiles() const { return mEditedTiles; }
+
+  const TileGridView& getMap() const { return mMap.getView(); }
+
+  // Streams the background from a paged world instead of createMap().
+  void setWorldPager( std::shared_ptr<WorldPager> aWorldPager );
+
+  // Draws aTilePyramid's blocks instead of the tiles once the camera is
+  // zoomed out past its first level. It follows the tile edits.
+  void setTilePyramid( std::shared_ptr<TilePyramid> aTilePyramid );
+
+  // Off by default. The background around the camera is drawn once into a
+  // texture, with a margin, and composited in a single draw call every
+  // frame. It is redrawn when the camera leaves the margin, or when tiles
+  // or pages within it change.
+  void setBackgroundCaching( bool aEnabled );
+
+  // The camera follows the main character; its size (zoom) can be changed freely.
+  sf::View& getCamera() { return *mView; }
+
+  const RenderStats& getRenderStats() const { return mRenderStats; }
+
+  AnimationLibrary& getAnimationLibrary() { return *mAnimationLibrary; }
+
 private:
 
-  std::shared_ptr<sf::RenderWindow> mRenderWindow;
-  std::unique_ptr<sf::View>         mView;
+  SystemRenderer( sf::RenderTarget* aRenderTarget, BackgroundMode aBackgroundMode );
+
+  void renderBackground( entt::registry& aRegistry, const sf::FloatRect& aCameraArea );
+  void drawBackground( sf::RenderTarget& aTarget, entt::registry& aRegistry, const sf::FloatRect& aArea );
+  // False when the area around the camera does not fit in a texture.
+  bool updateBackgroundCache( entt::registry& aRegistry, const sf::FloatRect& aCameraArea );
+  void renderCharacters( entt::registry& aRegistry, const sf::FloatRect& aCameraArea, float aInterpolation );
+
+  void createMapSprites( entt::registry& aRegistry, AssetLoader& aAssetsLoader );
+  void createMapChunks( entt::registry& aRegistry, AssetLoader& aAssetsLoader );
+  void createMainAnimationClips( AssetLoader& aAssetsLoader );
+  // Forgets the map's entities found so far, for restoreWorld().
+  bool failRestoreWorld();
+
+  BackgroundMode                     mBackgroundMode;
+  std::shared_ptr<sf::RenderWindow>  mRenderWindow;
+  std::shared_ptr<sf::RenderTexture> mRenderTexture;
+  sf::RenderTarget*                  mRenderTarget; // Whichever of the two is set, or null.
+  std::unique_ptr<sf::View>          mView;
+
+  std::shared_ptr<WorldPager>        mWorldPager;
+  std::shared_ptr<TilePyramid>       mTilePyramid;
+  std::shared_ptr<TextureRegistry>   mTextures; // The AssetLoader's, resolving the components' texture handles.
+
+  EditableTileMap                    mMap;
+  std::shared_ptr<const TileAtlas>   mAtlas;
+  std::vector<entt::entity>          mMapEntities; // Per tile or per chunk, row-major, depending on the background mode.
+  std::vector<sf::Vector2i>          mEditedTiles;
+
+  bool                               mBackgroundCaching { false };
+  bool                               mBackgroundCacheValid { false };
+  std::unique_ptr<sf::RenderTexture> mBackgroundCache;
+  sf::FloatRect                      mBackgroundCacheArea; // In world pixels.
+  std::uint64_t                      mBackgroundCachePages { 0 }; // The pager's loaded page count when it was drawn.
+
+  std::unique_ptr<SpatialGrid>       mBackgroundIndex;
+  std::unique_ptr<SpatialGrid>       mEntityIndex;
+  std::vector<entt::entity>          mVisible;
+  RenderStats                        mRenderStats;
+
+  std::unique_ptr<AnimationLibrary>  mAnimationLibrary;
+  std::unique_ptr<SpriteBatcher>     mSpriteBatcher; // Draws the animated entities.
+  std::vector<AnimationClipId>       mMainAnimationClips;
 };
@@ -0,0 +1,174 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "TextParser.hpp"
+
+#include <cassert>
+#include <cstring>
+#include "MapFile.hpp"
+
+std::string
+TextParser::describe( const std::string& aPath, const Error& aError )
+{
+  if ( aError.mLine == 0 )
+    return aPath + ": " + aError.mMessage;
+
+  return aPath + ":" + std::to_string( aError.mLine ) + ":" + std::to_string( aError.mColumn ) + ": " + aError.mMessage;
+}
+
+
+bool
+TextParser::openFile( const std::string& aPath, MappedFile& aFile, Error* aError )
+{
+  if ( aFile.open( aPath ) )
+    return true;
+
+  // An empty file cannot be mapped either; it holds nothing to parse anyway.
+  if ( aError != nullptr )
+    *aError = Error { 0, 0, "cannot read the file, or it is empty" };
+  return false;
+}
+
+
+bool
+TextParser::Reader::read( int& aValue, int aMinimum )
+{
+  skipSpaces();
+  const char* position = mPosition;
+
+  if ( !read( aValue ) )
+    return false;
+
+  if ( aValue < aMinimum )
+    return fail( position, aMinimum == 0 ? "expected a positive number or zero" : "number too small" );
+
+  return true;
+}
+
+
+bool
+TextParser::Reader::skip( std::size_t aCount )
+{
+  for ( std::size_t i = 0; i < aCount; ++i )
+  {
+    skipSpaces();
+    if ( mPosition == mEnd )
+      return fail( mPosition, "unexpected end of file" );
+
+    while ( mPosition != mEnd && !isSpace( *mPosition ) )
+      ++mPosition;
+  }
+
+  return true;
+}
+
+
+bool
+TextParser::Reader::expectEnd()
+{
+  skipSpaces();
+
+  if ( mPosition != mEnd )
+    return fail( mPosition, "unexpected text after the last value" );
+
+  return true;
+}
+
+
+bool
+TextParser::Reader::fail( const char* aPosition, const char* aMessage )
+{
+  mErrorPosition = aPosition;
+  mErrorMessage  = aMessage;
+  return false;
+}
+
+
+void
+TextParser::Reader::getError( const char* aText, Error& aError ) const
+{
+  assert( mErrorPosition != nullptr );
+
+  // Only done once, on failure: counting lines as we go would slow every read.
+  const char* lineStart = mErrorPosition;
+  while ( lineStart != aText && lineStart[-1] != '\n' )
+    --lineStart;
+
+  aError.mLine    = 1 + static_cast<std::size_t>( std::count( aText, lineStart, '\n' ) );
+  aError.mColumn  = 1 + static_cast<std::size_t>( mErrorPosition - lineStart );
+  aError.mMessage = mErrorMessage;
+}
+
+
+std::size_t
+TextParser::countTokens( const char* aBegin, const char* aEnd )
+{
+  if ( aBegin == aEnd )
+    return 0;
+
+  // A token starts at every non-space following a space. Blocks of a fixed
+  // size, without a branch or a carried state, let the compiler vectorize.
+  const std::size_t BLOCK = 64;
+
+  std::size_t count = isSpace( *aBegin ) ? 0 : 1;
+  const char* character = aBegin + 1;
+
+  for ( ; static_cast<std::size_t>( aEnd - character ) >= BLOCK; character += BLOCK )
+  {
+    unsigned blockCount = 0;
+    for ( std::size_t i = 0; i < BLOCK; ++i )
+      blockCount += isSpace( character[i - 1] ) & !isSpace( character[i] );
+    count += blockCount;
+  }
+
+  for ( ; character != aEnd; ++character )
+    count += isSpace( character[-1] ) & !isSpace( character[0] );
+
+  return count;
+}
+
+
+std::vector<const char*>
+TextParser::splitLines( const char* aBegin, const char* aEnd, std::size_t aMinBytes, std::size_t aMaxRanges )
+{
+  const std::size_t size = static_cast<std::size_t>( aEnd - aBegin );
+  const std::size_t rangeCount = std::max<std::size_t>( 1, std::min( aMaxRanges, size / std::max<std::size_t>( aMinBytes, 1 ) ) );
+
+  std::vector<const char*> boundaries;
+  boundaries.reserve( rangeCount + 1 );
+  boundaries.push_back( aBegin );
+
+  for ( std::size_t range = 1; range < rangeCount; ++range )
+  {
+    // A line longer than a range swallows the next cuts.
+    const char* cut = std::max( aBegin + size / rangeCount * range, boundaries.back() );
+    const void* lineEnd = std::memchr( cut, '\n', static_cast<std::size_t>( aEnd - cut ) );
+    if ( lineEnd == nullptr )
+      break;
+
+    boundaries.push_back( static_cast<const char*>( lineEnd ) + 1 );
+  }
+
+  boundaries.push_back( aEnd );
+  return boundaries;
+}
@@ -0,0 +1,260 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "JobSystem.hpp"
+
+class MappedFile;
+
+// Parser of the text formats (maps, animations): whitespace separated
+// numbers, decoded with std::from_chars straight from a memory mapping of the
+// file. Unlike stream extraction it ignores the locale and copies nothing.
+// Failures are reported with the line and column of the offending token.
+namespace TextParser
+{
+  struct Error
+  {
+    std::size_t mLine { 0 };   // From 1; 0 when the file could not be read at all.
+    std::size_t mColumn { 0 }; // From 1, in bytes.
+    std::string mMessage;
+  };
+
+  // "aPath:line:column: message", the way compilers report errors.
+  std::string describe( const std::string& aPath, const Error& aError );
+
+  // Maps the whole of aPath; fills aError, when given, if it cannot be read.
+  bool openFile( const std::string& aPath, MappedFile& aFile, Error* aError );
+
+  inline bool
+  isSpace( char aCharacter )
+  {
+    // Space, or one of \t \n \v \f \r; no branch, so loops over it vectorize.
+    return ( aCharacter == ' ' ) | ( static_cast<unsigned char>( aCharacter - '\t' ) <= '\r' - '\t' );
+  }
+
+  // Cursor over the numbers of [aBegin, aEnd). Reads fail on a malformed
+  // token or at the end of the text, and remember where and why.
+  class Reader
+  {
+  public:
+    Reader( const char* aBegin, const char* aEnd )
+      : mPosition ( aBegin ), mEnd ( aEnd )
+    {}
+
+    bool read( int& aValue ) { return readNumber( aValue, "expected an integer" ); }
+    bool read( float& aValue ) { return readNumber( aValue, "expected a number" ); }
+
+    // Also fails on values below aMinimum, e.g. negative sizes.
+    bool read( int& aValue, int aMinimum );
+
+    // Moves to the start of the next token, e.g. to fail on it once read.
+    void skipSpaces()
+    {
+      while ( mPosition != mEnd && isSpace( *mPosition ) )
+        ++mPosition;
+    }
+
+    // Skips aCount tokens, whatever they hold; false when the text ends first.
+    bool skip( std::size_t aCount );
+
+    // Fails on anything but whitespace left in the text.
+    bool expectEnd();
+
+    bool fail( const char* aPosition, const char* aMessage );
+
+    const char* getPosition() const { return mPosition; }
+    const char* getEnd() const { return mEnd; }
+
+    // Copies the last failure into aError, located in the text starting at aText.
+    void getError( const char* aText, Error& aError ) const;
+
+  private:
+    template<typename T>
+    bool readNumber( T& aValue, const char* aMessage );
+
+    const char* mPosition;
+    const char* mEnd;
+    const char* mErrorPosition { nullptr };
+    const char* mErrorMessage { nullptr };
+  };
+
+  // Tokens in [aBegin, aEnd), good or bad, as a Reader would cut them.
+  std::size_t countTokens( const char* aBegin, const char* aEnd );
+
+  // Cuts [aBegin, aEnd) right after line ends into at most aMaxRanges ranges
+  // of about aMinBytes or more. Returns the boundaries, aBegin and aEnd
+  // included, so there is always at least one range.
+  std::vector<const char*> splitLines( const char* aBegin, const char* aEnd, std::size_t aMinBytes, std::size_t aMaxRanges );
+
+  // Reads aGroupCount groups of GROUP integers from aReader, passing each to
+  // aStore( group index, values ), and expects nothing after them. aStore
+  // returns null, or why it rejects the values: the read then fails on the
+  // first of them. With a job system, a long text is cut at line ends into
+  // ranges parsed in parallel, so aStore is called concurrently for
+  // different groups.
+  template<int GROUP, typename Store>
+  bool readGroups( Reader& aReader, std::size_t aGroupCount, JobSystem* aJobSystem, Store aStore );
+
+  // Below this, waking other threads costs more than parsing.
+  const std::size_t MIN_RANGE_BYTES = 256 * 1024;
+  const std::size_t RANGES_PER_THREAD = 4;
+}
+
+
+template<typename T>
+inline bool
+TextParser::Reader::readNumber( T& aValue, const char* aMessage )
+{
+  skipSpaces();
+
+  if ( mPosition == mEnd )
+    return fail( mPosition, "unexpected end of file" );
+
+  const std::from_chars_result result = std::from_chars( mPosition, mEnd, aValue );
+
+  if ( result.ec == std::errc::result_out_of_range )
+    return fail( mPosition, "number out of range" );
+
+  // "12ab" is not 12 followed by a token.
+  if ( result.ec != std::errc() || ( result.ptr != mEnd && !isSpace( *result.ptr ) ) )
+    return fail( mPosition, aMessage );
+
+  mPosition = result.ptr;
+  return true;
+}
+
+
+template<int GROUP, typename Store>
+bool
+TextParser::readGroups( Reader& aReader, std::size_t aGroupCount, JobSystem* aJobSystem, Store aStore )
+{
+  const char* end = aReader.getEnd();
+  // With a single thread, counting the tokens first would only add a pass.
+  const std::size_t maxRanges = aJobSystem == nullptr || aJobSystem->getThreadCount() == 0 ? 1 : ( aJobSystem->getThreadCount() + 1 ) * RANGES_PER_THREAD;
+  const std::vector<const char*> ranges = splitLines( aReader.getPosition(), end, MIN_RANGE_BYTES, maxRanges );
+  const std::size_t rangeCount = ranges.size() - 1;
+
+  if ( rangeCount == 1 )
+  {
+    int values[GROUP];
+    for ( std::size_t group = 0; group < aGroupCount; ++group )
+    {
+      aReader.skipSpaces();
+      const char* groupStart = aReader.getPosition();
+
+      for ( int i = 0; i < GROUP; ++i )
+      {
+        if ( !aReader.read( values[i] ) )
+          return false;
+      }
+
+      if ( const char* rejection = aStore( group, values ) )
+        return aReader.fail( groupStart, rejection );
+    }
+    return aReader.expectEnd();
+  }
+
+  // Ranges are cut at line ends, not between groups: count the tokens of
+  // each first to know which groups start in which range.
+  std::vector<std::size_t> firstTokens( rangeCount + 1, 0 );
+  aJobSystem->parallelFor( rangeCount, 1,
+    [&ranges, &firstTokens]( std::size_t aBegin, std::size_t aEnd )
+    {
+      for ( std::size_t range = aBegin; range < aEnd; ++range )
+        firstTokens[range + 1] = countTokens( ranges[range], ranges[range + 1] );
+    } );
+
+  for ( std::size_t range = 0; range < rangeCount; ++range )
+    firstTokens[range + 1] += firstTokens[range];
+
+  // Each range reads the groups starting in it, reading on into the next
+  // range to finish its last one. Failures are kept per range: the first
+  // failing range holds the first error of the text.
+  std::vector<Reader> readers( rangeCount, Reader( end, end ) );
+  std::vector<char> failed( rangeCount, 0 );
+  aJobSystem->parallelFor( rangeCount, 1,
+    [&]( std::size_t aBegin, std::size_t aEnd )
+    {
+      int values[GROUP];
+
+      for ( std::size_t range = aBegin; range < aEnd; ++range )
+      {
+        const std::size_t firstGroup = std::min( ( firstTokens[range] + GROUP - 1 ) / GROUP, aGroupCount );
+        const std::size_t lastGroup = std::min( ( firstTokens[range + 1] + GROUP - 1 ) / GROUP, aGroupCount );
+        if ( firstGroup == lastGroup )
+          continue;
+
+        Reader& reader = readers[range];
+        reader = Reader( ranges[range], end );
+        reader.skip( firstGroup * GROUP - firstTokens[range] );
+
+        for ( std::size_t group = firstGroup; group < lastGroup && !failed[range]; ++group )
+        {
+          reader.skipSpaces();
+          const char* groupStart = reader.getPosition();
+
+          for ( int i = 0; i < GROUP && !failed[range]; ++i )
+            failed[range] = !reader.read( values[i] );
+
+          if ( failed[range] )
+            break;
+
+          if ( const char* rejection = aStore( group, values ) )
+            failed[range] = !reader.fail( groupStart, rejection );
+        }
+      }
+    } );
+
+  for ( std::size_t range = 0; range < rangeCount; ++range )
+  {
+    if ( failed[range] )
+    {
+      aReader = readers[range];
+      return false;
+    }
+  }
+
+  // Every group read: what is left is either nothing, or the tokens after
+  // the last one.
+  const std::size_t valueCount = aGroupCount * GROUP;
+  const std::size_t tokenCount = firstTokens[rangeCount];
+
+  if ( tokenCount < valueCount )
+  {
+    aReader = Reader( end, end );
+    return aReader.fail( end, "unexpected end of file" );
+  }
+
+  const std::size_t lastRange = std::upper_bound( firstTokens.begin(), firstTokens.end() - 1, valueCount ) - firstTokens.begin() - 1;
+  aReader = Reader( ranges[lastRange], end );
+  aReader.skip( valueCount - firstTokens[lastRange] );
+  return aReader.expectEnd();
+}
@@ -0,0 +1,69 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "Components.hpp"
+
+// Textures by handle, so components refer to them with a small integer
+// instead of owning a pointer. Handles are never reused, and handle 0
+// (NO_TEXTURE) stands for no texture.
+class TextureRegistry
+{
+public:
+  TextureRegistry() : mTextures( 1 ) {}
+
+  // Registering a texture twice returns its first handle.
+  TextureHandle add( std::shared_ptr<sf::Texture> aTexture )
+  {
+    if ( !aTexture )
+      return NO_TEXTURE;
+
+    auto found = std::find( mTextures.begin(), mTextures.end(), aTexture );
+    if ( found != mTextures.end() )
+      return static_cast<TextureHandle>( found - mTextures.begin() );
+
+    assert( mTextures.size() <= MAX_TEXTURE_HANDLE );
+    mTextures.push_back( std::move( aTexture ) );
+    return static_cast<TextureHandle>( mTextures.size() - 1 );
+  }
+
+  // Null for NO_TEXTURE.
+  const sf::Texture* get( TextureHandle aHandle ) const
+  {
+    assert( aHandle < mTextures.size() );
+    return mTextures[aHandle].get();
+  }
+
+  std::size_t size() const { return mTextures.size() - 1; }
+
+private:
+  std::vector<std::shared_ptr<sf::Texture>> mTextures;
+};
@@ -0,0 +1,75 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+#include "Profiler.hpp"
+
+ThreadPool::ThreadPool( unsigned aThreadCount )
+{
+  if ( aThreadCount == 0 )
+    aThreadCount = std::max( 2u, std::thread::hardware_concurrency() ) - 1;
+
+  for ( unsigned i = 0; i < aThreadCount; ++i )
+    mWorkers.emplace_back( &ThreadPool::workerLoop, this );
+}
+
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock( mMutex );
+    mStopping = true;
+  }
+  mCondition.notify_all();
+
+  for ( auto& worker : mWorkers )
+    worker.join();
+}
+
+
+void
+ThreadPool::workerLoop()
+{
+  Profiler::setThreadName( "pool worker" );
+
+  for ( ;; )
+  {
+    std::function<void()> task;
+
+    {
+      std::unique_lock<std::mutex> lock( mMutex );
+      mCondition.wait( lock, [this]() { return mStopping || !mTasks.empty(); } );
+
+      if ( mTasks.empty() )
+        return;
+
+      task = std::move( mTasks.front() );
+      mTasks.pop_front();
+    }
+
+    task();
+  }
+}
@@ -0,0 +1,76 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running tasks in submission order. Meant for
+// blocking work (file reads, decoding) that should stay off the render thread.
+class ThreadPool
+{
+public:
+  // 0 uses one thread per hardware thread, minus the render thread.
+  explicit ThreadPool( unsigned aThreadCount = 0 );
+
+  // Runs every task already submitted, then joins the workers.
+  ~ThreadPool();
+
+  ThreadPool( const ThreadPool& ) = delete;
+  ThreadPool& operator=( const ThreadPool& ) = delete;
+
+  template<typename Task>
+  auto submit( Task&& aTask ) -> std::future<decltype( aTask() )>
+  {
+    typedef decltype( aTask() ) Result;
+
+    auto packagedTask = std::make_shared<std::packaged_task<Result()>>( std::forward<Task>( aTask ) );
+    std::future<Result> future = packagedTask->get_future();
+
+    {
+      std::lock_guard<std::mutex> lock( mMutex );
+      mTasks.emplace_back( [packagedTask]() { ( *packagedTask )(); } );
+    }
+    mCondition.notify_one();
+
+    return future;
+  }
+
+  unsigned getThreadCount() const { return static_cast<unsigned>( mWorkers.size() ); }
+
+private:
+  void workerLoop();
+
+  std::vector<std::thread>          mWorkers;
+  std::deque<std::function<void()>> mTasks;
+  std::mutex                        mMutex;
+  std::condition_variable           mCondition;
+  bool                              mStopping { false };
+};
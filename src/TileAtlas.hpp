@@ -0,0 +1,78 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <cassert>
+#include <memory>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "Components.hpp"
+#include "GlobalDefs.hpp"
+#include "TileGrid.hpp"
+
+// Where each tile sits in a texture. A default constructed atlas has the
+// layout of tilemap_packed.png: every tile of the tileset in place, with no
+// spacing. Packed atlases (see AtlasPacker) only hold the tiles they were
+// built from, each at its own position.
+class TileAtlas
+{
+public:
+  TileAtlas() = default;
+  TileAtlas( std::shared_ptr<sf::Texture> aTexture, TextureHandle aTextureHandle, std::vector<sf::Vector2i> aTilePositions )
+    : mTexture ( std::move( aTexture ) ), mTextureHandle ( aTextureHandle ), mTilePositions ( std::move( aTilePositions ) )
+  {}
+
+  const std::shared_ptr<sf::Texture>& getTexture() const { return mTexture; }
+
+  // The texture's handle in the TextureRegistry of the AssetLoader that built the atlas.
+  TextureHandle getTextureHandle() const { return mTextureHandle; }
+
+  bool contains( TileId aTile ) const
+  {
+    return mTilePositions.empty() || ( aTile < mTilePositions.size() && mTilePositions[aTile].x >= 0 );
+  }
+
+  // Top left pixel of aTile in the texture.
+  sf::Vector2i getTilePosition( TileId aTile ) const
+  {
+    if ( mTilePositions.empty() )
+      return tileSpriteIndex( aTile ) * Globals::TILE_SIZE;
+
+    // A tile missing from the atlas was not referenced when it was packed.
+    assert( contains( aTile ) );
+    return mTilePositions[aTile];
+  }
+
+  sf::IntRect getTileRect( TileId aTile ) const
+  {
+    return sf::IntRect( getTilePosition( aTile ), sf::Vector2i( Globals::TILE_SIZE, Globals::TILE_SIZE ) );
+  }
+
+private:
+  std::shared_ptr<sf::Texture> mTexture;
+  TextureHandle                mTextureHandle { NO_TEXTURE };
+  std::vector<sf::Vector2i>    mTilePositions; // Indexed by TileId, x < 0 for tiles not packed.
+};
@@ -0,0 +1,128 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "GlobalDefs.hpp"
+
+// Index of a tile in the tileset, counted row by row.
+typedef std::uint16_t TileId;
+
+inline sf::Vector2i
+tileSpriteIndex( TileId aTileId )
+{
+  return { aTileId % Globals::TILESET_COLUMNS, aTileId / Globals::TILESET_COLUMNS };
+}
+
+inline TileId
+tileIdFromSpriteIndex( sf::Vector2i aSpriteIndex )
+{
+  return static_cast<TileId>( aSpriteIndex.y * Globals::TILESET_COLUMNS + aSpriteIndex.x );
+}
+
+// Files give sprite indices; anything outside the tileset would wrap into a
+// wrong TileId.
+inline bool
+isInTileset( sf::Vector2i aSpriteIndex )
+{
+  return aSpriteIndex.x >= 0 && aSpriteIndex.x < Globals::TILESET_COLUMNS
+    && aSpriteIndex.y >= 0 && aSpriteIndex.y < Globals::TILESET_ROWS;
+}
+
+inline bool
+isInTileset( TileId aTileId )
+{
+  return aTileId < Globals::TILESET_COLUMNS * Globals::TILESET_ROWS;
+}
+
+// Non-owning, read-only view of a rectangle of tiles. Rows are mStride tiles
+// apart, so a region of a larger grid is viewed without copying it.
+class TileGridView
+{
+public:
+  TileGridView() = default;
+  TileGridView( const TileId* aTiles, sf::Vector2i aSize, int aStride )
+    : mTiles ( aTiles ), mSize ( aSize ), mStride ( aStride )
+  {}
+
+  sf::Vector2i getSize() const { return mSize; }
+  int getStride() const { return mStride; }
+
+  const TileId* row( int aY ) const
+  {
+    assert( aY >= 0 && aY < mSize.y );
+    return mTiles + static_cast<std::size_t>( aY ) * mStride;
+  }
+
+  TileId at( int aX, int aY ) const
+  {
+    assert( aX >= 0 && aX < mSize.x );
+    return row( aY )[aX];
+  }
+
+  TileGridView region( const sf::IntRect& aRect ) const
+  {
+    assert( aRect.left >= 0 && aRect.top >= 0 );
+    assert( aRect.left + aRect.width <= mSize.x && aRect.top + aRect.height <= mSize.y );
+    return TileGridView( mTiles + static_cast<std::size_t>( aRect.top ) * mStride + aRect.left, { aRect.width, aRect.height }, mStride );
+  }
+
+private:
+  const TileId* mTiles { nullptr };
+  sf::Vector2i  mSize;
+  int           mStride { 0 };
+};
+
+// Owning, contiguous row-major storage of a map's tiles.
+class TileGrid
+{
+public:
+  TileGrid() = default;
+  explicit TileGrid( sf::Vector2i aSize ) { resize( aSize ); }
+
+  void resize( sf::Vector2i aSize )
+  {
+    mSize = aSize;
+    mTiles.assign( static_cast<std::size_t>( aSize.x ) * aSize.y, 0 );
+  }
+
+  sf::Vector2i getSize() const { return mSize; }
+
+  TileId* data() { return mTiles.data(); }
+  const TileId* data() const { return mTiles.data(); }
+
+  TileId& at( int aX, int aY ) { return mTiles[static_cast<std::size_t>( aY ) * mSize.x + aX]; }
+  TileId at( int aX, int aY ) const { return mTiles[static_cast<std::size_t>( aY ) * mSize.x + aX]; }
+
+  TileGridView getView() const { return TileGridView( mTiles.data(), mSize, mSize.x ); }
+
+private:
+  sf::Vector2i        mSize;
+  std::vector<TileId> mTiles;
+};
@@ -0,0 +1,605 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "TilePyramid.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "Hash.hpp"
+#include "MapFile.hpp"
+#include "MemoryTracker.hpp"
+#include "Profiler.hpp"
+#include "TileQuads.hpp"
+
+namespace
+{
+  const char          CACHE_MAGIC[4] = { 'R', 'P', 'G', 'L' };
+  const std::uint16_t CACHE_VERSION  = 1;
+
+  struct CacheHeader
+  {
+    char          mMagic[4];
+    std::uint16_t mVersion;
+    std::uint16_t mTileSize;
+    std::uint16_t mFirstLevel;
+    std::uint16_t mLastLevel;
+    std::uint32_t mBlockPixels;
+    std::int32_t  mMapWidth;
+    std::int32_t  mMapHeight; // Followed by the blocks of each level, finest first, row-major.
+  };
+  static_assert( sizeof( CacheHeader ) == 24, "TilePyramid cache header layout changed." );
+
+  // Every tile of the tileset, packed edge to edge: only their pixels are read.
+  std::vector<TileId> allTiles()
+  {
+    std::vector<TileId> tiles( Globals::TILESET_COLUMNS * Globals::TILESET_ROWS );
+    for ( std::size_t tile = 0; tile < tiles.size(); ++tile )
+      tiles[tile] = static_cast<TileId>( tile );
+    return tiles;
+  }
+
+  AtlasPacker::Settings packSettings()
+  {
+    AtlasPacker::Settings settings;
+    settings.mGutter    = 0;
+    settings.mExtrusion = 0;
+    return settings;
+  }
+
+  // Averages the aFactor x aFactor squares of aSource, aSize pixels square
+  // with rows of aSourceStride pixels, into aDestination with rows of
+  // aDestinationStride pixels.
+  void downsample( const std::uint8_t* aSource, int aSourceStride, int aSize, int aFactor, std::uint8_t* aDestination, int aDestinationStride )
+  {
+    const int area = aFactor * aFactor;
+    const int size = aSize / aFactor;
+
+    for ( int y = 0; y < size; ++y )
+    {
+      for ( int x = 0; x < size; ++x )
+      {
+        int sum[4] = { 0, 0, 0, 0 };
+        for ( int sy = 0; sy < aFactor; ++sy )
+        {
+          const std::uint8_t* source = aSource + ( static_cast<std::size_t>( y * aFactor + sy ) * aSourceStride + x * aFactor ) * 4;
+          for ( int sx = 0; sx < aFactor * 4; ++sx )
+            sum[sx & 3] += source[sx];
+        }
+
+        std::uint8_t* destination = aDestination + ( static_cast<std::size_t>( y ) * aDestinationStride + x ) * 4;
+        for ( int channel = 0; channel < 4; ++channel )
+          destination[channel] = static_cast<std::uint8_t>( ( sum[channel] + area / 2 ) / area );
+      }
+    }
+  }
+}
+
+TilePyramid::TilePyramid( const TileGridView& aMap, const AtlasPacker::Source& aTiles, const std::string& aCacheDirectory, const Settings& aSettings )
+  : mSettings ( aSettings )
+  , mSource ( aTiles )
+  , mCacheDirectory ( aCacheDirectory )
+  , mTiles ( aMap.getSize() )
+  , mPool ( std::make_unique<ThreadPool>( 1 ) )
+{
+  // A tile keeps a pixel at least, and a block holds whole tiles.
+  assert( mSettings.mFirstLevel >= 1 && ( Globals::TILE_SIZE >> mSettings.mFirstLevel ) >= 1 );
+  assert( mSettings.mBlockPixels > 0 && mSettings.mBlockPixels % Globals::TILE_SIZE == 0 );
+
+  const sf::Vector2i size = aMap.getSize();
+  for ( int y = 0; y < size.y; ++y )
+    std::copy( aMap.row( y ), aMap.row( y ) + size.x, mTiles.data() + static_cast<std::size_t>( y ) * size.x );
+
+  mLastLevel = mSettings.mFirstLevel;
+  while ( getBlockCount( mLastLevel ).x > 1 || getBlockCount( mLastLevel ).y > 1 )
+    ++mLastLevel;
+  mLevels.resize( mLastLevel - mSettings.mFirstLevel + 1 );
+
+  mPool->submit( [this]() { build(); } );
+}
+
+
+TilePyramid::~TilePyramid()
+{
+  // A build still running stops at its next block.
+  mCancelled = true;
+  mPool.reset();
+}
+
+
+int
+TilePyramid::selectLevel( float aWorldPixelsPerPixel )
+{
+  if ( aWorldPixelsPerPixel < static_cast<float>( 1 << mSettings.mFirstLevel ) )
+    return -1;
+
+  const int wanted = std::min( mLastLevel, static_cast<int>( std::floor( std::log2( aWorldPixelsPerPixel ) ) ) );
+
+  std::lock_guard<std::mutex> lock( mMutex );
+  for ( int level = wanted; level >= mSettings.mFirstLevel; --level )
+  {
+    if ( mLevels[level - mSettings.mFirstLevel] )
+      return level;
+  }
+
+  return -1;
+}
+
+
+std::size_t
+TilePyramid::draw( sf::RenderTarget& aTarget, const sf::FloatRect& aArea, int aLevel, std::size_t* aVertices )
+{
+  PROFILE_ZONE( "draw tile pyramid" );
+  MEMORY_TAG( TAG_RENDER );
+
+  assert( aLevel >= mSettings.mFirstLevel && aLevel <= mLastLevel );
+  ++mFrame;
+
+  std::shared_ptr<const Level> level;
+  {
+    std::lock_guard<std::mutex> lock( mMutex );
+    level = mLevels[aLevel - mSettings.mFirstLevel];
+  }
+  if ( !level )
+    return 0;
+
+  // Tiles are centered on their position: the map starts half a tile up and left.
+  const int   tiles     = getTilesPerBlock( aLevel );
+  const float blockSize = static_cast<float>( tiles * Globals::TILE_SIZE );
+  const float origin    = -Globals::TILE_SIZE / 2.0f;
+  const int   left      = std::max( 0, static_cast<int>( std::floor( ( aArea.left - origin ) / blockSize ) ) );
+  const int   top       = std::max( 0, static_cast<int>( std::floor( ( aArea.top - origin ) / blockSize ) ) );
+  const int   right     = std::min( level->mBlocks.x, static_cast<int>( std::ceil( ( aArea.left + aArea.width - origin ) / blockSize ) ) );
+  const int   bottom    = std::min( level->mBlocks.y, static_cast<int>( std::ceil( ( aArea.top + aArea.height - origin ) / blockSize ) ) );
+
+  const unsigned    blockPixels = static_cast<unsigned>( mSettings.mBlockPixels );
+  const std::size_t blockBytes  = static_cast<std::size_t>( blockPixels ) * blockPixels * 4;
+  const float       texels      = static_cast<float>( blockPixels );
+
+  std::size_t drawn    = 0;
+  std::size_t uploaded = 0;
+
+  for ( int y = top; y < bottom; ++y )
+  {
+    for ( int x = left; x < right; ++x )
+    {
+      const std::size_t index = static_cast<std::size_t>( y ) * level->mBlocks.x + x;
+      const std::shared_ptr<const Pixels>& pixels = level->mPixels[index];
+
+      const BlockKey key( aLevel, index );
+      auto inserted = mTextures.try_emplace( key );
+      BlockTexture& block = inserted.first->second;
+      if ( inserted.second )
+        block.mDrawOrder = mDrawOrder.insert( mDrawOrder.end(), key );
+      else
+        mDrawOrder.splice( mDrawOrder.end(), mDrawOrder, block.mDrawOrder );
+
+      // Uploaded on first sight, and again once rebuilt after an edit.
+      if ( block.mPixels != pixels )
+      {
+        if ( !block.mPixels )
+        {
+          if ( !block.mTexture.create( blockPixels, blockPixels ) )
+          {
+            assert( false );
+            mDrawOrder.erase( block.mDrawOrder );
+            mTextures.erase( inserted.first );
+            continue;
+          }
+          block.mTexture.setSmooth( true );
+          mTextureBytes += blockBytes;
+        }
+
+        block.mTexture.update( pixels->data() );
+        block.mPixels = pixels;
+        ++uploaded;
+      }
+      block.mLastDrawnFrame = mFrame;
+
+      const sf::FloatRect bounds = tileAreaBounds( sf::IntRect( x * tiles, y * tiles, tiles, tiles ) );
+      const sf::Vertex quad[4] =
+      {
+        sf::Vertex( sf::Vector2f( bounds.left,                bounds.top ),                 sf::Vector2f( 0.0f,   0.0f ) ),
+        sf::Vertex( sf::Vector2f( bounds.left + bounds.width, bounds.top ),                 sf::Vector2f( texels, 0.0f ) ),
+        sf::Vertex( sf::Vector2f( bounds.left + bounds.width, bounds.top + bounds.height ), sf::Vector2f( texels, texels ) ),
+        sf::Vertex( sf::Vector2f( bounds.left,                bounds.top + bounds.height ), sf::Vector2f( 0.0f,   texels ) )
+      };
+      aTarget.draw( quad, 4, sf::Quads, sf::RenderStates( &block.mTexture ) );
+      ++drawn;
+    }
+  }
+
+  if ( aVertices != nullptr )
+    *aVertices += drawn * 4;
+
+  // The least recently drawn go first, never the ones on screen.
+  while ( mTextureBytes > mSettings.mTextureCap && !mDrawOrder.empty() )
+  {
+    auto oldest = mTextures.find( mDrawOrder.front() );
+    if ( oldest->second.mLastDrawnFrame == mFrame )
+      break;
+
+    mTextures.erase( oldest );
+    mDrawOrder.pop_front();
+    mTextureBytes -= blockBytes;
+  }
+
+  std::lock_guard<std::mutex> lock( mMutex );
+  mStats.mTextureBytes    = mTextureBytes;
+  mStats.mBlocksUploaded += uploaded;
+  return drawn;
+}
+
+
+void
+TilePyramid::updateTiles( const TileGridView& aMap, const std::vector<sf::Vector2i>& aTiles )
+{
+  if ( aTiles.empty() )
+    return;
+
+  assert( aMap.getSize() == mTiles.getSize() );
+
+  std::vector<std::pair<sf::Vector2i, TileId>> edits;
+  edits.reserve( aTiles.size() );
+  for ( const sf::Vector2i& tile : aTiles )
+    edits.emplace_back( tile, aMap.at( tile.x, tile.y ) );
+
+  mPool->submit( [this, edits = std::move( edits )]() { rebuild( edits ); } );
+}
+
+
+void
+TilePyramid::waitIdle()
+{
+  // The single worker runs its jobs in order.
+  mPool->submit( []() {} ).wait();
+}
+
+
+TilePyramid::Stats
+TilePyramid::getStats()
+{
+  std::lock_guard<std::mutex> lock( mMutex );
+  return mStats;
+}
+
+
+void
+TilePyramid::build()
+{
+  PROFILE_ZONE( "build tile pyramid" );
+  MEMORY_TAG( TAG_RENDER );
+
+  sf::Clock clock;
+
+  Hash hash;
+  hash.add( CACHE_VERSION );
+  hash.add( Globals::TILE_SIZE );
+  hash.add( mSettings.mFirstLevel );
+  hash.add( mSettings.mBlockPixels );
+  hash.add( mTiles.getSize().x );
+  hash.add( mTiles.getSize().y );
+  hash.add( mTiles.data(), static_cast<std::size_t>( mTiles.getSize().x ) * mTiles.getSize().y * sizeof( TileId ) );
+  hash.add( AtlasPacker::hashInputs( mSource, allTiles(), packSettings() ) );
+
+  char name[32];
+  std::snprintf( name, sizeof( name ), "pyramid_%016llx.bin", static_cast<unsigned long long>( hash.get() ) );
+  const std::string cachePath = ( std::filesystem::path( mCacheDirectory ) / name ).string();
+
+  if ( readCache( cachePath ) )
+  {
+    std::lock_guard<std::mutex> lock( mMutex );
+    mStats.mFromCache = true;
+    mStats.mBuildTime = clock.getElapsedTime();
+    return;
+  }
+
+  if ( !packTiles() )
+  {
+    assert( false );
+    return;
+  }
+
+  std::shared_ptr<const Level> finer;
+  for ( int level = mSettings.mFirstLevel; level <= mLastLevel; ++level )
+  {
+    auto blocks = std::make_shared<Level>();
+    blocks->mBlocks = getBlockCount( level );
+    blocks->mPixels.resize( static_cast<std::size_t>( blocks->mBlocks.x ) * blocks->mBlocks.y );
+
+    for ( int y = 0; y < blocks->mBlocks.y; ++y )
+    {
+      for ( int x = 0; x < blocks->mBlocks.x; ++x )
+      {
+        if ( mCancelled )
+          return;
+
+        blocks->mPixels[static_cast<std::size_t>( y ) * blocks->mBlocks.x + x] = finer
+          ? buildBlock( *finer, sf::Vector2i( x, y ) )
+          : buildFirstLevelBlock( sf::Vector2i( x, y ) );
+      }
+    }
+
+    finer = blocks;
+    publish( level, std::move( blocks ) );
+  }
+
+  {
+    std::lock_guard<std::mutex> lock( mMutex );
+    mStats.mBuildTime = clock.getElapsedTime();
+  }
+
+  writeCache( cachePath );
+}
+
+
+bool
+TilePyramid::packTiles()
+{
+  PROFILE_ZONE( "pack tile pyramid tiles" );
+
+  const std::vector<TileId> tiles = allTiles();
+  AtlasPacker::Packed packed;
+  if ( !AtlasPacker::pack( mSource, tiles, packSettings(), packed ) )
+    return false;
+
+  const int factor      = 1 << mSettings.mFirstLevel;
+  const int tilePixels  = Globals::TILE_SIZE / factor;
+  const int atlasStride = static_cast<int>( packed.mImage.getSize().x );
+  const std::uint8_t* atlas = packed.mImage.getPixelsPtr();
+
+  mTileImages.assign( tiles.size(), Pixels() );
+  for ( TileId tile : tiles )
+  {
+    const sf::Vector2i position = packed.mTilePositions[tile];
+    Pixels& image = mTileImages[tile];
+    image.resize( static_cast<std::size_t>( tilePixels ) * tilePixels * 4 );
+    downsample( atlas + ( static_cast<std::size_t>( position.y ) * atlasStride + position.x ) * 4, atlasStride, Globals::TILE_SIZE, factor, image.data(), tilePixels );
+  }
+
+  return true;
+}
+
+
+std::shared_ptr<const TilePyramid::Pixels>
+TilePyramid::buildFirstLevelBlock( sf::Vector2i aBlock ) const
+{
+  const int blockPixels = mSettings.mBlockPixels;
+  const int tiles       = getTilesPerBlock( mSettings.mFirstLevel );
+  const int tilePixels  = Globals::TILE_SIZE >> mSettings.mFirstLevel;
+
+  auto pixels = std::make_shared<Pixels>( static_cast<std::size_t>( blockPixels ) * blockPixels * 4, 0 );
+
+  const sf::Vector2i first( aBlock.x * tiles, aBlock.y * tiles );
+  const sf::Vector2i last( std::min( first.x + tiles, mTiles.getSize().x ), std::min( first.y + tiles, mTiles.getSize().y ) );
+
+  for ( int y = first.y; y < last.y; ++y )
+  {
+    for ( int x = first.x; x < last.x; ++x )
+    {
+      const TileId tile = mTiles.at( x, y );
+      if ( tile >= mTileImages.size() )
+        continue;
+
+      const Pixels& image = mTileImages[tile];
+      std::uint8_t* destination = pixels->data() + ( static_cast<std::size_t>( y - first.y ) * tilePixels * blockPixels + ( x - first.x ) * tilePixels ) * 4;
+      for ( int row = 0; row < tilePixels; ++row )
+        std::memcpy( destination + static_cast<std::size_t>( row ) * blockPixels * 4, image.data() + row * tilePixels * 4, tilePixels * 4 );
+    }
+  }
+
+  return pixels;
+}
+
+
+std::shared_ptr<const TilePyramid::Pixels>
+TilePyramid::buildBlock( const Level& aFinerLevel, sf::Vector2i aBlock ) const
+{
+  const int blockPixels = mSettings.mBlockPixels;
+  const int half        = blockPixels / 2;
+
+  auto pixels = std::make_shared<Pixels>( static_cast<std::size_t>( blockPixels ) * blockPixels * 4, 0 );
+
+  // Each of the four finer blocks fills a quarter, those beyond the map stay transparent.
+  for ( int quarter = 0; quarter < 4; ++quarter )
+  {
+    const sf::Vector2i child( aBlock.x * 2 + quarter % 2, aBlock.y * 2 + quarter / 2 );
+    if ( child.x >= aFinerLevel.mBlocks.x || child.y >= aFinerLevel.mBlocks.y )
+      continue;
+
+    const Pixels& source = *aFinerLevel.mPixels[static_cast<std::size_t>( child.y ) * aFinerLevel.mBlocks.x + child.x];
+    std::uint8_t* destination = pixels->data() + ( static_cast<std::size_t>( quarter / 2 ) * half * blockPixels + ( quarter % 2 ) * half ) * 4;
+    downsample( source.data(), blockPixels, blockPixels, 2, destination, blockPixels );
+  }
+
+  return pixels;
+}
+
+
+void
+TilePyramid::rebuild( const std::vector<std::pair<sf::Vector2i, TileId>>& aEdits )
+{
+  PROFILE_ZONE( "rebuild tile pyramid" );
+  MEMORY_TAG( TAG_RENDER );
+
+  // Levels read from the cache left the tiles unpacked until now.
+  if ( mTileImages.empty() && !packTiles() )
+  {
+    assert( false );
+    return;
+  }
+
+  const int tiles = getTilesPerBlock( mSettings.mFirstLevel );
+  std::vector<sf::Vector2i> blocks;
+  for ( const auto& edit : aEdits )
+  {
+    mTiles.at( edit.first.x, edit.first.y ) = edit.second;
+    blocks.push_back( sf::Vector2i( edit.first.x / tiles, edit.first.y / tiles ) );
+  }
+
+  std::uint64_t rebuilt = 0;
+  std::shared_ptr<const Level> finer;
+  for ( int level = mSettings.mFirstLevel; level <= mLastLevel; ++level )
+  {
+    // Only the worker writes the levels: it reads them without the lock.
+    const std::shared_ptr<const Level>& current = mLevels[level - mSettings.mFirstLevel];
+    if ( !current )
+      return;
+
+    std::sort( blocks.begin(), blocks.end(), []( sf::Vector2i aLeft, sf::Vector2i aRight )
+    {
+      return aLeft.y < aRight.y || ( aLeft.y == aRight.y && aLeft.x < aRight.x );
+    } );
+    blocks.erase( std::unique( blocks.begin(), blocks.end() ), blocks.end() );
+
+    // Copies of the other blocks' pointers: cheap, and drawn meanwhile.
+    auto updated = std::make_shared<Level>( *current );
+    for ( sf::Vector2i& block : blocks )
+    {
+      updated->mPixels[static_cast<std::size_t>( block.y ) * updated->mBlocks.x + block.x] = finer
+        ? buildBlock( *finer, block )
+        : buildFirstLevelBlock( block );
+      ++rebuilt;
+
+      block = sf::Vector2i( block.x / 2, block.y / 2 );
+    }
+
+    finer = updated;
+    publish( level, std::move( updated ) );
+  }
+
+  std::lock_guard<std::mutex> lock( mMutex );
+  mStats.mBlocksRebuilt += rebuilt;
+}
+
+
+bool
+TilePyramid::readCache( const std::string& aPath )
+{
+  MappedFile file;
+  if ( !file.open( aPath ) || file.getSize() < sizeof( CacheHeader ) )
+    return false;
+
+  CacheHeader header;
+  std::memcpy( &header, file.getData(), sizeof( header ) );
+  if ( std::memcmp( header.mMagic, CACHE_MAGIC, sizeof( CACHE_MAGIC ) ) != 0
+    || header.mVersion != CACHE_VERSION
+    || header.mTileSize != Globals::TILE_SIZE
+    || header.mFirstLevel != mSettings.mFirstLevel
+    || header.mLastLevel != mLastLevel
+    || header.mBlockPixels != static_cast<std::uint32_t>( mSettings.mBlockPixels )
+    || header.mMapWidth != mTiles.getSize().x
+    || header.mMapHeight != mTiles.getSize().y )
+    return false;
+
+  const std::size_t blockBytes = static_cast<std::size_t>( mSettings.mBlockPixels ) * mSettings.mBlockPixels * 4;
+  std::size_t blockCount = 0;
+  for ( int level = mSettings.mFirstLevel; level <= mLastLevel; ++level )
+    blockCount += static_cast<std::size_t>( getBlockCount( level ).x ) * getBlockCount( level ).y;
+  if ( file.getSize() != sizeof( header ) + blockCount * blockBytes )
+    return false;
+
+  const std::uint8_t* data = static_cast<const std::uint8_t*>( file.getData() ) + sizeof( header );
+  for ( int level = mSettings.mFirstLevel; level <= mLastLevel; ++level )
+  {
+    auto blocks = std::make_shared<Level>();
+    blocks->mBlocks = getBlockCount( level );
+    blocks->mPixels.resize( static_cast<std::size_t>( blocks->mBlocks.x ) * blocks->mBlocks.y );
+    for ( auto& pixels : blocks->mPixels )
+    {
+      pixels = std::make_shared<Pixels>( data, data + blockBytes );
+      data += blockBytes;
+    }
+
+    publish( level, std::move( blocks ) );
+  }
+
+  return true;
+}
+
+
+bool
+TilePyramid::writeCache( const std::string& aPath ) const
+{
+  CacheHeader header;
+  std::memcpy( header.mMagic, CACHE_MAGIC, sizeof( CACHE_MAGIC ) );
+  header.mVersion     = CACHE_VERSION;
+  header.mTileSize    = static_cast<std::uint16_t>( Globals::TILE_SIZE );
+  header.mFirstLevel  = static_cast<std::uint16_t>( mSettings.mFirstLevel );
+  header.mLastLevel   = static_cast<std::uint16_t>( mLastLevel );
+  header.mBlockPixels = static_cast<std::uint32_t>( mSettings.mBlockPixels );
+  header.mMapWidth    = mTiles.getSize().x;
+  header.mMapHeight   = mTiles.getSize().y;
+
+  // Written aside then renamed, so a reader never sees a partial file.
+  std::error_code error;
+  std::filesystem::create_directories( std::filesystem::path( aPath ).parent_path(), error );
+
+  const std::string temporaryPath = aPath + ".tmp";
+  {
+    std::ofstream writer( temporaryPath, std::ios::binary );
+    if ( !writer.is_open() )
+      return false;
+
+    writer.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+    for ( const auto& level : mLevels )
+    {
+      for ( const auto& pixels : level->mPixels )
+        writer.write( reinterpret_cast<const char*>( pixels->data() ), static_cast<std::streamsize>( pixels->size() ) );
+    }
+    if ( writer.fail() )
+      return false;
+  }
+
+  std::filesystem::rename( temporaryPath, aPath, error );
+  return !error;
+}
+
+
+void
+TilePyramid::publish( int aLevel, std::shared_ptr<const Level> aBlocks )
+{
+  const std::size_t bytes = aBlocks->mPixels.size() * static_cast<std::size_t>( mSettings.mBlockPixels ) * mSettings.mBlockPixels * 4;
+
+  std::lock_guard<std::mutex> lock( mMutex );
+  std::shared_ptr<const Level>& level = mLevels[aLevel - mSettings.mFirstLevel];
+  if ( !level )
+  {
+    ++mStats.mLevelsReady;
+    mStats.mBytes += bytes;
+  }
+  level = std::move( aBlocks );
+}
+
+
+sf::Vector2i
+TilePyramid::getBlockCount( int aLevel ) const
+{
+  const int tiles = getTilesPerBlock( aLevel );
+  return sf::Vector2i( ( mTiles.getSize().x + tiles - 1 ) / tiles, ( mTiles.getSize().y + tiles - 1 ) / tiles );
+}
@@ -0,0 +1,160 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "AtlasPacker.hpp"
+#include "GlobalDefs.hpp"
+#include "ThreadPool.hpp"
+#include "TileGrid.hpp"
+
+// Level-of-detail images of a map's background, drawn instead of its tiles
+// once the camera is zoomed out far enough. Level L halves the resolution L
+// times: it is cut into square blocks of mBlockPixels, each covering
+// mBlockPixels << L world pixels. The first level is made of the tiles,
+// downsampled; each level above averages four blocks of the one below, up
+// to a level of a single block. Whatever the zoom, a view then draws about
+// as many blocks as a screen holds.
+//
+// Levels are built on a worker thread, finest first, and become drawable
+// one at a time. They are cached on disk as raw pixels, named after a hash
+// of the map, the tile images and the settings, so a warm start reads one
+// file. Block textures are made for the blocks drawn only, and the least
+// recently drawn are released past mTextureCap.
+class TilePyramid
+{
+public:
+  struct Settings
+  {
+    int         mFirstLevel  { 2 };   // From 1 to log2( TILE_SIZE ), so a tile keeps a pixel at least.
+    int         mBlockPixels { 256 }; // A multiple of TILE_SIZE.
+    std::size_t mTextureCap  { 64u * 1024u * 1024u }; // Bytes of block textures.
+  };
+
+  struct Stats
+  {
+    int           mLevelsReady    { 0 };
+    bool          mFromCache      { false };
+    sf::Time      mBuildTime;           // Or the read time, from the cache.
+    std::size_t   mBytes          { 0 }; // Block pixels of the levels built.
+    std::size_t   mTextureBytes   { 0 };
+    std::uint64_t mBlocksUploaded { 0 };
+    std::uint64_t mBlocksRebuilt  { 0 }; // After tile edits.
+  };
+
+  // Starts building from a copy of aMap's tiles, with the tile images of
+  // aTiles (every tile of the tileset is packed, so edits may use any).
+  TilePyramid( const TileGridView& aMap, const AtlasPacker::Source& aTiles, const std::string& aCacheDirectory, const Settings& aSettings );
+  ~TilePyramid();
+
+  int getFirstLevel() const { return mSettings.mFirstLevel; }
+  int getLastLevel() const { return mLastLevel; }
+
+  // The level to draw when a screen pixel covers aWorldPixelsPerPixel world
+  // pixels: the one matching the zoom, or the closest finer level built so
+  // far. -1 when the tiles should be drawn instead.
+  int selectLevel( float aWorldPixelsPerPixel );
+
+  // Render thread. Draws the blocks of aLevel intersecting aArea (in world
+  // pixels), one call each, and returns how many. Adds their vertices to
+  // aVertices when given.
+  std::size_t draw( sf::RenderTarget& aTarget, const sf::FloatRect& aArea, int aLevel, std::size_t* aVertices = nullptr );
+
+  // The blocks holding aTiles are rebuilt from aMap in the background; the
+  // old ones are drawn until then.
+  void updateTiles( const TileGridView& aMap, const std::vector<sf::Vector2i>& aTiles );
+
+  // Blocks until the jobs submitted so far are done.
+  void waitIdle();
+
+  Stats getStats();
+
+private:
+  typedef std::vector<std::uint8_t> Pixels; // RGBA, mBlockPixels squared.
+
+  struct Level
+  {
+    sf::Vector2i mBlocks;
+    std::vector<std::shared_ptr<const Pixels>> mPixels; // Row-major. Shared with the later copies of the level.
+  };
+
+  typedef std::pair<int, std::size_t> BlockKey; // Level and block.
+
+  struct BlockTexture
+  {
+    std::shared_ptr<const Pixels> mPixels; // Uploaded into mTexture.
+    sf::Texture   mTexture;
+    std::uint64_t mLastDrawnFrame { 0 };
+    std::list<BlockKey>::iterator mDrawOrder; // Its place in mDrawOrder.
+  };
+
+  // Worker side.
+  void build();
+  bool packTiles();
+  std::shared_ptr<const Pixels> buildFirstLevelBlock( sf::Vector2i aBlock ) const;
+  std::shared_ptr<const Pixels> buildBlock( const Level& aFinerLevel, sf::Vector2i aBlock ) const;
+  void rebuild( const std::vector<std::pair<sf::Vector2i, TileId>>& aEdits );
+  bool readCache( const std::string& aPath );
+  bool writeCache( const std::string& aPath ) const;
+  void publish( int aLevel, std::shared_ptr<const Level> aBlocks );
+
+  int getTilesPerBlock( int aLevel ) const { return ( mSettings.mBlockPixels << aLevel ) / Globals::TILE_SIZE; }
+  sf::Vector2i getBlockCount( int aLevel ) const;
+
+  Settings            mSettings;
+  int                 mLastLevel { 0 };
+  AtlasPacker::Source mSource;
+  std::string         mCacheDirectory;
+
+  // Only touched by the worker once built.
+  TileGrid            mTiles;
+  std::vector<Pixels> mTileImages; // Indexed by TileId, each downsampled to the first level.
+  std::atomic<bool>   mCancelled { false };
+
+  // Indexed by level minus the first level, null until built. Written by
+  // the worker, read by both threads; guarded by mMutex with mStats.
+  std::vector<std::shared_ptr<const Level>> mLevels;
+  Stats      mStats;
+  std::mutex mMutex;
+
+  // Render thread.
+  std::map<BlockKey, BlockTexture> mTextures;
+  std::list<BlockKey> mDrawOrder; // Least recently drawn first, for eviction.
+  std::size_t   mTextureBytes { 0 };
+  std::uint64_t mFrame { 0 };
+
+  // Runs build() and rebuild(), which write the levels above. The destructor
+  // cancels a running build before joining it.
+  std::unique_ptr<ThreadPool> mPool;
+};
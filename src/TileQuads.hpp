@@ -0,0 +1,55 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include "GlobalDefs.hpp"
+
+// Writes the quad of the tile at aTile (in tiles, world space) into the 4
+// vertices starting at aVertices, textured from aTexturePosition (the top
+// left pixel of the tile in its atlas). The quad is centered on the tile
+// position, matching the origin used by the per-tile sprites.
+inline void
+setTileQuad( sf::Vertex* aVertices, sf::Vector2i aTile, sf::Vector2i aTexturePosition )
+{
+  const float size = static_cast<float>( Globals::TILE_SIZE );
+  const float left = aTile.x * size - size / 2;
+  const float top  = aTile.y * size - size / 2;
+  const float u    = static_cast<float>( aTexturePosition.x );
+  const float v    = static_cast<float>( aTexturePosition.y );
+
+  aVertices[0] = sf::Vertex( sf::Vector2f( left,        top ),        sf::Vector2f( u,        v ) );
+  aVertices[1] = sf::Vertex( sf::Vector2f( left + size, top ),        sf::Vector2f( u + size, v ) );
+  aVertices[2] = sf::Vertex( sf::Vector2f( left + size, top + size ), sf::Vector2f( u + size, v + size ) );
+  aVertices[3] = sf::Vertex( sf::Vector2f( left,        top + size ), sf::Vector2f( u,        v + size ) );
+}
+
+// World pixel bounds of the tiles in aTiles (in tiles, world space).
+inline sf::FloatRect
+tileAreaBounds( const sf::IntRect& aTiles )
+{
+  const float size = static_cast<float>( Globals::TILE_SIZE );
+  return sf::FloatRect( aTiles.left * size - size / 2, aTiles.top * size - size / 2, aTiles.width * size, aTiles.height * size );
+}
@@ -0,0 +1,266 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "WorldPager.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+
+#include "GlobalDefs.hpp"
+#include "MemoryTracker.hpp"
+#include "TileQuads.hpp"
+
+WorldPager::WorldPager( const std::string& aDirectory, const Settings& aSettings, std::shared_ptr<const TileAtlas> aAtlas )
+  : mDirectory ( aDirectory )
+  , mSettings ( aSettings )
+  , mAtlas ( aAtlas )
+  , mPool ( std::make_unique<ThreadPool>( 2 ) )
+{
+  if ( !MapFile::readWorld( mDirectory, mWorld ) )
+  {
+    assert( false );
+    mWorld = MapFile::WorldInfo();
+  }
+}
+
+
+WorldPager::~WorldPager()
+{
+  // Let the workers finish before the state they write to goes away.
+  mPool.reset();
+}
+
+
+void
+WorldPager::update( const sf::FloatRect& aCameraArea )
+{
+  if ( !isOpen() )
+    return;
+
+  ++mFrame;
+
+  std::vector<std::shared_ptr<Page>> loaded;
+  {
+    std::lock_guard<std::mutex> lock( mLoadedMutex );
+    loaded.swap( mLoaded );
+  }
+
+  for ( auto& page : loaded )
+  {
+    const std::pair<int, int> key( page->mCoordinates.x, page->mCoordinates.y );
+    mPending.erase( key );
+
+    ++mStats.mPagesLoaded;
+    mTotalLoadLatency += page->mLoadLatency;
+    mStats.mLastLoadLatency    = page->mLoadLatency;
+    mStats.mMaxLoadLatency     = std::max( mStats.mMaxLoadLatency, page->mLoadLatency );
+    mStats.mAverageLoadLatency = sf::microseconds( mTotalLoadLatency.asMicroseconds() / static_cast<sf::Int64>( mStats.mPagesLoaded ) );
+
+    page->mLastVisibleFrame = mFrame;
+    mStats.mResidentBytes += page->mBytes;
+    mResident[key] = std::move( page );
+  }
+
+  // Pages are about the same size: the radius is the widest whose pages
+  // would fit the cap at the resident pages' average.
+  int radius = mSettings.mResidencyRadius;
+  if ( !mResident.empty() )
+  {
+    const std::size_t pageBytes = mStats.mResidentBytes / mResident.size();
+    for ( ; radius > 0; --radius )
+    {
+      const sf::IntRect pages = pagesAround( aCameraArea, radius );
+      if ( static_cast<std::size_t>( pages.width ) * static_cast<std::size_t>( pages.height ) * pageBytes <= mSettings.mMemoryCap )
+        break;
+    }
+  }
+  mStats.mResidencyRadius = radius;
+
+  const sf::IntRect visible  = pagesAround( aCameraArea, 0 );
+  const sf::IntRect needed   = pagesAround( aCameraArea, radius );
+  const sf::IntRect retained = pagesAround( aCameraArea, radius + 1 );
+
+  for ( int y = needed.top; y < needed.top + needed.height; ++y )
+  {
+    for ( int x = needed.left; x < needed.left + needed.width; ++x )
+    {
+      const std::pair<int, int> key( x, y );
+
+      if ( auto page = mResident.find( key );
+        page != mResident.end() )
+      {
+        if ( visible.contains( x, y ) )
+          page->second->mLastVisibleFrame = mFrame;
+        continue;
+      }
+
+      if ( mPending.count( key ) > 0 )
+        continue;
+
+      ++mStats.mPageFaults;
+      mPending.insert( key );
+
+      const sf::Vector2i coordinates( x, y );
+      const auto requestTime = std::chrono::steady_clock::now();
+      mPool->submit( [this, coordinates, requestTime]() 
+      {
+        std::shared_ptr<Page> page = loadPage( coordinates, requestTime );
+
+        std::lock_guard<std::mutex> lock( mLoadedMutex );
+        mLoaded.push_back( std::move( page ) );
+      } );
+    }
+  }
+
+  // Pages out of the radius go first; one extra page of slack avoids
+  // reloading the same pages when the camera moves back and forth on a border.
+  for ( auto page = mResident.begin(); page != mResident.end(); )
+  {
+    auto next = std::next( page );
+    if ( !retained.contains( page->second->mCoordinates ) )
+      evict( page );
+    page = next;
+  }
+
+  // Then the least recently visible ones, never the needed ones: they would
+  // be loaded again on the next frame. Those left over the cap shrink the
+  // radius on the next frame.
+  while ( mStats.mResidentBytes > mSettings.mMemoryCap )
+  {
+    auto oldest = mResident.end();
+    for ( auto page = mResident.begin(); page != mResident.end(); ++page )
+    {
+      if ( !needed.contains( page->second->mCoordinates )
+        && ( oldest == mResident.end() || page->second->mLastVisibleFrame < oldest->second->mLastVisibleFrame ) )
+        oldest = page;
+    }
+
+    if ( oldest == mResident.end() )
+      break;
+
+    evict( oldest );
+  }
+
+  mStats.mResidentPages = mResident.size();
+  mStats.mPendingPages  = mPending.size();
+}
+
+
+std::size_t
+WorldPager::draw( sf::RenderTarget& aTarget, const sf::FloatRect& aCameraArea, std::size_t* aVertices )
+{
+  std::size_t drawn = 0;
+
+  for ( const auto& page : mResident )
+  {
+    if ( !page.second->mBounds.intersects( aCameraArea ) )
+      continue;
+
+    aTarget.draw( page.second->mVertices, sf::RenderStates( mAtlas->getTexture().get() ) );
+    ++drawn;
+
+    if ( aVertices != nullptr )
+      *aVertices += page.second->mVertices.getVertexCount();
+  }
+
+  return drawn;
+}
+
+
+std::shared_ptr<WorldPager::Page>
+WorldPager::loadPage( sf::Vector2i aCoordinates, std::chrono::steady_clock::time_point aRequestTime ) const
+{
+  MEMORY_TAG( TAG_RENDER );
+
+  auto page = std::make_shared<Page>();
+  page->mCoordinates = aCoordinates;
+
+  MappedFile file;
+  TileGrid grid;
+  TileGridView tiles;
+
+  if ( MapFile::openBinary( MapFile::getPagePath( mDirectory, aCoordinates ), file, grid, tiles ) )
+  {
+    const sf::Vector2i origin = aCoordinates * mWorld.mPageSize;
+    const sf::Vector2i size   = tiles.getSize();
+
+    page->mVertices.setPrimitiveType( sf::Quads );
+    page->mVertices.resize( static_cast<std::size_t>( size.x ) * size.y * 4 );
+
+    for ( int y = 0; y < size.y; ++y )
+    {
+      const TileId* row = tiles.row( y );
+
+      for ( int x = 0; x < size.x; ++x )
+        setTileQuad( &page->mVertices[( static_cast<std::size_t>( y ) * size.x + x ) * 4], origin + sf::Vector2i( x, y ), mAtlas->getTilePosition( row[x] ) );
+    }
+
+    page->mBounds = tileAreaBounds( sf::IntRect( origin, size ) );
+    page->mBytes  = page->mVertices.getVertexCount() * sizeof( sf::Vertex );
+  }
+  else
+  {
+    // A missing page is drawn empty rather than requested again every frame.
+    std::cerr << "Cannot read " << MapFile::getPagePath( mDirectory, aCoordinates ) << ", or it is not a valid binary map" << std::endl;
+  }
+
+  const auto latency = std::chrono::steady_clock::now() - aRequestTime;
+  page->mLoadLatency = sf::microseconds( std::chrono::duration_cast<std::chrono::microseconds>( latency ).count() );
+
+  return page;
+}
+
+
+sf::IntRect
+WorldPager::pagesAround( const sf::FloatRect& aCameraArea, int aRadius ) const
+{
+  // Tiles are centered on their position, see setTileQuad.
+  const float tileSize = static_cast<float>( Globals::TILE_SIZE );
+  const float pageSize = tileSize * mWorld.mPageSize;
+  const float offset   = tileSize / 2;
+
+  const int pagesWide = ( mWorld.mSize.x + mWorld.mPageSize - 1 ) / mWorld.mPageSize;
+  const int pagesHigh = ( mWorld.mSize.y + mWorld.mPageSize - 1 ) / mWorld.mPageSize;
+
+  const int left   = std::max( 0, static_cast<int>( std::floor( ( aCameraArea.left + offset ) / pageSize ) ) - aRadius );
+  const int top    = std::max( 0, static_cast<int>( std::floor( ( aCameraArea.top + offset ) / pageSize ) ) - aRadius );
+  const int right  = std::min( pagesWide - 1, static_cast<int>( std::floor( ( aCameraArea.left + aCameraArea.width + offset ) / pageSize ) ) + aRadius );
+  const int bottom = std::min( pagesHigh - 1, static_cast<int>( std::floor( ( aCameraArea.top + aCameraArea.height + offset ) / pageSize ) ) + aRadius );
+
+  return sf::IntRect( left, top, std::max( 0, right - left + 1 ), std::max( 0, bottom - top + 1 ) );
+}
+
+
+void
+WorldPager::evict( std::map<std::pair<int, int>, std::shared_ptr<Page>>::iterator aPage )
+{
+  mStats.mResidentBytes -= aPage->second->mBytes;
+  ++mStats.mPagesEvicted;
+
+  // Releasing a page frees its vertices; do it off the render thread.
+  mPool->submit( [page = std::move( aPage->second )]() mutable { page.reset(); } );
+
+  mResident.erase( aPage );
+}
@@ -0,0 +1,120 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "MapFile.hpp"
+#include "ThreadPool.hpp"
+#include "TileAtlas.hpp"
+
+// Streams the background of a paged world (see MapFile::WorldInfo) around
+// the camera. Pages within the residency radius are read and turned into
+// vertex arrays on worker threads; update() only picks up finished pages and
+// never waits for one. Pages out of the radius are evicted, and so are the
+// least recently visible ones while the memory cap is exceeded. Pages within
+// the radius are never evicted: the radius shrinks instead while they would
+// not fit the cap.
+class WorldPager
+{
+public:
+  struct Settings
+  {
+    int         mResidencyRadius { 1 };                  // In pages, around the pages the camera sees.
+    std::size_t mMemoryCap       { 64u * 1024u * 1024u }; // Bytes of resident render data.
+  };
+
+  struct Stats
+  {
+    std::size_t   mResidentPages  { 0 };
+    std::size_t   mResidentBytes  { 0 };
+    std::size_t   mPendingPages   { 0 };
+    int           mResidencyRadius { 0 }; // In use, below the setting when the cap is tight.
+    std::uint64_t mPageFaults     { 0 }; // Pages needed but not resident.
+    std::uint64_t mPagesLoaded    { 0 };
+    std::uint64_t mPagesEvicted   { 0 };
+    sf::Time      mLastLoadLatency;
+    sf::Time      mAverageLoadLatency;
+    sf::Time      mMaxLoadLatency;
+  };
+
+  // Pages are textured from aAtlas, which must hold every tile of the world.
+  WorldPager( const std::string& aDirectory, const Settings& aSettings, std::shared_ptr<const TileAtlas> aAtlas );
+  ~WorldPager();
+
+  bool isOpen() const { return mWorld.mPageSize > 0; }
+  sf::Vector2i getWorldSize() const { return mWorld.mSize; }
+
+  // Render thread, once per frame, with the camera rectangle in world pixels.
+  void update( const sf::FloatRect& aCameraArea );
+
+  // Draws the resident pages intersecting aCameraArea, one call each. Returns
+  // how many were drawn, and adds their vertices to aVertices when given.
+  std::size_t draw( sf::RenderTarget& aTarget, const sf::FloatRect& aCameraArea, std::size_t* aVertices = nullptr );
+
+  const Stats& getStats() const { return mStats; }
+
+private:
+  struct Page
+  {
+    sf::Vector2i    mCoordinates;
+    sf::FloatRect   mBounds;
+    sf::VertexArray mVertices;
+    std::size_t     mBytes { 0 };
+    sf::Time        mLoadLatency;
+    std::uint64_t   mLastVisibleFrame { 0 };
+  };
+
+  std::shared_ptr<Page> loadPage( sf::Vector2i aCoordinates, std::chrono::steady_clock::time_point aRequestTime ) const;
+  sf::IntRect pagesAround( const sf::FloatRect& aCameraArea, int aRadius ) const;
+  void evict( std::map<std::pair<int, int>, std::shared_ptr<Page>>::iterator aPage );
+
+  std::string         mDirectory;
+  Settings            mSettings;
+  std::shared_ptr<const TileAtlas> mAtlas;
+  MapFile::WorldInfo  mWorld;
+  Stats               mStats;
+  std::uint64_t       mFrame { 0 };
+  sf::Time            mTotalLoadLatency;
+
+  std::map<std::pair<int, int>, std::shared_ptr<Page>> mResident;
+  std::set<std::pair<int, int>>                        mPending;
+
+  // Pages finished by the workers, waiting for update() to pick them up.
+  std::vector<std::shared_ptr<Page>> mLoaded;
+  std::mutex                         mLoadedMutex;
+
+  // Loads pages into mLoaded and frees evicted ones; joined by the destructor
+  // before mLoaded goes.
+  std::unique_ptr<ThreadPool> mPool;
+};
@@ -21,6 +21,12 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * SOFTWARE.
  */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <utility>
 #include <entt/entt.hpp>
 #include <SFML/Graphics.hpp>
 
@@ -28,35 +34,353 @@
 #include "Components.hpp"
 #include "Systems.hpp"
 #include "AssetLoader.hpp"
+#include "FrameDriver.hpp"
+#include "HotReloader.hpp"
+#include "JobSystem.hpp"
+#include "MemoryTracker.hpp"
+#include "Pathfinder.hpp"
+#include "Profiler.hpp"
+#include "Scheduler.hpp"
+#include "Snapshot.hpp"
+#include "SystemMovement.hpp"
+#include "TilePyramid.hpp"
+#include "WorldPager.hpp"
 
 
+namespace
+{
+  // Tiles drawn by the map and the animations: the only ones worth packing.
+  std::vector<TileId> referencedTiles( const TileGridView& aMap, const AssetLoader::Animations& aAnimations )
+  {
+    std::vector<bool> used( Globals::TILESET_COLUMNS * Globals::TILESET_ROWS, false );
+    std::size_t outside = 0;
+
+    for ( int y = 0; y < aMap.getSize().y; ++y )
+    {
+      const TileId* row = aMap.row( y );
+      for ( int x = 0; x < aMap.getSize().x; ++x )
+      {
+        if ( isInTileset( row[x] ) )
+          used[row[x]] = true;
+        else
+          ++outside;
+      }
+    }
+
+    for ( const auto& animation : aAnimations )
+    {
+      for ( const auto& frame : animation )
+      {
+        if ( isInTileset( frame.mSpriteIndex ) )
+          used[tileIdFromSpriteIndex( frame.mSpriteIndex )] = true;
+        else
+          ++outside;
+      }
+    }
+
+    // The loaders reject them; only a map handed over some other way gets here.
+    if ( outside > 0 )
+      std::cerr << outside << " tiles are outside the tileset and will not be drawn" << std::endl;
+
+    std::vector<TileId> tiles;
+    for ( std::size_t tile = 0; tile < used.size(); ++tile )
+    {
+      if ( used[tile] )
+        tiles.push_back( static_cast<TileId>( tile ) );
+    }
+    return tiles;
+  }
+
+  const sf::Time AUTOSAVE_PERIOD = sf::seconds( 10.0f );
+
+  // Saves the world at aPath as a full snapshot, then as deltas against it
+  // in aPath.delta until they grow past half of it.
+  void autosave( const std::string& aPath, entt::registry& aRegistry, const AssetLoader& aAssetsLoader, const Snapshot::World& aWorld, Snapshot::Buffer& aBase )
+  {
+    Snapshot::Buffer current;
+    Snapshot::save( aRegistry, aAssetsLoader, current, aWorld );
+
+    Snapshot::Buffer delta;
+    if ( !aBase.empty() )
+      Snapshot::diff( aBase, current, delta );
+
+    // The delta goes before its base is replaced, so that no crash leaves it
+    // next to a base it was not made against. A base not written is kept.
+    bool written = false;
+    if ( aBase.empty() || delta.size() > aBase.size() / 2 )
+    {
+      std::remove( ( aPath + ".delta" ).c_str() );
+      written = Snapshot::writeFile( aPath, current );
+      if ( written )
+        aBase.swap( current );
+    }
+    else
+      written = Snapshot::writeFile( aPath + ".delta", delta );
+
+    if ( !written )
+      std::cerr << "Could not write " << aPath << std::endl;
+  }
 
+  // The snapshot at aPath, with its delta applied when there is one.
+  bool readSnapshot( const std::string& aPath, Snapshot::Buffer& aSnapshot )
+  {
+    if ( !Snapshot::readFile( aPath, aSnapshot ) )
+      return false;
 
+    Snapshot::Buffer delta;
+    return !Snapshot::readFile( aPath + ".delta", delta ) || Snapshot::patch( aSnapshot, delta );
+  }
+}
 
-int main()
+
+int main( int argc, char** argv )
 {
+  // --sprites selects the per-tile background path, to compare against the chunked one.
+  // --cache-background draws the background into a texture, redrawn only when it changes.
+  // --world <directory> streams a paged world (see MapConverter --pages) instead of map.txt.
+  // --headless <seconds> runs the simulation alone, as fast as possible, and reports ticks per second.
+  // --fps <cap> limits the frame rate, --vsync syncs it to the display instead.
+  // --profile <trace.json> records the profiler zones, prints their statistics on exit and
+  // exports them as a Chrome trace.
+  // --wander sends the main character along paths to random tiles, one after another.
+  // --autosave <file> saves the world there every few seconds and on exit, --restore <file>
+  // starts from such a save instead of a new world.
+  // --lod draws pre-rendered, downsampled blocks of the map instead of its tiles when zoomed
+  // out (the mouse wheel zooms), --zoom <factor> sets the initial zoom.
+  // --memory <report.json> writes the memory used by each subsystem, pool and asset on exit.
+  SystemRenderer::BackgroundMode backgroundMode = SystemRenderer::BACKGROUND_MODE_CHUNKS;
+  const char* worldDirectory = nullptr;
+  FrameDriver::Settings frameSettings;
+  bool verticalSync = false;
+  const char* tracePath = nullptr;
+  bool wander = false;
+  bool cacheBackground = false;
+  const char* autosavePath = nullptr;
+  const char* restorePath = nullptr;
+  const char* memoryPath = nullptr;
+  bool lod = false;
+  float zoom = 1.0f;
+  for ( int i = 1; i < argc; ++i )
+  {
+    if ( std::strcmp( argv[i], "--sprites" ) == 0 )
+      backgroundMode = SystemRenderer::BACKGROUND_MODE_SPRITES;
+    else if ( std::strcmp( argv[i], "--world" ) == 0 && i + 1 < argc )
+      worldDirectory = argv[++i];
+    else if ( std::strcmp( argv[i], "--headless" ) == 0 && i + 1 < argc )
+    {
+      frameSettings.mHeadless = true;
+      frameSettings.mHeadlessDuration = sf::seconds( static_cast<float>( std::atof( argv[++i] ) ) );
+    }
+    else if ( std::strcmp( argv[i], "--fps" ) == 0 && i + 1 < argc )
+      frameSettings.mFrameRateCap = static_cast<unsigned>( std::atoi( argv[++i] ) );
+    else if ( std::strcmp( argv[i], "--vsync" ) == 0 )
+      verticalSync = true;
+    else if ( std::strcmp( argv[i], "--profile" ) == 0 && i + 1 < argc )
+      tracePath = argv[++i];
+    else if ( std::strcmp( argv[i], "--wander" ) == 0 )
+      wander = true;
+    else if ( std::strcmp( argv[i], "--cache-background" ) == 0 )
+      cacheBackground = true;
+    else if ( std::strcmp( argv[i], "--autosave" ) == 0 && i + 1 < argc )
+      autosavePath = argv[++i];
+    else if ( std::strcmp( argv[i], "--restore" ) == 0 && i + 1 < argc )
+      restorePath = argv[++i];
+    else if ( std::strcmp( argv[i], "--memory" ) == 0 && i + 1 < argc )
+      memoryPath = argv[++i];
+    else if ( std::strcmp( argv[i], "--lod" ) == 0 )
+      lod = true;
+    else if ( std::strcmp( argv[i], "--zoom" ) == 0 && i + 1 < argc )
+      zoom = static_cast<float>( std::atof( argv[++i] ) );
+  }
 
-  std::shared_ptr<sf::RenderWindow> renderWindow = std::make_shared<sf::RenderWindow>( sf::VideoMode( 200, 200 ), "RPG test" );
+  Profiler::setThreadName( "main" );
+  Profiler::setEnabled( tracePath != nullptr );
 
-  SystemRenderer systemRenderer( renderWindow );
+  std::shared_ptr<sf::RenderWindow> renderWindow;
+  if ( !frameSettings.mHeadless )
+  {
+    renderWindow = std::make_shared<sf::RenderWindow>( sf::VideoMode( 200, 200 ), "RPG test" );
+    renderWindow->setVerticalSyncEnabled( verticalSync );
+  }
+
+  SystemRenderer systemRenderer( renderWindow, backgroundMode );
+  systemRenderer.setBackgroundCaching( cacheBackground );
+  if ( zoom > 0.0f )
+    systemRenderer.getCamera().zoom( zoom );
+
+  // Declared before everything that runs jobs on it, loads included.
+  JobSystem jobSystem;
   auto assetsLoader = std::make_unique<AssetLoader>();
+  assetsLoader->SetJobSystem( &jobSystem );
+  assetsLoader->SetHeadless( frameSettings.mHeadless );
 
   entt::registry registry;
 
-  systemRenderer.createMap( registry, *assetsLoader );
-  systemRenderer.createMainAnimation( registry, *assetsLoader );
+  // Start every load at once so they decode in parallel, then wait once.
+  if ( worldDirectory == nullptr )
+    assetsLoader->RequestMap( AssetLoader::ASSET_MAP );
+  assetsLoader->RequestMainAnimations( AssetLoader::ASSET_MAIN_ANIMATION );
+  assetsLoader->WaitAll();
+
+  // The errors are printed already; nothing runs without the map or the animations.
+  if ( !assetsLoader->GetLoadError( AssetLoader::ASSET_MAP ).empty()
+    || !assetsLoader->GetLoadError( AssetLoader::ASSET_MAIN_ANIMATION ).empty() )
+    return 1;
+
+  // The atlas packs only the tiles in use; a streamed world may use any of
+  // them. Headless, there is no texture to pack.
+  if ( worldDirectory == nullptr && !frameSettings.mHeadless )
+  {
+    assetsLoader->RequestAtlas( AssetLoader::ASSET_TILEMAP, referencedTiles(
+      assetsLoader->GetMapData( AssetLoader::ASSET_MAP ),
+      assetsLoader->GetMainAnimations( AssetLoader::ASSET_MAIN_ANIMATION ) ) );
+  }
 
-  sf::Clock dtClock;
-  dtClock.restart();
-  bool shouldLoop = true;
-  while ( systemRenderer.render( registry ) )
+  if ( worldDirectory != nullptr )
+    systemRenderer.setWorldPager( std::make_shared<WorldPager>( worldDirectory, WorldPager::Settings(), assetsLoader->GetAtlas( AssetLoader::ASSET_TILEMAP ) ) );
+
+  Snapshot::Buffer restoredSnapshot;
+  const bool restored = restorePath != nullptr && readSnapshot( restorePath, restoredSnapshot )
+    && systemRenderer.restoreWorld( restoredSnapshot, registry, *assetsLoader );
+  if ( !restored )
   {
-    sf::Time deltaTime = dtClock.restart();
+    if ( restorePath != nullptr )
+    {
+      std::cerr << "Could not restore " << restorePath << ", starting a new world" << std::endl;
+      registry = entt::registry();
+    }
+
+    if ( worldDirectory == nullptr )
+      systemRenderer.createMap( registry, *assetsLoader );
+    systemRenderer.createMainAnimation( registry, *assetsLoader );
+  }
+
+  // Saving the map or the animations updates the running game.
+  HotReloader hotReloader( *assetsLoader, systemRenderer );
+  if ( worldDirectory == nullptr )
+    hotReloader.watchMap( AssetLoader::ASSET_MAP );
+  hotReloader.watchMainAnimations( AssetLoader::ASSET_MAIN_ANIMATION );
+
+  // Built in the background from the map of createMap(); tiles are drawn until it is
+  // ready. Nothing is drawn headless.
+  if ( lod && worldDirectory == nullptr && !frameSettings.mHeadless )
+  {
+    systemRenderer.setTilePyramid( std::make_shared<TilePyramid>( systemRenderer.getMap(),
+      assetsLoader->GetAtlasSource( AssetLoader::ASSET_TILEMAP ), assetsLoader->GetCacheDirectory(), TilePyramid::Settings() ) );
+  }
+
+  // Paths over the map built by createMap(); a streamed world has none.
+  std::unique_ptr<Pathfinder> pathfinder;
+  if ( worldDirectory == nullptr )
+    pathfinder = std::make_unique<Pathfinder>( systemRenderer.getMap(), Pathfinder::readWalkableTiles( Globals::BLOCKED_TILES ), Pathfinder::Settings() );
+
+  Scheduler scheduler( jobSystem );
+  scheduler.addSystem( "previous positions", Scheduler::Reads<ComponentPositionWorld>(), Scheduler::Writes<ComponentPositionWorldPrevious>(),
+    [&systemRenderer]( entt::registry& aRegistry, float, JobSystem& )
+    {
+      systemRenderer.storePreviousPositions( aRegistry );
+    } );
+  // The moves of a restored world carry on where the snapshot left them.
+  SystemMovement systemMovement;
+  if ( restored )
+    systemMovement.restoreMoves( registry );
+  scheduler.addSystem( "movement", Scheduler::Reads<>(), Scheduler::Writes<ComponentPositionWorld, ComponentWorldMovement>(),
+    [&systemMovement]( entt::registry& aRegistry, float aDt, JobSystem& )
+    {
+      systemMovement.update( aRegistry, aDt );
+    } );
+  scheduler.addSystem( "animation", Scheduler::Reads<>(), Scheduler::Writes<ComponentSpriteAnimated>(),
+    [&systemRenderer]( entt::registry& aRegistry, float aDt, JobSystem& aJobSystem )
+    {
+      systemRenderer.updateAnimation( aDt, aRegistry, &aJobSystem );
+    } );
+
+  // The map is saved with the world, edits included; a streamed world's is on disk.
+  const Snapshot::World savedWorld = systemRenderer.getSnapshotWorld();
+  Snapshot::Buffer autosaveBase;
+  sf::Clock autosaveClock;
+
+  // The same walks on every run.
+  std::mt19937 wanderRandom( 42 );
 
-    systemRenderer.updateAnimation( deltaTime.asSeconds(), registry );
+  FrameDriver frameDriver( frameSettings );
+  frameDriver.run(
+    [&]( sf::Time aTick )
+    {
+      {
+        PROFILE_ZONE( "tick" );
 
-    shouldLoop = systemRenderer.render( registry );
+        // Creates components: outside of the Scheduler's systems.
+        if ( pathfinder )
+        {
+          if ( wander )
+          {
+            const sf::Vector2i mapSize = systemRenderer.getMap().getSize();
+            std::uniform_int_distribution<int> goalX( 0, mapSize.x - 1 );
+            std::uniform_int_distribution<int> goalY( 0, mapSize.y - 1 );
+            for ( auto entity : registry.view<ComponentMainCharacter>() )
+            {
+              if ( !registry.has<ComponentPath>( entity ) && !pathfinder->isPending( entity ) )
+                pathfinder->requestPath( registry, entity, sf::Vector2i( goalX( wanderRandom ), goalY( wanderRandom ) ), 4.0f );
+            }
+          }
+          pathfinder->update( registry, systemMovement );
+        }
+
+        scheduler.update( registry, aTick.asSeconds() );
+      }
+
+      if ( autosavePath != nullptr && autosaveClock.getElapsedTime() >= AUTOSAVE_PERIOD )
+      {
+        autosave( autosavePath, registry, *assetsLoader, savedWorld, autosaveBase );
+        autosaveClock.restart();
+      }
+
+      // Nothing is presented headless: every tick is a frame.
+      if ( frameSettings.mHeadless )
+        Profiler::endFrame();
+    },
+    [&]( float aInterpolation )
+    {
+      {
+        PROFILE_ZONE( "present" );
+
+        if ( !systemRenderer.processEvents() )
+          return false;
+
+        // Loads started during the session upload a bit every frame.
+        assetsLoader->ProcessUploads( sf::milliseconds( 2 ) );
+        hotReloader.update( registry );
+
+        systemRenderer.render( registry, aInterpolation );
+
+        if ( pathfinder )
+          pathfinder->updateTiles( systemRenderer.getMap(), systemRenderer.getEditedTiles() );
+      }
+
+      Profiler::endFrame();
+      return true;
+    } );
+
+  if ( autosavePath != nullptr )
+    autosave( autosavePath, registry, *assetsLoader, savedWorld, autosaveBase );
+
+  const FrameDriver::Stats& frameStats = frameDriver.getStats();
+  if ( frameSettings.mHeadless )
+    std::cout << frameStats.mTicks << " ticks in " << frameStats.mElapsed.asSeconds() << " s, "
+      << frameStats.mTicks / frameStats.mElapsed.asSeconds() << " ticks/s" << std::endl;
+  else if ( frameStats.mDroppedTicks > 0 )
+    std::cout << frameStats.mDroppedTicks << " ticks dropped to catch up" << std::endl;
+
+  if ( tracePath != nullptr )
+  {
+    Profiler::writeReport( std::cout );
+    if ( !Profiler::exportChromeTrace( tracePath ) )
+      std::cerr << "Could not write " << tracePath << std::endl;
   }
 
+  if ( memoryPath != nullptr && !MemoryTracker::writeJson( MemoryTracker::getReport( registry, *assetsLoader ), memoryPath ) )
+    std::cerr << "Could not write " << memoryPath << std::endl;
+
   return 0;
 }
@@ -0,0 +1,155 @@
+/**
+ * MIT License
+ * 
+ * Copyright (c) 2019 Alexandre Vaillancourt
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Converts a text map (as read by AssetLoader::loadMap) to the binary format
+// described in MapFile.hpp.
+//
+//   MapConverter <map.txt> <map.bin> [--index-bytes 1|2]
+//   MapConverter <map.txt> --pages <directory> [--page-size N] [--index-bytes 1|2]
+//
+// Without --index-bytes, one byte per tile is used when every tile id fits.
+// --pages splits the map into the paged world format streamed by WorldPager.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include "../src/JobSystem.hpp"
+#include "../src/MapFile.hpp"
+#include "../src/TextParser.hpp"
+
+namespace
+{
+  int writePages( const std::string& aDirectory, const TileGrid& aGrid, int aPageSize, int aTileIndexBytes )
+  {
+    std::error_code error;
+    std::filesystem::create_directories( aDirectory, error );
+
+    const sf::Vector2i size = aGrid.getSize();
+
+    MapFile::WorldInfo world;
+    world.mPageSize = aPageSize;
+    world.mSize     = size;
+
+    if ( !MapFile::writeWorld( aDirectory, world ) )
+    {
+      std::cerr << "could not write world manifest in " << aDirectory << std::endl;
+      return 1;
+    }
+
+    int pageCount = 0;
+    for ( int top = 0; top < size.y; top += aPageSize )
+    {
+      for ( int left = 0; left < size.x; left += aPageSize )
+      {
+        const sf::IntRect area( left, top, std::min( aPageSize, size.x - left ), std::min( aPageSize, size.y - top ) );
+        const sf::Vector2i page( left / aPageSize, top / aPageSize );
+
+        if ( !MapFile::writeBinary( MapFile::getPagePath( aDirectory, page ), aGrid.getView().region( area ), aTileIndexBytes ) )
+        {
+          std::cerr << "could not write page " << page.x << "," << page.y << std::endl;
+          return 1;
+        }
+        ++pageCount;
+      }
+    }
+
+    std::cout << aDirectory << ": " << size.x << "x" << size.y << " in " << pageCount << " pages of " << aPageSize << "x" << aPageSize << ", " << aTileIndexBytes << " byte(s) per tile" << std::endl;
+
+    return 0;
+  }
+}
+
+int main( int argc, char** argv )
+{
+  if ( argc < 3 )
+  {
+    std::cerr << "usage: " << argv[0] << " <map.txt> <map.bin> [--index-bytes 1|2]" << std::endl;
+    std::cerr << "       " << argv[0] << " <map.txt> --pages <directory> [--page-size N] [--index-bytes 1|2]" << std::endl;
+    return 1;
+  }
+
+  int tileIndexBytes = 0;
+  int pageSize = 64;
+  const char* pagesDirectory = nullptr;
+  for ( int i = 2; i + 1 < argc; ++i )
+  {
+    if ( std::strcmp( argv[i], "--index-bytes" ) == 0 )
+      tileIndexBytes = std::atoi( argv[i + 1] );
+    else if ( std::strcmp( argv[i], "--page-size" ) == 0 )
+      pageSize = std::atoi( argv[i + 1] );
+    else if ( std::strcmp( argv[i], "--pages" ) == 0 )
+      pagesDirectory = argv[i + 1];
+  }
+
+  if ( pageSize <= 0 )
+  {
+    std::cerr << "--page-size must be positive" << std::endl;
+    return 1;
+  }
+
+  TileGrid grid;
+  TextParser::Error error;
+  JobSystem jobSystem;
+
+  if ( !MapFile::readText( argv[1], grid, &error, &jobSystem ) )
+  {
+    std::cerr << "could not read text map " << TextParser::describe( argv[1], error ) << std::endl;
+    return 1;
+  }
+
+  const sf::Vector2i size = grid.getSize();
+  const TileId* tiles = grid.data();
+  const TileId maxTileId = size.x * size.y == 0 ? 0 : *std::max_element( tiles, tiles + size.x * size.y );
+
+  if ( tileIndexBytes == 0 )
+    tileIndexBytes = maxTileId <= 0xFF ? 1 : 2;
+
+  if ( tileIndexBytes != 1 && tileIndexBytes != 2 )
+  {
+    std::cerr << "--index-bytes must be 1 or 2" << std::endl;
+    return 1;
+  }
+
+  if ( tileIndexBytes == 1 && maxTileId > 0xFF )
+  {
+    std::cerr << "tile id " << maxTileId << " does not fit in one byte" << std::endl;
+    return 1;
+  }
+
+  if ( pagesDirectory != nullptr )
+    return writePages( pagesDirectory, grid, pageSize, tileIndexBytes );
+
+  if ( !MapFile::writeBinary( argv[2], grid.getView(), tileIndexBytes ) )
+  {
+    std::cerr << "could not write binary map " << argv[2] << std::endl;
+    return 1;
+  }
+
+  std::cout << argv[2] << ": " << size.x << "x" << size.y << ", " << tileIndexBytes << " byte(s) per tile" << std::endl;
+
+  return 0;
+}